@@ -0,0 +1,364 @@
+#include <Archive.h>
+
+
+#include <algorithm>
+
+#include <bx/file.h>
+
+
+namespace zv
+{
+	namespace
+	{
+		constexpr u32 MinMatch = 4;
+		constexpr u32 LastLiterals = 5;  // The format ends every block on at least this many literals,
+		constexpr u32 MatchLimit = 12;   // and no match may start closer than this to the end.
+		constexpr u32 MaxOffset = 0xffff;
+		constexpr u32 HashBits = 12;
+
+		u32 readU32(const u8* _ptr)
+		{
+			u32 value;
+			bx::memCopy(&value, _ptr, sizeof(value));
+			return value;
+		}
+
+		u8* writeLength(u8* _dst, u32 _length)
+		{
+			for (; _length >= 255; _length -= 255)
+			{
+				*_dst++ = 255;
+			}
+			*_dst++ = u8(_length);
+			return _dst;
+		}
+
+		bool readLength(const u8*& _src, const u8* _end, u32& _length)
+		{
+			u8 byte;
+			do
+			{
+				if (_src >= _end)
+					return false;
+
+				byte = *_src++;
+				_length += byte;
+			}
+			while (255 == byte);
+
+			return true;
+		}
+	}
+
+
+	bool Archive::open(const char* _filePath)
+	{
+		close();
+
+		if (!m_file.open(_filePath) || m_file.size() < sizeof(ArchiveHeader))
+		{
+			m_file.close();
+			return false;
+		}
+
+		ArchiveHeader header;
+		bx::memCopy(&header, m_file.data(), sizeof(header));
+
+		const u64 indexEnd = sizeof(ArchiveHeader) + u64(header.numEntries) * sizeof(ArchiveEntry);
+		if (Magic != header.magic || Version != header.version || indexEnd > m_file.size())
+		{
+			m_file.close();
+			return false;
+		}
+
+		// The header keeps the index 8 byte aligned, so it's used right from the mapping.
+		const ArchiveEntry* entries = (const ArchiveEntry*)(m_file.data() + sizeof(ArchiveHeader));
+		for (u32 ii = 0; ii < header.numEntries; ++ii)
+		{
+			const ArchiveEntry& entry = entries[ii];
+			const bool sorted = 0 == ii || entries[ii - 1].hash < entry.hash;
+			if (!sorted || entry.offset + entry.size > m_file.size())
+			{
+				m_file.close();
+				return false;
+			}
+		}
+
+		m_pEntries = entries;
+		m_numEntries = header.numEntries;
+		return true;
+	}
+
+	void Archive::close()
+	{
+		m_file.close();
+		m_pEntries = NULL;
+		m_numEntries = 0;
+	}
+
+	const ArchiveEntry* Archive::find(const char* _path) const
+	{
+		const u64 hash = hashPath(_path);
+		const ArchiveEntry* end = m_pEntries + m_numEntries;
+		const ArchiveEntry* entry = std::lower_bound(m_pEntries, end, hash,
+			[](const ArchiveEntry& _entry, u64 _hash) { return _entry.hash < _hash; });
+
+		return (end != entry && hash == entry->hash) ? entry : NULL;
+	}
+
+	bool Archive::read(const ArchiveEntry& _entry, void* _dst) const
+	{
+		if (0 == (_entry.flags & EntryCompressed))
+		{
+			bx::memCopy(_dst, data(_entry), _entry.size);
+			return true;
+		}
+
+		return decompress(data(_entry), _entry.size, _dst, _entry.originalSize);
+	}
+
+	u64 Archive::hashPath(const char* _path)
+	{
+		while ('.' == _path[0] && ('/' == _path[1] || '\\' == _path[1]))
+		{
+			_path += 2;
+		}
+
+		u64 hash = UINT64_C(0xcbf29ce484222325);
+		for (; '\0' != *_path; ++_path)
+		{
+			const char ch = '\\' == *_path ? '/' : *_path;
+			hash ^= u8(ch);
+			hash *= UINT64_C(0x100000001b3);
+		}
+
+		return hash;
+	}
+
+	u32 Archive::compress(const void* _src, u32 _size, void* _dst, u32 _capacity)
+	{
+		if (_capacity < compressBound(_size))
+			return 0;
+
+		const u8* src = (const u8*)_src;
+		u8* dst = (u8*)_dst;
+
+		// Most recent position of every hashed 4 byte sequence, offset by one so 0 is empty.
+		std::vector<u32> table(1u << HashBits, 0);
+
+		u32 anchor = 0;
+		u32 pos = 0;
+		while (_size >= MatchLimit && pos <= _size - MatchLimit)
+		{
+			const u32 sequence = readU32(src + pos);
+			const u32 slot = (sequence * 2654435761u) >> (32 - HashBits);
+			const u32 candidate = table[slot];
+			table[slot] = pos + 1;
+
+			if (0 == candidate || pos - (candidate - 1) > MaxOffset || sequence != readU32(src + candidate - 1))
+			{
+				++pos;
+				continue;
+			}
+
+			const u32 match = candidate - 1;
+			u32 length = MinMatch;
+			while (pos + length < _size - LastLiterals && src[match + length] == src[pos + length])
+			{
+				++length;
+			}
+
+			const u32 literals = pos - anchor;
+			u8* token = dst++;
+			*token = u8(bx::min<u32>(literals, 15) << 4);
+			if (literals >= 15)
+			{
+				dst = writeLength(dst, literals - 15);
+			}
+			bx::memCopy(dst, src + anchor, literals);
+			dst += literals;
+
+			const u32 offset = pos - match;
+			*dst++ = u8(offset);
+			*dst++ = u8(offset >> 8);
+
+			*token |= u8(bx::min<u32>(length - MinMatch, 15));
+			if (length - MinMatch >= 15)
+			{
+				dst = writeLength(dst, length - MinMatch - 15);
+			}
+
+			pos += length;
+			anchor = pos;
+		}
+
+		// The last sequence is literals only, none for empty input, whose _src may be NULL.
+		const u32 literals = _size - anchor;
+		*dst++ = u8(bx::min<u32>(literals, 15) << 4);
+		if (literals >= 15)
+		{
+			dst = writeLength(dst, literals - 15);
+		}
+		if (0 != literals)
+		{
+			bx::memCopy(dst, src + anchor, literals);
+			dst += literals;
+		}
+
+		return u32(dst - (u8*)_dst);
+	}
+
+	bool Archive::decompress(const void* _src, u32 _size, void* _dst, u32 _dstSize)
+	{
+		const u8* src = (const u8*)_src;
+		const u8* srcEnd = src + _size;
+		u8* dst = (u8*)_dst;
+		u8* dstEnd = dst + _dstSize;
+
+		while (src < srcEnd)
+		{
+			const u8 token = *src++;
+
+			u32 literals = token >> 4;
+			if (15 == literals && !readLength(src, srcEnd, literals))
+				return false;
+
+			if (literals > u32(srcEnd - src) || literals > u32(dstEnd - dst))
+				return false;
+
+			bx::memCopy(dst, src, literals);
+			src += literals;
+			dst += literals;
+
+			if (src == srcEnd)
+				break;
+
+			if (srcEnd - src < 2)
+				return false;
+
+			const u32 offset = u32(src[0]) | (u32(src[1]) << 8);
+			src += 2;
+			if (0 == offset || offset > u32(dst - (u8*)_dst))
+				return false;
+
+			u32 length = token & 15;
+			if (15 == length && !readLength(src, srcEnd, length))
+				return false;
+
+			length += MinMatch;
+			if (length > u32(dstEnd - dst))
+				return false;
+
+			// Byte by byte, the match may overlap what it's writing.
+			const u8* match = dst - offset;
+			for (u32 ii = 0; ii < length; ++ii)
+			{
+				dst[ii] = match[ii];
+			}
+			dst += length;
+		}
+
+		return dst == dstEnd;
+	}
+
+
+	ArchiveBuilder::ArchiveBuilder(u32 alignment)
+		: m_alignment(bx::max<u32>(alignment, 8))
+	{
+	}
+
+	bool ArchiveBuilder::add(const char* _path, const void* _data, u32 _size, u32 _minSaving)
+	{
+		Pending pending;
+		pending.path = _path;
+		pending.entry = ArchiveEntry{ Archive::hashPath(_path), 0, _size, _size, 0, 0 };
+
+		for (const Pending& other : m_entries)
+		{
+			if (other.entry.hash == pending.entry.hash)
+				return false;
+		}
+
+		if (0 != _minSaving && 0 != _size)
+		{
+			pending.blob.resize(Archive::compressBound(_size));
+			const u32 size = Archive::compress(_data, _size, pending.blob.data(), (u32)pending.blob.size());
+			if (0 != size && size <= _size - _size / _minSaving)
+			{
+				pending.blob.resize(size);
+				pending.entry.size = size;
+				pending.entry.flags |= Archive::EntryCompressed;
+			}
+			else
+			{
+				pending.blob.clear();
+			}
+		}
+
+		if (0 == (pending.entry.flags & Archive::EntryCompressed))
+		{
+			pending.blob.assign((const u8*)_data, (const u8*)_data + _size);
+		}
+
+		m_entries.emplace_back(std::move(pending));
+		return true;
+	}
+
+	bool ArchiveBuilder::write(const char* _filePath) const
+	{
+		std::vector<const Pending*> sorted;
+		sorted.reserve(m_entries.size());
+		for (const Pending& pending : m_entries)
+		{
+			sorted.push_back(&pending);
+		}
+		std::sort(sorted.begin(), sorted.end(),
+			[](const Pending* _a, const Pending* _b) { return _a->entry.hash < _b->entry.hash; });
+
+		const ArchiveHeader header{ Archive::Magic, Archive::Version, (u32)sorted.size(), m_alignment };
+
+		// Lay out the blobs after the index first, so the index is written in one go.
+		std::vector<ArchiveEntry> index;
+		index.reserve(sorted.size());
+		u64 offset = sizeof(ArchiveHeader) + sorted.size() * sizeof(ArchiveEntry);
+		for (const Pending* pending : sorted)
+		{
+			offset = (offset + m_alignment - 1) / m_alignment * m_alignment;
+
+			ArchiveEntry entry = pending->entry;
+			entry.offset = offset;
+			index.push_back(entry);
+
+			offset += entry.size;
+		}
+
+		if (UINT32_MAX < offset)
+			return false;
+
+		bx::FileWriter writer;
+		bx::Error err;
+		if (!bx::open(&writer, _filePath, false, &err))
+			return false;
+
+		bx::write(&writer, header, &err);
+		bx::write(&writer, index.data(), s32(index.size() * sizeof(ArchiveEntry)), &err);
+
+		u64 written = sizeof(ArchiveHeader) + index.size() * sizeof(ArchiveEntry);
+		const u8 padding[256] = {};
+		for (u32 ii = 0; ii < sorted.size() && err.isOk(); ++ii)
+		{
+			while (written < index[ii].offset)
+			{
+				const s32 size = s32(bx::min<u64>(index[ii].offset - written, sizeof(padding)));
+				bx::write(&writer, padding, size, &err);
+				written += size;
+			}
+
+			bx::write(&writer, sorted[ii]->blob.data(), s32(sorted[ii]->blob.size()), &err);
+			written += sorted[ii]->blob.size();
+		}
+
+		bx::close(&writer);
+		return err.isOk();
+	}
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+
+#include <string>
+#include <vector>
+
+#include <bx/bx.h>
+
+#include <MappedFile.h>
+#include <Types.h>
+
+
+namespace zv
+{
+	/*
+	Pack file holding many assets behind one file handle and one mapping.
+
+	  ArchiveHeader
+	  ArchiveEntry[numEntries]   sorted by path hash
+	  blobs                      each starting on a header.alignment boundary
+
+	Entries are found by binary search on the 64 bit FNV-1a hash of their
+	normalized path. A blob is stored as is, or LZ4 block compressed when that
+	saved enough to be worth inflating at load time.
+	*/
+	struct ArchiveHeader
+	{
+		u32 magic;
+		u32 version;
+		u32 numEntries;
+		u32 alignment;
+	};
+
+	struct ArchiveEntry
+	{
+		u64 hash;
+		u64 offset;       // From the start of the archive.
+		u32 size;         // Stored bytes.
+		u32 originalSize; // Bytes after inflating, equal to size when not compressed.
+		u32 flags;
+		u32 reserved;
+	};
+
+	class Archive
+	{
+	public:
+		static constexpr u32 Magic = BX_MAKEFOURCC('Z', 'V', 'P', 'K');
+		static constexpr u32 Version = 1;
+
+		static constexpr u32 EntryCompressed = 0x1;
+
+	public:
+		Archive() = default;
+		~Archive() = default;
+
+		Archive(const Archive&) = delete;
+		Archive& operator=(const Archive&) = delete;
+
+	public:
+		// Maps the archive and validates its header and index.
+		bool open(const char* _filePath);
+		void close();
+
+		bool isOpen() const { return NULL != m_pEntries; }
+		u32 numEntries() const { return m_numEntries; }
+
+		// NULL when the path isn't in the archive.
+		const ArchiveEntry* find(const char* _path) const;
+
+		// Stored bytes of an entry, they stay valid while the archive is open.
+		const u8* data(const ArchiveEntry& _entry) const { return m_file.data() + _entry.offset; }
+
+		// Copies or inflates an entry into _dst, which holds originalSize bytes.
+		bool read(const ArchiveEntry& _entry, void* _dst) const;
+
+		// Slashes are unified and a leading "./" dropped, so "Assets\\a.bin" and
+		// "./Assets/a.bin" name the same entry. Case is kept.
+		static u64 hashPath(const char* _path);
+
+		// LZ4 block format. compress returns 0 when the result doesn't fit _capacity.
+		static u32 compressBound(u32 _size) { return _size + _size / 255 + 16; }
+		static u32 compress(const void* _src, u32 _size, void* _dst, u32 _capacity);
+		static bool decompress(const void* _src, u32 _size, void* _dst, u32 _dstSize);
+
+	private:
+		MappedFile m_file;
+		const ArchiveEntry* m_pEntries{ NULL };
+		u32 m_numEntries{ 0 };
+	};
+
+	// Collects files in memory and writes them out as an archive, used by the packer.
+	class ArchiveBuilder
+	{
+	public:
+		ArchiveBuilder(u32 alignment = 16);
+
+	public:
+		// Compressed only when it saves at least 1 / _minSaving of the size, 0 stores it as is.
+		// False when the path hash collides with an entry already added.
+		bool add(const char* _path, const void* _data, u32 _size, u32 _minSaving = 8);
+
+		bool write(const char* _filePath) const;
+
+		u32 numEntries() const { return (u32)m_entries.size(); }
+
+	private:
+		struct Pending
+		{
+			std::string path;
+			ArchiveEntry entry;
+			std::vector<u8> blob;
+		};
+
+		u32 m_alignment;
+		std::vector<Pending> m_entries{};
+	};
+}
@@ -0,0 +1,742 @@
+#include <Bvh.h>
+
+
+#include <algorithm>
+
+#include <bx/math.h>
+
+#include <Object3D.h>
+
+
+namespace zv
+{
+	void Bvh::build(const std::vector<Object3D*>& objects, std::vector<s32>& proxies)
+	{
+		clear();
+
+		proxies.clear();
+		proxies.reserve(objects.size());
+
+		std::vector<s32> leaves;
+		leaves.reserve(objects.size());
+
+		for (Object3D* object : objects)
+		{
+			const s32 leaf = allocateNode();
+			m_nodes[leaf].object = object;
+
+			// Static content gets exact bounds, no margin.
+			initLeaf(leaf, false);
+
+			proxies.push_back(leaf);
+			if (!m_nodes[leaf].unbounded)
+			{
+				leaves.push_back(leaf);
+			}
+		}
+
+		m_numLeaves = (u32)proxies.size();
+
+		if (!leaves.empty())
+		{
+			m_root = buildRecursive(leaves, 0, (u32)leaves.size());
+			m_nodes[m_root].parent = NullNode;
+		}
+	}
+
+	s32 Bvh::insert(Object3D* object)
+	{
+		const s32 leaf = allocateNode();
+		m_nodes[leaf].object = object;
+
+		initLeaf(leaf, true);
+		if (!m_nodes[leaf].unbounded)
+		{
+			insertLeaf(leaf);
+		}
+		++m_numLeaves;
+
+		return leaf;
+	}
+
+	void Bvh::remove(s32 proxy)
+	{
+		BX_ASSERT(m_nodes[proxy].isLeaf(), "Bvh: %d is not a proxy.", proxy);
+
+		if (m_nodes[proxy].unbounded)
+		{
+			removeUnbounded(proxy);
+		}
+		else
+		{
+			if (m_nodes[proxy].moved)
+			{
+				m_moved.erase(std::find(m_moved.begin(), m_moved.end(), proxy));
+			}
+			removeLeaf(proxy);
+		}
+
+		freeNode(proxy);
+		--m_numLeaves;
+	}
+
+	bool Bvh::update(s32 proxy)
+	{
+		Node& node = m_nodes[proxy];
+
+		bx::Aabb aabb;
+		const bool bounded = node.object->worldAabb(aabb);
+
+		// Gained or lost its bounds, move between the tree and the unbounded list.
+		if (node.unbounded)
+		{
+			if (!bounded)
+				return false;
+
+			removeUnbounded(proxy);
+			initLeaf(proxy, true);
+			insertLeaf(proxy);
+			return true;
+		}
+
+		if (!bounded)
+		{
+			if (node.moved)
+			{
+				m_moved.erase(std::find(m_moved.begin(), m_moved.end(), proxy));
+				node.moved = false;
+			}
+			removeLeaf(proxy);
+			initLeaf(proxy, true);
+			return true;
+		}
+
+		if (contains(node.aabb, aabb))
+			return false;
+
+		const vec3 margin = { AabbMargin, AabbMargin, AabbMargin };
+		node.aabb.min = bx::sub(aabb.min, margin);
+		node.aabb.max = bx::add(aabb.max, margin);
+
+		// Refit now so queries stay correct, fix the tree quality in rebuild().
+		refitAncestors(node.parent);
+
+		if (!node.moved)
+		{
+			node.moved = true;
+			m_moved.push_back(proxy);
+		}
+
+		return true;
+	}
+
+	void Bvh::rebuild(u32 maxReinsertions)
+	{
+		const u32 num = bx::min(maxReinsertions, (u32)m_moved.size());
+
+		for (u32 ii = 0; ii < num; ++ii)
+		{
+			const s32 leaf = m_moved.back();
+			m_moved.pop_back();
+
+			m_nodes[leaf].moved = false;
+			removeLeaf(leaf);
+			insertLeaf(leaf);
+		}
+	}
+
+	void Bvh::clear()
+	{
+		m_nodes.clear();
+		m_moved.clear();
+		m_unbounded.clear();
+		m_root = NullNode;
+		m_freeList = NullNode;
+		m_numLeaves = 0;
+	}
+
+	void Bvh::cull(const Frustum& frustum, std::vector<Object3D*>& visible) const
+	{
+		for (const s32 leaf : m_unbounded)
+		{
+			visible.push_back(m_nodes[leaf].object);
+		}
+
+		if (NullNode == m_root)
+			return;
+
+		// Each entry carries the planes its parent still straddled. Once a node is
+		// inside all planes, its whole subtree is visible without further tests.
+		struct Entry { s32 node; u32 planeMask; };
+
+		std::vector<Entry> stack;
+		stack.push_back({ m_root, (1u << Frustum::Count) - 1 });
+
+		while (!stack.empty())
+		{
+			const Entry entry = stack.back();
+			stack.pop_back();
+
+			const Node& node = m_nodes[entry.node];
+			const vec3 center = bx::mul(bx::add(node.aabb.min, node.aabb.max), 0.5f);
+			const vec3 extent = bx::mul(bx::sub(node.aabb.max, node.aabb.min), 0.5f);
+
+			u32 planeMask = entry.planeMask;
+			bool outside = false;
+
+			for (u32 ii = 0; ii < Frustum::Count && !outside; ++ii)
+			{
+				if (0 == (planeMask & (1u << ii)))
+					continue;
+
+				const f32* plane = frustum.planes[ii];
+				const f32 dist = plane[0] * center.x + plane[1] * center.y + plane[2] * center.z + plane[3];
+				const f32 radius = bx::abs(plane[0]) * extent.x + bx::abs(plane[1]) * extent.y + bx::abs(plane[2]) * extent.z;
+
+				if (dist + radius < 0.0f)
+					outside = true;
+				else if (dist - radius >= 0.0f)
+					planeMask &= ~(1u << ii);
+			}
+
+			if (outside)
+				continue;
+
+			if (0 == planeMask)
+			{
+				collectLeaves(entry.node, visible);
+			}
+			else if (node.isLeaf())
+			{
+				visible.push_back(node.object);
+			}
+			else
+			{
+				stack.push_back({ node.left, planeMask });
+				stack.push_back({ node.right, planeMask });
+			}
+		}
+	}
+
+	Object3D* Bvh::raycast(const vec3& origin, const vec3& direction, f32 maxDistance, f32* hitDistance) const
+	{
+		if (NullNode == m_root)
+			return NULL;
+
+		const vec3 invDir = {
+			1.0f / direction.x,
+			1.0f / direction.y,
+			1.0f / direction.z,
+		};
+
+		// One axis of the slab test. A ray parallel to the slab inverts to +-inf, and
+		// (min - origin) * inf is NaN with the origin on a slab plane, so it is
+		// inside the slab when its origin is and misses otherwise.
+		auto slab = [](f32 min, f32 max, f32 origin, f32 invDir, f32& enter, f32& exit) -> bool
+		{
+			if (!(bx::abs(invDir) <= bx::kFloatLargest))
+				return min <= origin && origin <= max;
+
+			const f32 t0 = (min - origin) * invDir;
+			const f32 t1 = (max - origin) * invDir;
+			enter = bx::max(enter, bx::min(t0, t1));
+			exit = bx::min(exit, bx::max(t0, t1));
+			return true;
+		};
+
+		// Slab test, returns the entry distance or a negative value on a miss.
+		auto intersect = [&origin, &invDir, &slab](const bx::Aabb& aabb, f32 tMax) -> f32
+		{
+			f32 enter = 0.0f;
+			f32 exit = tMax;
+			const bool inside = slab(aabb.min.x, aabb.max.x, origin.x, invDir.x, enter, exit)
+				&& slab(aabb.min.y, aabb.max.y, origin.y, invDir.y, enter, exit)
+				&& slab(aabb.min.z, aabb.max.z, origin.z, invDir.z, enter, exit);
+
+			return inside && enter <= exit ? enter : -1.0f;
+		};
+
+		Object3D* closest = NULL;
+		f32 closestDistance = maxDistance;
+
+		std::vector<s32> stack;
+		stack.push_back(m_root);
+
+		while (!stack.empty())
+		{
+			const Node& node = m_nodes[stack.back()];
+			stack.pop_back();
+
+			if (intersect(node.aabb, closestDistance) < 0.0f)
+				continue;
+
+			if (!node.isLeaf())
+			{
+				stack.push_back(node.left);
+				stack.push_back(node.right);
+				continue;
+			}
+
+			// Leaves hold fattened boxes, test the object's exact bounds.
+			bx::Aabb aabb;
+			if (!node.object->worldAabb(aabb))
+				continue;
+
+			const f32 distance = intersect(aabb, closestDistance);
+			if (distance >= 0.0f)
+			{
+				closest = node.object;
+				closestDistance = distance;
+			}
+		}
+
+		if (NULL != closest && NULL != hitDistance)
+		{
+			*hitDistance = closestDistance;
+		}
+
+		return closest;
+	}
+
+	void Bvh::overlap(const bx::Sphere& sphere, std::vector<Object3D*>& result) const
+	{
+		for (const s32 leaf : m_unbounded)
+		{
+			result.push_back(m_nodes[leaf].object);
+		}
+
+		if (NullNode == m_root)
+			return;
+
+		const f32 radiusSq = sphere.radius * sphere.radius;
+
+		auto overlapsSphere = [&sphere, radiusSq](const bx::Aabb& aabb)
+		{
+			const vec3 closest = bx::min(bx::max(sphere.center, aabb.min), aabb.max);
+			const vec3 offset = bx::sub(closest, sphere.center);
+			return bx::dot(offset, offset) <= radiusSq;
+		};
+
+		std::vector<s32> stack;
+		stack.push_back(m_root);
+
+		while (!stack.empty())
+		{
+			const Node& node = m_nodes[stack.back()];
+			stack.pop_back();
+
+			if (!overlapsSphere(node.aabb))
+				continue;
+
+			if (!node.isLeaf())
+			{
+				stack.push_back(node.left);
+				stack.push_back(node.right);
+				continue;
+			}
+
+			bx::Aabb aabb;
+			if (!node.object->worldAabb(aabb) || overlapsSphere(aabb))
+			{
+				result.push_back(node.object);
+			}
+		}
+	}
+
+	void Bvh::overlap(const bx::Aabb& box, std::vector<Object3D*>& result) const
+	{
+		for (const s32 leaf : m_unbounded)
+		{
+			result.push_back(m_nodes[leaf].object);
+		}
+
+		if (NullNode == m_root)
+			return;
+
+		std::vector<s32> stack;
+		stack.push_back(m_root);
+
+		while (!stack.empty())
+		{
+			const Node& node = m_nodes[stack.back()];
+			stack.pop_back();
+
+			if (!overlaps(node.aabb, box))
+				continue;
+
+			if (!node.isLeaf())
+			{
+				stack.push_back(node.left);
+				stack.push_back(node.right);
+				continue;
+			}
+
+			bx::Aabb aabb;
+			if (!node.object->worldAabb(aabb) || overlaps(aabb, box))
+			{
+				result.push_back(node.object);
+			}
+		}
+	}
+
+	u32 Bvh::height() const
+	{
+		return NullNode == m_root ? 0 : height(m_root);
+	}
+
+	s32 Bvh::allocateNode()
+	{
+		s32 index;
+		if (NullNode != m_freeList)
+		{
+			index = m_freeList;
+			m_freeList = m_nodes[index].parent;
+		}
+		else
+		{
+			index = (s32)m_nodes.size();
+			m_nodes.emplace_back();
+		}
+
+		Node& node = m_nodes[index];
+		node.object = NULL;
+		node.parent = NullNode;
+		node.left = NullNode;
+		node.right = NullNode;
+		node.moved = false;
+		node.unbounded = false;
+
+		return index;
+	}
+
+	void Bvh::freeNode(s32 node)
+	{
+		// Free nodes are chained through their parent index.
+		m_nodes[node].parent = m_freeList;
+		m_freeList = node;
+	}
+
+	void Bvh::initLeaf(s32 leaf, bool fatten)
+	{
+		Node& node = m_nodes[leaf];
+
+		bx::Aabb aabb;
+		if (!node.object->worldAabb(aabb))
+		{
+			node.unbounded = true;
+			m_unbounded.push_back(leaf);
+			return;
+		}
+
+		const f32 margin = fatten ? AabbMargin : 0.0f;
+		node.aabb.min = bx::sub(aabb.min, { margin, margin, margin });
+		node.aabb.max = bx::add(aabb.max, { margin, margin, margin });
+		node.unbounded = false;
+	}
+
+	void Bvh::removeUnbounded(s32 leaf)
+	{
+		m_unbounded.erase(std::find(m_unbounded.begin(), m_unbounded.end(), leaf));
+		m_nodes[leaf].unbounded = false;
+	}
+
+	void Bvh::insertLeaf(s32 leaf)
+	{
+		if (NullNode == m_root)
+		{
+			m_root = leaf;
+			m_nodes[leaf].parent = NullNode;
+			return;
+		}
+
+		const bx::Aabb leafAabb = m_nodes[leaf].aabb;
+
+		// Descend towards the sibling with the lowest SAH cost increase.
+		s32 index = m_root;
+		while (!m_nodes[index].isLeaf())
+		{
+			const Node& node = m_nodes[index];
+
+			const f32 area = surfaceArea(node.aabb);
+			const f32 combinedArea = surfaceArea(merge(node.aabb, leafAabb));
+
+			// Cost of a new parent here, and the cost pushed down to the children.
+			const f32 cost = 2.0f * combinedArea;
+			const f32 inheritanceCost = 2.0f * (combinedArea - area);
+
+			auto descendCost = [&](s32 child)
+			{
+				const Node& childNode = m_nodes[child];
+				const f32 mergedArea = surfaceArea(merge(childNode.aabb, leafAabb));
+				return childNode.isLeaf()
+					? mergedArea + inheritanceCost
+					: mergedArea - surfaceArea(childNode.aabb) + inheritanceCost;
+			};
+
+			const f32 costLeft = descendCost(node.left);
+			const f32 costRight = descendCost(node.right);
+
+			if (cost < costLeft && cost < costRight)
+				break;
+
+			index = costLeft < costRight ? node.left : node.right;
+		}
+
+		const s32 sibling = index;
+		const s32 oldParent = m_nodes[sibling].parent;
+		const s32 newParent = allocateNode();
+
+		Node& parent = m_nodes[newParent];
+		parent.parent = oldParent;
+		parent.aabb = merge(leafAabb, m_nodes[sibling].aabb);
+		parent.left = sibling;
+		parent.right = leaf;
+
+		m_nodes[sibling].parent = newParent;
+		m_nodes[leaf].parent = newParent;
+
+		if (NullNode == oldParent)
+		{
+			m_root = newParent;
+		}
+		else if (m_nodes[oldParent].left == sibling)
+		{
+			m_nodes[oldParent].left = newParent;
+		}
+		else
+		{
+			m_nodes[oldParent].right = newParent;
+		}
+
+		refitAncestors(oldParent);
+	}
+
+	void Bvh::removeLeaf(s32 leaf)
+	{
+		if (leaf == m_root)
+		{
+			m_root = NullNode;
+			return;
+		}
+
+		const s32 parent = m_nodes[leaf].parent;
+		const s32 grandParent = m_nodes[parent].parent;
+		const s32 sibling = m_nodes[parent].left == leaf ? m_nodes[parent].right : m_nodes[parent].left;
+
+		if (NullNode == grandParent)
+		{
+			m_root = sibling;
+			m_nodes[sibling].parent = NullNode;
+		}
+		else
+		{
+			if (m_nodes[grandParent].left == parent)
+				m_nodes[grandParent].left = sibling;
+			else
+				m_nodes[grandParent].right = sibling;
+
+			m_nodes[sibling].parent = grandParent;
+			refitAncestors(grandParent);
+		}
+
+		freeNode(parent);
+		m_nodes[leaf].parent = NullNode;
+	}
+
+	void Bvh::refitAncestors(s32 node)
+	{
+		while (NullNode != node)
+		{
+			Node& current = m_nodes[node];
+			current.aabb = merge(m_nodes[current.left].aabb, m_nodes[current.right].aabb);
+			node = current.parent;
+		}
+	}
+
+	s32 Bvh::buildRecursive(std::vector<s32>& leaves, u32 begin, u32 end)
+	{
+		const u32 count = end - begin;
+		if (1 == count)
+			return leaves[begin];
+
+		// Bounds of the leaf centroids pick the split axis and bin layout.
+		bx::Aabb centroidBounds;
+		centroidBounds.min = { bx::kFloatLargest, bx::kFloatLargest, bx::kFloatLargest };
+		centroidBounds.max = { -bx::kFloatLargest, -bx::kFloatLargest, -bx::kFloatLargest };
+
+		auto centroid = [this](s32 leaf)
+		{
+			const bx::Aabb& aabb = m_nodes[leaf].aabb;
+			return bx::mul(bx::add(aabb.min, aabb.max), 0.5f);
+		};
+
+		for (u32 ii = begin; ii < end; ++ii)
+		{
+			const vec3 center = centroid(leaves[ii]);
+			centroidBounds.min = bx::min(centroidBounds.min, center);
+			centroidBounds.max = bx::max(centroidBounds.max, center);
+		}
+
+		const vec3 extent = bx::sub(centroidBounds.max, centroidBounds.min);
+		const u32 axis = extent.x > extent.y
+			? (extent.x > extent.z ? 0 : 2)
+			: (extent.y > extent.z ? 1 : 2);
+
+		auto axisValue = [axis](const vec3& v) { return 0 == axis ? v.x : (1 == axis ? v.y : v.z); };
+
+		const f32 axisMin = axisValue(centroidBounds.min);
+		const f32 axisExtent = axisValue(extent);
+
+		u32 mid = begin + count / 2;
+
+		if (axisExtent > 0.0f)
+		{
+			struct Bin { bx::Aabb aabb; u32 count; };
+			Bin bins[NumSahBins];
+			for (Bin& bin : bins)
+			{
+				bin.count = 0;
+			}
+
+			auto binIndex = [&](s32 leaf)
+			{
+				const f32 offset = (axisValue(centroid(leaf)) - axisMin) / axisExtent;
+				return bx::min(u32(offset * NumSahBins), NumSahBins - 1);
+			};
+
+			for (u32 ii = begin; ii < end; ++ii)
+			{
+				Bin& bin = bins[binIndex(leaves[ii])];
+				bin.aabb = 0 == bin.count ? m_nodes[leaves[ii]].aabb : merge(bin.aabb, m_nodes[leaves[ii]].aabb);
+				++bin.count;
+			}
+
+			// Sweep from the right to get the cost of every right hand side.
+			f32 rightArea[NumSahBins];
+			u32 rightCount[NumSahBins];
+			{
+				bx::Aabb aabb = bins[NumSahBins - 1].aabb;
+				u32 num = 0;
+				for (u32 ii = NumSahBins - 1; ii > 0; --ii)
+				{
+					if (0 != bins[ii].count)
+					{
+						aabb = 0 == num ? bins[ii].aabb : merge(aabb, bins[ii].aabb);
+						num += bins[ii].count;
+					}
+					rightArea[ii] = 0 == num ? 0.0f : surfaceArea(aabb);
+					rightCount[ii] = num;
+				}
+			}
+
+			f32 bestCost = bx::kFloatLargest;
+			u32 bestSplit = 0;
+			{
+				bx::Aabb aabb = bins[0].aabb;
+				u32 num = 0;
+				for (u32 ii = 0; ii < NumSahBins - 1; ++ii)
+				{
+					if (0 != bins[ii].count)
+					{
+						aabb = 0 == num ? bins[ii].aabb : merge(aabb, bins[ii].aabb);
+						num += bins[ii].count;
+					}
+
+					if (0 == num || 0 == rightCount[ii + 1])
+						continue;
+
+					const f32 cost = surfaceArea(aabb) * f32(num) + rightArea[ii + 1] * f32(rightCount[ii + 1]);
+					if (cost < bestCost)
+					{
+						bestCost = cost;
+						bestSplit = ii;
+					}
+				}
+			}
+
+			if (bestCost < bx::kFloatLargest)
+			{
+				auto split = std::partition(leaves.begin() + begin, leaves.begin() + end,
+					[&](s32 leaf) { return binIndex(leaf) <= bestSplit; });
+				mid = u32(split - leaves.begin());
+			}
+		}
+
+		// All centroids in one bin, fall back to a median split.
+		if (mid == begin || mid == end)
+		{
+			mid = begin + count / 2;
+			std::nth_element(leaves.begin() + begin, leaves.begin() + mid, leaves.begin() + end,
+				[&](s32 a, s32 b) { return axisValue(centroid(a)) < axisValue(centroid(b)); });
+		}
+
+		const s32 left = buildRecursive(leaves, begin, mid);
+		const s32 right = buildRecursive(leaves, mid, end);
+
+		const s32 index = allocateNode();
+		Node& node = m_nodes[index];
+		node.left = left;
+		node.right = right;
+		node.aabb = merge(m_nodes[left].aabb, m_nodes[right].aabb);
+
+		m_nodes[left].parent = index;
+		m_nodes[right].parent = index;
+
+		return index;
+	}
+
+	void Bvh::collectLeaves(s32 root, std::vector<Object3D*>& result) const
+	{
+		std::vector<s32> stack;
+		stack.push_back(root);
+
+		while (!stack.empty())
+		{
+			const Node& node = m_nodes[stack.back()];
+			stack.pop_back();
+
+			if (node.isLeaf())
+			{
+				result.push_back(node.object);
+			}
+			else
+			{
+				stack.push_back(node.left);
+				stack.push_back(node.right);
+			}
+		}
+	}
+
+	u32 Bvh::height(s32 node) const
+	{
+		const Node& current = m_nodes[node];
+		if (current.isLeaf())
+			return 1;
+
+		return 1 + bx::max(height(current.left), height(current.right));
+	}
+
+	bx::Aabb Bvh::merge(const bx::Aabb& a, const bx::Aabb& b)
+	{
+		return { bx::min(a.min, b.min), bx::max(a.max, b.max) };
+	}
+
+	f32 Bvh::surfaceArea(const bx::Aabb& aabb)
+	{
+		const vec3 d = bx::sub(aabb.max, aabb.min);
+		return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+	}
+
+	bool Bvh::contains(const bx::Aabb& outer, const bx::Aabb& inner)
+	{
+		return outer.min.x <= inner.min.x && outer.min.y <= inner.min.y && outer.min.z <= inner.min.z
+			&& outer.max.x >= inner.max.x && outer.max.y >= inner.max.y && outer.max.z >= inner.max.z;
+	}
+
+	bool Bvh::overlaps(const bx::Aabb& a, const bx::Aabb& b)
+	{
+		return a.min.x <= b.max.x && a.max.x >= b.min.x
+			&& a.min.y <= b.max.y && a.max.y >= b.min.y
+			&& a.min.z <= b.max.z && a.max.z >= b.min.z;
+	}
+}
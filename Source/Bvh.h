@@ -0,0 +1,111 @@
+#pragma once
+
+
+#include <vector>
+
+#include <bx/bounds.h>
+
+#include <Culling.h>
+#include <Types.h>
+
+
+namespace zv
+{
+	class Object3D;
+
+	/*
+	Dynamic bounding volume hierarchy over scene objects.
+
+	Leaves store fattened world AABBs, so small moves only refit the ancestors.
+	Leaves that outgrow their fat box are queued and reinserted a few per frame
+	by rebuild(). Static content is best added in one go through build(), which
+	uses a binned SAH split instead of incremental insertion.
+
+	Objects without bounds stay out of the tree, their infinite boxes would
+	swamp every SAH cost and plane test. Culling and overlap queries always
+	return them, raycasts never hit them.
+	*/
+	class Bvh
+	{
+	public:
+		static constexpr s32 NullNode = -1;
+
+		Bvh() = default;
+		~Bvh() = default;
+
+	public:
+		// Replaces the tree with a SAH build over the objects. Returns proxies in order.
+		void build(const std::vector<Object3D*>& objects, std::vector<s32>& proxies);
+
+		s32 insert(Object3D* object);
+		void remove(s32 proxy);
+
+		// Call after the object's transform changed. Returns true if the leaf moved.
+		bool update(s32 proxy);
+
+		// Reinserts up to maxReinsertions leaves that were refitted since the last call.
+		void rebuild(u32 maxReinsertions);
+
+		void clear();
+
+	public:
+		void cull(const Frustum& frustum, std::vector<Object3D*>& visible) const;
+
+		// Nearest object whose bounds the ray hits within maxDistance, or NULL.
+		Object3D* raycast(const vec3& origin, const vec3& direction, f32 maxDistance, f32* hitDistance = NULL) const;
+
+		void overlap(const bx::Sphere& sphere, std::vector<Object3D*>& result) const;
+		void overlap(const bx::Aabb& aabb, std::vector<Object3D*>& result) const;
+
+		u32 numObjects() const { return m_numLeaves; }
+		u32 height() const;
+
+	private:
+		struct Node
+		{
+			bx::Aabb aabb;
+			Object3D* object;
+			s32 parent;
+			s32 left;
+			s32 right;
+			bool moved;
+			bool unbounded;
+
+			bool isLeaf() const { return NullNode == left; }
+		};
+
+		s32 allocateNode();
+		void freeNode(s32 node);
+
+		void insertLeaf(s32 leaf);
+		void removeLeaf(s32 leaf);
+
+		// Sets the leaf's fattened bounds, or files it as unbounded if the object has none.
+		void initLeaf(s32 leaf, bool fatten);
+		void removeUnbounded(s32 leaf);
+		void refitAncestors(s32 node);
+
+		s32 buildRecursive(std::vector<s32>& leaves, u32 begin, u32 end);
+
+		void collectLeaves(s32 node, std::vector<Object3D*>& result) const;
+		u32 height(s32 node) const;
+
+		static bx::Aabb merge(const bx::Aabb& a, const bx::Aabb& b);
+		static f32 surfaceArea(const bx::Aabb& aabb);
+		static bool contains(const bx::Aabb& outer, const bx::Aabb& inner);
+		static bool overlaps(const bx::Aabb& a, const bx::Aabb& b);
+
+	private:
+		// Margin added around dynamic leaves, in world units.
+		static constexpr f32 AabbMargin = 0.1f;
+
+		static constexpr u32 NumSahBins = 12;
+
+		std::vector<Node> m_nodes{};
+		std::vector<s32> m_moved{};
+		std::vector<s32> m_unbounded{};
+		s32 m_root{ NullNode };
+		s32 m_freeList{ NullNode };
+		u32 m_numLeaves{ 0 };
+	};
+}
@@ -79,4 +79,18 @@ namespace zv
 		//if (Input::keyPressed(SDLK_d))
 		//	m_position = bx::add(m_position, bx::mul(right, speed));
 	}
+
+	f32 Camera::screenSize(const bx::Aabb& aabb, f32 viewportHeight) const
+	{
+		// The bounding sphere of the box, projected at its distance from the eye.
+		const vec3 center = bx::mul(bx::add(aabb.min, aabb.max), 0.5f);
+		const f32 radius = bx::length(bx::sub(aabb.max, center));
+		const f32 distance = bx::length(bx::sub(center, m_position));
+
+		if (distance <= radius)
+			return viewportHeight;
+
+		const f32 tanHalfFov = bx::tan(bx::toRad(m_fov) * 0.5f);
+		return bx::min(radius / (distance * tanHalfFov) * viewportHeight, viewportHeight);
+	}
 }
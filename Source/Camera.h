@@ -3,6 +3,7 @@
 
 #include <bgfx/bgfx.h>
 
+#include <Culling.h>
 #include <Transform.h>
 #include <Types.h>
 
@@ -55,6 +56,26 @@ namespace zv
 
         void update(f32 elapsedTimeS);
 
+        const vec3& position() const { return m_position; }
+        f32 zNear() const { return m_zNear; }
+        f32 zFar() const { return m_zFar; }
+        f32 fov() const { return m_fov; }
+
+        // Approximate height in pixels of a world space box on a viewport viewportHeight pixels tall.
+        f32 screenSize(const bx::Aabb& aabb, f32 viewportHeight) const;
+
+        void viewProjMatrix(f32* result)
+        {
+            bx::mtxMul(result, viewMatrix(), projectionMatrix());
+        }
+
+        Frustum frustum()
+        {
+            f32 viewProj[16];
+            viewProjMatrix(viewProj);
+            return Frustum::fromViewProj(viewProj, bgfx::getCaps()->homogeneousDepth);
+        }
+
         vec3 forward() const { 
             return bx::normalize(
                 bx::mul(
@@ -0,0 +1,209 @@
+#include <Culling.h>
+
+
+#include <bx/math.h>
+#include <bx/simd_t.h>
+
+#include <Object3D.h>
+#include <Occlusion.h>
+
+
+namespace zv
+{
+	std::vector<Culling::AabbBlock> Culling::s_Blocks;
+	std::vector<bx::Aabb> Culling::s_Aabbs;
+	std::vector<u8> Culling::s_Visible;
+
+
+	Frustum Frustum::fromViewProj(const f32* viewProj, bool homogeneousDepth)
+	{
+		// Gribb/Hartmann. bx matrices transform row vectors, so clip = p * viewProj
+		// and each clip component is a column of the matrix.
+		auto column = [viewProj](u32 col, f32* out)
+		{
+			out[0] = viewProj[0 + col];
+			out[1] = viewProj[4 + col];
+			out[2] = viewProj[8 + col];
+			out[3] = viewProj[12 + col];
+		};
+
+		f32 x[4], y[4], z[4], w[4];
+		column(0, x);
+		column(1, y);
+		column(2, z);
+		column(3, w);
+
+		Frustum frustum;
+		for (u32 ii = 0; ii < 4; ++ii)
+		{
+			frustum.planes[Left][ii] = w[ii] + x[ii];
+			frustum.planes[Right][ii] = w[ii] - x[ii];
+			frustum.planes[Bottom][ii] = w[ii] + y[ii];
+			frustum.planes[Top][ii] = w[ii] - y[ii];
+			frustum.planes[Near][ii] = homogeneousDepth ? w[ii] + z[ii] : z[ii];
+			frustum.planes[Far][ii] = w[ii] - z[ii];
+		}
+
+		for (u32 ii = 0; ii < Count; ++ii)
+		{
+			f32* plane = frustum.planes[ii];
+			const f32 invLength = 1.0f / bx::sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+			plane[0] *= invLength;
+			plane[1] *= invLength;
+			plane[2] *= invLength;
+			plane[3] *= invLength;
+		}
+
+		return frustum;
+	}
+
+	void Culling::cull(const Frustum& frustum, const std::vector<Object3D*>& objects, std::vector<Object3D*>& visible)
+	{
+		const u32 numObjects = (u32)objects.size();
+
+		s_Aabbs.resize(numObjects);
+		s_Visible.resize(numObjects);
+
+		for (u32 ii = 0; ii < numObjects; ++ii)
+		{
+			if (!objects[ii]->worldAabb(s_Aabbs[ii]))
+			{
+				// Huge box, never culled. Finite so 0 * extent stays 0.
+				s_Aabbs[ii].min = { -UnboundedExtent, -UnboundedExtent, -UnboundedExtent };
+				s_Aabbs[ii].max = { UnboundedExtent, UnboundedExtent, UnboundedExtent };
+			}
+		}
+
+		cullAabbs(frustum, s_Aabbs.data(), numObjects, s_Visible.data());
+
+		for (u32 ii = 0; ii < numObjects; ++ii)
+		{
+			if (0 != s_Visible[ii])
+			{
+				visible.push_back(objects[ii]);
+			}
+		}
+	}
+
+	void Culling::drawOccluders(OcclusionBuffer& buffer, const std::vector<Object3D*>& occluders)
+	{
+		for (const Object3D* occluder : occluders)
+		{
+			const Geometry* geometry = occluder->geometry();
+			if (0 == geometry->numIndices())
+				continue;
+
+			geometry->visitIndices([&](const auto& indices)
+			{
+				buffer.rasterize(&geometry->vertices()[0].x, sizeof(Vertex), indices.data(),
+								 (u32)indices.size(), occluder->modelMatrix());
+			});
+		}
+	}
+
+	void Culling::cull(const OcclusionBuffer& buffer, const std::vector<Object3D*>& objects, std::vector<Object3D*>& visible)
+	{
+		for (Object3D* object : objects)
+		{
+			bx::Aabb aabb;
+			if (!object->worldAabb(aabb) || buffer.isVisible(aabb))
+			{
+				visible.push_back(object);
+			}
+		}
+	}
+
+	void Culling::cullAabbs(const Frustum& frustum, const bx::Aabb* aabbs, u32 count, u8* visible)
+	{
+		const u32 numBlocks = (count + 3) / 4;
+		s_Blocks.resize(numBlocks);
+
+		for (u32 ii = 0; ii < count; ++ii)
+		{
+			AabbBlock& block = s_Blocks[ii / 4];
+			const u32 lane = ii % 4;
+			const bx::Aabb& aabb = aabbs[ii];
+
+			block.centerX[lane] = (aabb.min.x + aabb.max.x) * 0.5f;
+			block.centerY[lane] = (aabb.min.y + aabb.max.y) * 0.5f;
+			block.centerZ[lane] = (aabb.min.z + aabb.max.z) * 0.5f;
+			block.extentX[lane] = (aabb.max.x - aabb.min.x) * 0.5f;
+			block.extentY[lane] = (aabb.max.y - aabb.min.y) * 0.5f;
+			block.extentZ[lane] = (aabb.max.z - aabb.min.z) * 0.5f;
+		}
+
+		// Pad the last block with empty boxes at the origin, their results are dropped.
+		for (u32 ii = count; ii < numBlocks * 4; ++ii)
+		{
+			AabbBlock& block = s_Blocks[ii / 4];
+			const u32 lane = ii % 4;
+			block.centerX[lane] = block.centerY[lane] = block.centerZ[lane] = 0.0f;
+			block.extentX[lane] = block.extentY[lane] = block.extentZ[lane] = 0.0f;
+		}
+
+		for (u32 ii = 0; ii < numBlocks; ++ii)
+		{
+			const u32 mask = testBlock(frustum, s_Blocks[ii]);
+
+			const u32 first = ii * 4;
+			const u32 num = bx::min<u32>(4, count - first);
+			for (u32 lane = 0; lane < num; ++lane)
+			{
+				visible[first + lane] = u8(0 == (mask & (1u << lane)));
+			}
+		}
+	}
+
+	u32 Culling::testBlock(const Frustum& frustum, const AabbBlock& block)
+	{
+		using namespace bx;
+
+		const simd128_t cx = simd_ld<simd128_t>(block.centerX);
+		const simd128_t cy = simd_ld<simd128_t>(block.centerY);
+		const simd128_t cz = simd_ld<simd128_t>(block.centerZ);
+		const simd128_t ex = simd_ld<simd128_t>(block.extentX);
+		const simd128_t ey = simd_ld<simd128_t>(block.extentY);
+		const simd128_t ez = simd_ld<simd128_t>(block.extentZ);
+
+		// A box is outside when dot(n, c) + d + dot(|n|, e) < 0 for any plane. OR-ing
+		// the sums accumulates the sign bits, one per box.
+		simd128_t outside = simd_zero<simd128_t>();
+
+		for (u32 ii = 0; ii < Frustum::Count; ++ii)
+		{
+			const f32* plane = frustum.planes[ii];
+
+			const simd128_t nx = simd_splat<simd128_t>(plane[0]);
+			const simd128_t ny = simd_splat<simd128_t>(plane[1]);
+			const simd128_t nz = simd_splat<simd128_t>(plane[2]);
+			const simd128_t d = simd_splat<simd128_t>(plane[3]);
+			const simd128_t ax = simd_splat<simd128_t>(bx::abs(plane[0]));
+			const simd128_t ay = simd_splat<simd128_t>(bx::abs(plane[1]));
+			const simd128_t az = simd_splat<simd128_t>(bx::abs(plane[2]));
+
+			const simd128_t dist = simd_madd(nx, cx, simd_madd(ny, cy, simd_madd(nz, cz, d)));
+			const simd128_t radius = simd_madd(ax, ex, simd_madd(ay, ey, simd_mul(az, ez)));
+
+			outside = simd_or(outside, simd_add(dist, radius));
+		}
+
+		return u32(simd_signbits(outside));
+	}
+
+	void Culling::transformAabb(bx::Aabb& result, const bx::Aabb& aabb, const f32* mtx)
+	{
+		// Arvo: transform the center, grow the extents by the absolute rotation.
+		const vec3 center = bx::mul(bx::add(aabb.min, aabb.max), 0.5f);
+		const vec3 extent = bx::mul(bx::sub(aabb.max, aabb.min), 0.5f);
+
+		const vec3 worldCenter = bx::mul(center, mtx);
+		const vec3 worldExtent = {
+			bx::abs(mtx[0]) * extent.x + bx::abs(mtx[4]) * extent.y + bx::abs(mtx[8]) * extent.z,
+			bx::abs(mtx[1]) * extent.x + bx::abs(mtx[5]) * extent.y + bx::abs(mtx[9]) * extent.z,
+			bx::abs(mtx[2]) * extent.x + bx::abs(mtx[6]) * extent.y + bx::abs(mtx[10]) * extent.z,
+		};
+
+		result.min = bx::sub(worldCenter, worldExtent);
+		result.max = bx::add(worldCenter, worldExtent);
+	}
+}
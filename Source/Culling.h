@@ -0,0 +1,71 @@
+#pragma once
+
+
+#include <vector>
+
+#include <bx/bounds.h>
+
+#include <Types.h>
+
+
+namespace zv
+{
+	class Object3D;
+	class OcclusionBuffer;
+
+	// Six planes (nx, ny, nz, d), normals pointing inwards: a point p is inside
+	// a plane when dot(n, p) + d >= 0.
+	struct Frustum
+	{
+		enum Plane { Left, Right, Bottom, Top, Near, Far, Count };
+
+		f32 planes[Count][4];
+
+		static Frustum fromViewProj(const f32* viewProj, bool homogeneousDepth);
+	};
+
+	class Culling
+	{
+	private:
+		Culling() = default;
+
+	public:
+		// Appends the objects whose world bounds intersect the frustum to visible.
+		// Objects without bounds are always kept.
+		static void cull(const Frustum& frustum, const std::vector<Object3D*>& objects, std::vector<Object3D*>& visible);
+
+		// Writes one flag per box, 1 when it intersects the frustum. Boxes are
+		// given as center/extents, four per SIMD iteration.
+		static void cullAabbs(const Frustum& frustum, const bx::Aabb* aabbs, u32 count, u8* visible);
+
+		// Rasterizes the geometry of the occluders into buffer. Build its Hi-Z afterwards.
+		static void drawOccluders(OcclusionBuffer& buffer, const std::vector<Object3D*>& occluders);
+
+		// Appends the objects that are not hidden behind the occluders in buffer to visible.
+		// Objects without bounds are always kept.
+		static void cull(const OcclusionBuffer& buffer, const std::vector<Object3D*>& objects, std::vector<Object3D*>& visible);
+
+		static void transformAabb(bx::Aabb& result, const bx::Aabb& aabb, const f32* mtx);
+
+	private:
+		// Four boxes in SoA layout.
+		struct alignas(16) AabbBlock
+		{
+			f32 centerX[4];
+			f32 centerY[4];
+			f32 centerZ[4];
+			f32 extentX[4];
+			f32 extentY[4];
+			f32 extentZ[4];
+		};
+
+		static u32 testBlock(const Frustum& frustum, const AabbBlock& block);
+
+		static constexpr f32 UnboundedExtent = 1.0e18f;
+
+		// Scratch buffers, only touched from the API thread.
+		static std::vector<AabbBlock> s_Blocks;
+		static std::vector<bx::Aabb> s_Aabbs;
+		static std::vector<u8> s_Visible;
+	};
+}
@@ -7,8 +7,18 @@ namespace zv
 {
     PlaneGeometry::PlaneGeometry(f32 width, f32 height, u32 widthSegments, u32 heightSegments)
     {
-        Vertex::init();
+        if (fitsIndex16(size_t(widthSegments + 1) * (heightSegments + 1)))
+            build(width, height, widthSegments, heightSegments, m_indices16);
+        else
+            build(width, height, widthSegments, heightSegments, m_indices32);
 
+        calcTangents();
+        initializeBuffers();
+    }
+
+    template <typename IndexT>
+    void PlaneGeometry::build(f32 width, f32 height, u32 widthSegments, u32 heightSegments, std::vector<IndexT>& indices)
+    {
         f32 widthHalf = width * 0.5f;
         f32 heightHalf = height * 0.5f;
 
@@ -21,11 +31,11 @@ namespace zv
         f32 segment_width = (f32)width / (f32)gridX;
         f32 segment_height = (f32)height / (f32)gridY;
 
-        for (s16 iy = 0; iy < gridY1; iy++) {
+        for (u32 iy = 0; iy < gridY1; iy++) {
 
             f32 y = iy * segment_height - heightHalf;
 
-            for (s16 ix = 0; ix < gridX1; ix++) {
+            for (u32 ix = 0; ix < gridX1; ix++) {
 
                 f32 x = ix * segment_width - widthHalf;
 
@@ -47,59 +57,55 @@ namespace zv
 
             for (u32 ix = 0; ix < gridX; ix++) {
 
-                u16 a = ix + gridX1 * iy;
-                u16 b = ix + gridX1 * (iy + 1);
-                u16 c = (ix + 1) + gridX1 * (iy + 1);
-                u16 d = (ix + 1) + gridX1 * iy;
+                IndexT a = ix + gridX1 * iy;
+                IndexT b = ix + gridX1 * (iy + 1);
+                IndexT c = (ix + 1) + gridX1 * (iy + 1);
+                IndexT d = (ix + 1) + gridX1 * iy;
 
-                m_indices.insert(m_indices.end(), { a, b, d });
-                m_indices.insert(m_indices.end(), { b, c, d });
+                indices.insert(indices.end(), { a, b, d });
+                indices.insert(indices.end(), { b, c, d });
 
             }
         }
-
-        utils::calcTangents(
-            m_vertices.data(),
-            m_vertices.size(),
-            Vertex::s_Layout,
-            m_indices.data(),
-            m_indices.size()
-        );
-
-        initializeBuffers();
     }
 
 	CubeGeometry::CubeGeometry(f32 width, f32 height, f32 depth, u32 widthSegments, u32 heightSegments, u32 depthSegments)
 	{
-        Vertex::init();
+		// Two of each face.
+		const size_t numVertices = 2 * (size_t(depthSegments + 1) * (heightSegments + 1)
+			+ size_t(widthSegments + 1) * (depthSegments + 1)
+			+ size_t(widthSegments + 1) * (heightSegments + 1));
 
-		u16 numVertices = 0;
+		if (fitsIndex16(numVertices))
+			build(width, height, depth, widthSegments, heightSegments, depthSegments, m_indices16);
+		else
+			build(width, height, depth, widthSegments, heightSegments, depthSegments, m_indices32);
 
-		buildPlane(2, 1, 0, -1, -1, depth, height, width, depthSegments, heightSegments, m_vertices, m_indices, &numVertices); // px
-		buildPlane(0, 2, 1, 1, 1, width, depth, height, widthSegments, depthSegments, m_vertices, m_indices, &numVertices); // py
-		buildPlane(0, 1, 2, 1, -1, width, height, depth, widthSegments, heightSegments, m_vertices, m_indices, &numVertices); // pz
+        calcTangents();
+        initializeBuffers();
+    }
 
-		buildPlane(2, 1, 0, 1, -1, depth, height, -width, depthSegments, heightSegments, m_vertices, m_indices, &numVertices); // nx
-		buildPlane(0, 2, 1, 1, -1, width, depth, -height, widthSegments, depthSegments, m_vertices, m_indices, &numVertices); // ny
-		buildPlane(0, 1, 2, -1, -1, width, height, -depth, widthSegments, heightSegments, m_vertices, m_indices, &numVertices); // nz
+	template <typename IndexT>
+	void CubeGeometry::build(f32 width, f32 height, f32 depth, u32 widthSegments, u32 heightSegments, u32 depthSegments, std::vector<IndexT>& indices)
+	{
+		u32 numVertices = 0;
 
-        utils::calcTangents(
-            m_vertices.data(),
-            m_vertices.size(),
-            Vertex::s_Layout,
-            m_indices.data(),
-            m_indices.size()
-        );
+		buildPlane(2, 1, 0, -1, -1, depth, height, width, depthSegments, heightSegments, m_vertices, indices, &numVertices); // px
+		buildPlane(0, 2, 1, 1, 1, width, depth, height, widthSegments, depthSegments, m_vertices, indices, &numVertices); // py
+		buildPlane(0, 1, 2, 1, -1, width, height, depth, widthSegments, heightSegments, m_vertices, indices, &numVertices); // pz
 
-        initializeBuffers();
-    }
+		buildPlane(2, 1, 0, 1, -1, depth, height, -width, depthSegments, heightSegments, m_vertices, indices, &numVertices); // nx
+		buildPlane(0, 2, 1, 1, -1, width, depth, -height, widthSegments, depthSegments, m_vertices, indices, &numVertices); // ny
+		buildPlane(0, 1, 2, -1, -1, width, height, -depth, widthSegments, heightSegments, m_vertices, indices, &numVertices); // nz
+	}
 
+	template <typename IndexT>
 	void CubeGeometry::buildPlane(
 		s32 u, s32 v, s32 w, 
 		s32 uDir, s32 vDir, 
 		f32 width, f32 height, 
-		f32 depth, s16 gridX, s16 gridY,
-		std::vector<Vertex>& vertices, std::vector<u16>& indices, u16* numVertices)
+		f32 depth, u32 gridX, u32 gridY,
+		std::vector<Vertex>& vertices, std::vector<IndexT>& indices, u32* numVertices)
 	{
         f32 segmentWidth = width / (f32)gridX;
         f32 segmentHeight = height / (f32)gridY;
@@ -108,8 +114,8 @@ namespace zv
         f32 heightHalf = height * 0.5f;
         f32 depthHalf = depth * 0.5f;
 
-        s16 gridX1 = gridX + 1;
-        s16 gridY1 = gridY + 1;
+        u32 gridX1 = gridX + 1;
+        u32 gridY1 = gridY + 1;
 
         u32 vertexCounter = 0;
 
@@ -118,11 +124,11 @@ namespace zv
 
         // generate vertices, normals and uvs
 
-        for (s16 iy = 0; iy < gridY1; iy++) {
+        for (u32 iy = 0; iy < gridY1; iy++) {
 
             f32 y = (f32)iy * segmentHeight - heightHalf;
 
-            for (s16 ix = 0; ix < gridX1; ix++) {
+            for (u32 ix = 0; ix < gridX1; ix++) {
 
                 f32 x = (f32)ix * segmentWidth - widthHalf;
 
@@ -165,10 +171,10 @@ namespace zv
 
             for (u32 ix = 0; ix < gridX; ix++) {
 
-                u16 a = *numVertices + ix + gridX1 * iy;
-                u16 b = *numVertices + ix + gridX1 * (iy + 1);
-                u16 c = *numVertices + (ix + 1) + gridX1 * (iy + 1);
-                u16 d = *numVertices + (ix + 1) + gridX1 * iy;
+                IndexT a = *numVertices + ix + gridX1 * iy;
+                IndexT b = *numVertices + ix + gridX1 * (iy + 1);
+                IndexT c = *numVertices + (ix + 1) + gridX1 * (iy + 1);
+                IndexT d = *numVertices + (ix + 1) + gridX1 * iy;
 
                 // faces
                 indices.insert(indices.end(), { a, b, d });
@@ -183,15 +189,32 @@ namespace zv
 
     CylinderGeometry::CylinderGeometry(f32 radiusTop, f32 radiusBottom, f32 height, u32 radialSegments, u32 heightSegments, f32 thetaStart, f32 thetaLength)
     {
-        u16 index = 0;
-        std::vector<std::vector<u16>> indexArray;
+        // The torso, plus per cap a center and a rim vertex per segment and one to close the rim.
+        size_t numVertices = size_t(radialSegments + 1) * (heightSegments + 1);
+        if (radiusTop > 0.0f) numVertices += 2 * radialSegments + 1;
+        if (radiusBottom > 0.0f) numVertices += 2 * radialSegments + 1;
+
+        if (fitsIndex16(numVertices))
+            build(radiusTop, radiusBottom, height, radialSegments, heightSegments, thetaStart, thetaLength, m_indices16);
+        else
+            build(radiusTop, radiusBottom, height, radialSegments, heightSegments, thetaStart, thetaLength, m_indices32);
+
+        calcTangents();
+        initializeBuffers();
+    }
+
+    template <typename IndexT>
+    void CylinderGeometry::build(f32 radiusTop, f32 radiusBottom, f32 height, u32 radialSegments, u32 heightSegments, f32 thetaStart, f32 thetaLength, std::vector<IndexT>& indices)
+    {
+        IndexT index = 0;
+        std::vector<std::vector<IndexT>> indexArray;
 
         auto generateTorso = [](
             f32 radiusTop, f32 radiusBottom, f32 height, 
             u32 radialSegments, u32 heightSegments, 
             f32 thetaStart, f32 thetaLength, 
-            std::vector<Vertex>& vertices, std::vector<u16>& indices, 
-            u16* index, std::vector<std::vector<u16>>& indexArray)
+            std::vector<Vertex>& vertices, std::vector<IndexT>& indices, 
+            IndexT* index, std::vector<std::vector<IndexT>>& indexArray)
         {
             f32 halfHeight = height * 0.5f;
 
@@ -201,7 +224,7 @@ namespace zv
             // generate vertices, normals and uvs
             for (u32 iy = 0; iy <= heightSegments; iy++) {
 
-                std::vector<u16> indexRow;
+                std::vector<IndexT> indexRow;
 
                 s16 v = iy / heightSegments;
 
@@ -245,15 +268,15 @@ namespace zv
             }
 
             // generate indices
-            for (u16 x = 0; x < radialSegments; x++) {
+            for (u32 x = 0; x < radialSegments; x++) {
 
-                for (u16 y = 0; y < heightSegments; y++) {
+                for (u32 y = 0; y < heightSegments; y++) {
 
                     // we use the index array to access the correct indices
-                    u16 a = indexArray[y][x];
-                    u16 b = indexArray[y + 1][x];
-                    u16 c = indexArray[y + 1][x + 1];
-                    u16 d = indexArray[y][x + 1];
+                    IndexT a = indexArray[y][x];
+                    IndexT b = indexArray[y + 1][x];
+                    IndexT c = indexArray[y + 1][x + 1];
+                    IndexT d = indexArray[y][x + 1];
 
                     // faces
                     indices.insert(indices.end(), { a, b, d });
@@ -262,12 +285,12 @@ namespace zv
             }
         };
 
-        auto generateCap = [](bool top, f32 radiusTop, f32 radiusBottom, f32 height, u32 radialSegments, f32 thetaStart, f32 thetaLength, std::vector<Vertex>& vertices, std::vector<u16>& indices, u16* index)
+        auto generateCap = [](bool top, f32 radiusTop, f32 radiusBottom, f32 height, u32 radialSegments, f32 thetaStart, f32 thetaLength, std::vector<Vertex>& vertices, std::vector<IndexT>& indices, IndexT* index)
         {
             f32 halfHeight = height * 0.5f;
             
             // save the index of the first center vertex
-            u16 centerIndexStart = *index;
+            IndexT centerIndexStart = *index;
 
             f32 radius = top ? radiusTop : radiusBottom;
             f32 sign = top ? 1.0f : -1.0f;
@@ -293,7 +316,7 @@ namespace zv
             }
 
             // save the index of the last center vertex
-            u16 centerIndexEnd = *index;
+            IndexT centerIndexEnd = *index;
 
             // now we generate the surrounding vertices, normals and uvs
             for (u32 ix = 0; ix <= radialSegments; ix++) {
@@ -327,18 +350,18 @@ namespace zv
             }
 
             // generate indices
-            for (u16 ix = 0; ix < radialSegments; ix++) {
+            for (u32 ix = 0; ix < radialSegments; ix++) {
 
-                u16 c = centerIndexStart + ix;
-                u16 i = centerIndexEnd + ix;
+                IndexT c = centerIndexStart + ix;
+                IndexT i = centerIndexEnd + ix;
 
                 if (top) {
                     // face top
-                    indices.insert(indices.end(), { i, (u16)(i + 1), c });
+                    indices.insert(indices.end(), { i, (IndexT)(i + 1), c });
                 }
                 else {
                     // face bottom
-                    indices.insert(indices.end(), { (u16)(i + 1), i, c });
+                    indices.insert(indices.end(), { (IndexT)(i + 1), i, c });
                 }
             }
         };
@@ -347,19 +370,9 @@ namespace zv
             radiusTop, radiusBottom, height,
             radialSegments, heightSegments,
             thetaStart, thetaLength,
-            m_vertices, m_indices,
+            m_vertices, indices,
             &index, indexArray);
-        if (radiusTop > 0.0f) generateCap(true, radiusTop, radiusBottom, height, radialSegments, thetaStart, thetaLength, m_vertices, m_indices, &index);
-        if (radiusBottom > 0.0f) generateCap(false, radiusTop, radiusBottom, height, radialSegments, thetaStart, thetaLength, m_vertices, m_indices, &index);
-
-        utils::calcTangents(
-            m_vertices.data(),
-            m_vertices.size(),
-            Vertex::s_Layout,
-            m_indices.data(),
-            m_indices.size()
-        );
-
-        initializeBuffers();
+        if (radiusTop > 0.0f) generateCap(true, radiusTop, radiusBottom, height, radialSegments, thetaStart, thetaLength, m_vertices, indices, &index);
+        if (radiusBottom > 0.0f) generateCap(false, radiusTop, radiusBottom, height, radialSegments, thetaStart, thetaLength, m_vertices, indices, &index);
     }
 }
\ No newline at end of file
@@ -17,6 +17,10 @@ namespace zv
 			f32 width = 1.0f, f32 height = 1.0f,
 			u32 widthSegments = 1, u32 heightSegments = 1);
 		~PlaneGeometry() = default;
+
+	private:
+		template <typename IndexT>
+		void build(f32 width, f32 height, u32 widthSegments, u32 heightSegments, std::vector<IndexT>& indices);
 	};
 
 	class CubeGeometry : public Geometry
@@ -28,8 +32,12 @@ namespace zv
 		~CubeGeometry() = default;
 
 	private:
-		void buildPlane(s32 u, s32 v, s32 w, s32 uDir, s32 vDir, f32 width, f32 height, f32 depth, s16 gridX, s16 gridY,
-						 std::vector<Vertex>& vertices, std::vector<u16>& indices, u16* num_vertices);
+		template <typename IndexT>
+		void build(f32 width, f32 height, f32 depth, u32 widthSegments, u32 heightSegments, u32 depthSegments, std::vector<IndexT>& indices);
+
+		template <typename IndexT>
+		void buildPlane(s32 u, s32 v, s32 w, s32 uDir, s32 vDir, f32 width, f32 height, f32 depth, u32 gridX, u32 gridY,
+						 std::vector<Vertex>& vertices, std::vector<IndexT>& indices, u32* num_vertices);
 	};
 
 	// TODO: Cylinder, Cone
@@ -39,5 +47,9 @@ namespace zv
 	public:
 		CylinderGeometry(f32 radiusTop = 1.0f, f32 radiusBottom = 1, f32 height = 1, u32 radialSegments = 32, u32 heightSegments = 1, f32 thetaStart = 0.0f, f32 thetaLength = bx::kPi * 2.0f);
 		~CylinderGeometry() = default;
+
+	private:
+		template <typename IndexT>
+		void build(f32 radiusTop, f32 radiusBottom, f32 height, u32 radialSegments, u32 heightSegments, f32 thetaStart, f32 thetaLength, std::vector<IndexT>& indices);
 	};
 }
\ No newline at end of file
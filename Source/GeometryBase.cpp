@@ -1,33 +1,222 @@
 #include <GeometryBase.h>
 
 
+#include <bx/math.h>
+#include <bx/pixelformat.h>
+
+
 namespace zv
 {
-	bgfx::VertexLayout Vertex::s_Layout;
+	Geometry::~Geometry()
+	{
+		BX_ASSERT(!buffersInFlight(), "Geometry destroyed while bgfx still references its buffers.");
+	}
 
 	void Geometry::cleanup()
 	{
 		bgfx::destroy(m_hIndexBuffer);
+		bgfx::destroy(m_hPositionBuffer);
 		bgfx::destroy(m_hVertexBuffer);
 	}
 
-	void Geometry::bindBuffers() const
+	void Geometry::bindBuffers(bgfx::Encoder* encoder, u32 firstIndex, u32 numIndices, bool positionOnly) const
 	{
-		bgfx::setVertexBuffer(0, m_hVertexBuffer);
-		bgfx::setIndexBuffer(m_hIndexBuffer);
+		encoder->setVertexBuffer(0, positionOnly ? m_hPositionBuffer : m_hVertexBuffer);
+		encoder->setIndexBuffer(m_hIndexBuffer, firstIndex, numIndices);
 	}
 
-	void Geometry::initializeBuffers()
+	void Geometry::calcTangents()
 	{
-		// Create static vertex buffer.
-		m_hVertexBuffer = bgfx::createVertexBuffer(
-			bgfx::makeRef(m_vertices.data(), sizeof(Vertex) * m_vertices.size()),
-			Vertex::s_Layout
-		);
+		if (m_indices32.empty())
+			calcTangents(m_indices16);
+		else
+			calcTangents(m_indices32);
+	}
+
+	template <typename IndexT>
+	void Geometry::calcTangents(const std::vector<IndexT>& _indices)
+	{
+		// Per vertex sums of the triangle tangents and bitangents around it.
+		std::vector<vec3> tangents(m_vertices.size(), { 0.0f, 0.0f, 0.0f });
+		std::vector<vec3> bitangents(m_vertices.size(), { 0.0f, 0.0f, 0.0f });
+
+		for (size_t ii = 0; ii + 2 < _indices.size(); ii += 3)
+		{
+			const Vertex& v0 = m_vertices[_indices[ii + 0]];
+			const Vertex& v1 = m_vertices[_indices[ii + 1]];
+			const Vertex& v2 = m_vertices[_indices[ii + 2]];
+
+			const vec3 edge1 = { v1.x - v0.x, v1.y - v0.y, v1.z - v0.z };
+			const vec3 edge2 = { v2.x - v0.x, v2.y - v0.y, v2.z - v0.z };
+
+			// Texture coordinates are normalized s16.
+			const f32 du1 = f32(v1.u - v0.u) / 32767.0f;
+			const f32 dv1 = f32(v1.v - v0.v) / 32767.0f;
+			const f32 du2 = f32(v2.u - v0.u) / 32767.0f;
+			const f32 dv2 = f32(v2.v - v0.v) / 32767.0f;
+
+			const f32 det = du1 * dv2 - du2 * dv1;
+			if (0.0f == det)
+				continue;
+
+			const f32 invDet = 1.0f / det;
+			const vec3 tangent = bx::mul(bx::sub(bx::mul(edge1, dv2), bx::mul(edge2, dv1)), invDet);
+			const vec3 bitangent = bx::mul(bx::sub(bx::mul(edge2, du1), bx::mul(edge1, du2)), invDet);
+
+			for (u32 corner = 0; corner < 3; ++corner)
+			{
+				const IndexT index = _indices[ii + corner];
+				tangents[index] = bx::add(tangents[index], tangent);
+				bitangents[index] = bx::add(bitangents[index], bitangent);
+			}
+		}
+
+		for (size_t ii = 0; ii < m_vertices.size(); ++ii)
+		{
+			Vertex& vertex = m_vertices[ii];
+
+			f32 packed[4];
+			bx::unpackRgba8(packed, &vertex.normal);
+			const vec3 normal = { packed[0] * 2.0f - 1.0f, packed[1] * 2.0f - 1.0f, packed[2] * 2.0f - 1.0f };
+
+			// Orthogonal to the normal, w is the bitangent handedness.
+			vec3 tangent = bx::sub(tangents[ii], bx::mul(normal, bx::dot(normal, tangents[ii])));
+			const f32 length = bx::length(tangent);
+			tangent = 0.0f < length ? bx::mul(tangent, 1.0f / length) : vec3{ 1.0f, 0.0f, 0.0f };
+			const f32 handedness = bx::dot(bx::cross(normal, tangent), bitangents[ii]) < 0.0f ? -1.0f : 1.0f;
+
+			packed[0] = tangent.x * 0.5f + 0.5f;
+			packed[1] = tangent.y * 0.5f + 0.5f;
+			packed[2] = tangent.z * 0.5f + 0.5f;
+			packed[3] = handedness * 0.5f + 0.5f;
+			bx::packRgba8(&vertex.tangent, packed);
+		}
+	}
+
+	void Geometry::initializeBuffers(bool _optimize)
+	{
+		if (m_indices32.empty())
+			optimize(m_indices16, _optimize);
+		else
+			optimize(m_indices32, _optimize);
+
+		selectIndexWidth();
+		calcBounds();
+
+		switch (VertexFormats::active())
+		{
+		case ZV_VERTEX_FORMAT_HALF:    createVertexBuffers<VertexFormat<PositionHalf>>();    break;
+		case ZV_VERTEX_FORMAT_SNORM16: createVertexBuffers<VertexFormat<PositionSnorm16>>(); break;
+		default:                       createVertexBuffers<VertexFormat<PositionFloat>>();   break;
+		}
 
 		// Create static index buffer.
-		m_hIndexBuffer = bgfx::createIndexBuffer(
-			bgfx::makeRef(m_indices.data(), sizeof(u16) * m_indices.size())
+		if (m_index32)
+		{
+			m_hIndexBuffer = bgfx::createIndexBuffer(
+				makeRef(m_indices32.data(), u32(sizeof(u32) * m_indices32.size())),
+				BGFX_BUFFER_INDEX32
+			);
+		}
+		else
+		{
+			m_hIndexBuffer = bgfx::createIndexBuffer(
+				makeRef(m_indices16.data(), u32(sizeof(u16) * m_indices16.size()))
+			);
+		}
+	}
+
+	template <typename IndexT>
+	void Geometry::optimize(std::vector<IndexT>& _indices, bool _reorder)
+	{
+		m_generatedCacheStats = IndexOptimizer::analyze(_indices.data(), u32(_indices.size()), u32(m_vertices.size()));
+		m_optimizedCacheStats = m_generatedCacheStats;
+		if (!_reorder)
+			return;
+
+		const u32 numVertices = IndexOptimizer::optimize(m_vertices.data(), u32(m_vertices.size()), u32(sizeof(Vertex)), _indices.data(), u32(_indices.size()));
+		m_vertices.resize(numVertices);
+
+		m_optimizedCacheStats = IndexOptimizer::analyze(_indices.data(), u32(_indices.size()), u32(m_vertices.size()));
+	}
+
+	void Geometry::selectIndexWidth()
+	{
+		BX_ASSERT(m_indices16.empty() || m_indices32.empty(), "Geometry filled both index widths.");
+		BX_ASSERT(!m_indices32.empty() || fitsIndex16(m_vertices.size()), "Geometry needs 32-bit indices for %u vertices.", u32(m_vertices.size()));
+
+		// The optimizer drops unused vertices, what needed 32 bits when generated may fit 16 now.
+		if (!m_indices32.empty() && fitsIndex16(m_vertices.size()))
+		{
+			m_indices16.assign(m_indices32.begin(), m_indices32.end());
+			m_indices32.clear();
+			m_indices32.shrink_to_fit();
+		}
+
+		m_index32 = !m_indices32.empty();
+	}
+
+	template <typename FormatT>
+	void Geometry::createVertexBuffers()
+	{
+		// Quantized positions span the bounds, which calcBounds() has just updated.
+		m_dequant = FormatT::dequant(m_aabb);
+		m_packedVertices.resize(sizeof(typename FormatT::Packed) * m_vertices.size());
+		m_packedPositions.resize(sizeof(typename FormatT::Position) * m_vertices.size());
+		FormatT::encode(m_vertices, m_dequant, (typename FormatT::Packed*)m_packedVertices.data(), (typename FormatT::Position*)m_packedPositions.data());
+
+		// Create static vertex buffers, all attributes and positions only.
+		m_hVertexBuffer = bgfx::createVertexBuffer(
+			makeRef(m_packedVertices.data(), u32(m_packedVertices.size())),
+			FormatT::s_Layout
+		);
+		m_hPositionBuffer = bgfx::createVertexBuffer(
+			makeRef(m_packedPositions.data(), u32(m_packedPositions.size())),
+			FormatT::s_PositionLayout
 		);
 	}
+
+	void Geometry::calcBounds()
+	{
+		if (m_vertices.empty())
+			return;
+
+		vec3 min = { m_vertices[0].x, m_vertices[0].y, m_vertices[0].z };
+		vec3 max = min;
+		for (const Vertex& vertex : m_vertices)
+		{
+			const vec3 position = { vertex.x, vertex.y, vertex.z };
+			min = bx::min(min, position);
+			max = bx::max(max, position);
+		}
+
+		m_aabb.min = min;
+		m_aabb.max = max;
+
+		// Centered on the box, tighter than its half diagonal.
+		const vec3 center = bx::mul(bx::add(min, max), 0.5f);
+		f32 radiusSq = 0.0f;
+		for (const Vertex& vertex : m_vertices)
+		{
+			const vec3 offset = bx::sub({ vertex.x, vertex.y, vertex.z }, center);
+			radiusSq = bx::max(radiusSq, bx::dot(offset, offset));
+		}
+
+		m_sphere.center = center;
+		m_sphere.radius = bx::sqrt(radiusSq);
+	}
+
+	const bgfx::Memory* Geometry::makeRef(const void* data, u32 size)
+	{
+		// Released on whichever thread consumes the memory, i.e. the render thread.
+		m_numPendingRefs.fetch_add(1);
+		return bgfx::makeRef(data, size, releaseRefCb, this);
+	}
+
+	void Geometry::releaseRefCb(void* _ptr, void* _userData)
+	{
+		BX_UNUSED(_ptr);
+		Geometry* geometry = (Geometry*)_userData;
+		geometry->m_numPendingRefs.fetch_sub(1);
+	}
 }
@@ -1,58 +1,125 @@
 #pragma once
 
 
+#include <atomic>
 #include <vector>
 
 #include <bgfx/bgfx.h>
+#include <bx/bounds.h>
 
+#include <IndexOptimizer.h>
 #include <Types.h>
+#include <VertexFormat.h>
 
 
 namespace zv
 {
-    struct Vertex
-    {
-        f32 x;
-        f32 y;
-        f32 z;
-        u32 normal;
-        u32 tangent;
-        s16 u;
-        s16 v;
-
-        static void init()
-        {
-            s_Layout
-                .begin()
-                .add(bgfx::Attrib::Position, 3, bgfx::AttribType::Float)
-                .add(bgfx::Attrib::Normal, 4, bgfx::AttribType::Uint8, true, true)
-                .add(bgfx::Attrib::Tangent, 4, bgfx::AttribType::Uint8, true, true)
-                .add(bgfx::Attrib::TexCoord0, 2, bgfx::AttribType::Int16, true, true)
-                .end();
-        }
-
-        static bgfx::VertexLayout s_Layout;
-    };
-
 	class Geometry
 	{
 	public:
         Geometry() = default;
-		~Geometry() = default;
+		~Geometry();
     
     public:
         virtual void cleanup();
         
-        void bindBuffers() const;
+        // With positionOnly the stream holding just positions is bound, for depth only programs.
+        void bindBuffers(bgfx::Encoder* encoder, u32 firstIndex = 0, u32 numIndices = UINT32_MAX, bool positionOnly = false) const;
+
+        // 16-bit indices whenever they address every vertex, 32-bit only beyond that.
+        static bool fitsIndex16(size_t _numVertices) { return _numVertices <= UINT16_MAX + 1; }
+
+        const std::vector<Vertex>& vertices() const { return m_vertices; }
+
+        // The width is picked by initializeBuffers(), only the matching indices<>() holds them.
+        bool index32() const { return m_index32; }
+        u32 numIndices() const { return m_index32 ? u32(m_indices32.size()) : u32(m_indices16.size()); }
+
+        template <typename IndexT>
+        const std::vector<IndexT>& indices() const;
+
+        // Calls _fn with the indices in use, for code that handles either width.
+        template <typename FnT>
+        void visitIndices(FnT&& _fn) const
+        {
+            if (m_index32)
+                _fn(m_indices32);
+            else
+                _fn(m_indices16);
+        }
+
+        const bgfx::VertexBufferHandle& vertexBuffer() const { return m_hVertexBuffer; }
+        const bgfx::VertexBufferHandle& positionBuffer() const { return m_hPositionBuffer; }
+        const bgfx::IndexBufferHandle& indexBuffer() const { return m_hIndexBuffer; }
+
+        // Object space bounds, valid once initializeBuffers() ran.
+        const bx::Aabb& aabb() const { return m_aabb; }
+        const bx::Sphere& boundingSphere() const { return m_sphere; }
+
+        // Maps the stored positions back to object space, u_vertexDequant for every draw.
+        const PositionDequant& dequant() const { return m_dequant; }
+
+        // Vertex cache use of the indices as generated and as uploaded, see IndexOptimizer.
+        const VertexCacheStats& generatedCacheStats() const { return m_generatedCacheStats; }
+        const VertexCacheStats& optimizedCacheStats() const { return m_optimizedCacheStats; }
+
+        // The encoded vertices and the indices are handed to bgfx by reference. Until
+        // bgfx releases them (a frame later, two with a render thread) they must not
+        // be resized, written or freed.
+        bool buffersInFlight() const { return 0 != m_numPendingRefs.load(); }
 
 	protected:
-        void initializeBuffers();
+        // Generators fill m_indices16, or m_indices32 when fitsIndex16() fails for their vertex count.
+        void calcTangents();
+
+        // Optimizes the triangle and vertex order first, generators emit them in whatever order is simplest.
+        // Without _optimize the order is kept, for indices others refer to by position.
+        void initializeBuffers(bool _optimize = true);
+
+    private:
+        template <typename IndexT>
+        void calcTangents(const std::vector<IndexT>& _indices);
+        template <typename IndexT>
+        void optimize(std::vector<IndexT>& _indices, bool _reorder);
+        void selectIndexWidth();
+        void calcBounds();
+
+        // Encodes m_vertices in FormatT and creates both vertex streams from it.
+        template <typename FormatT>
+        void createVertexBuffers();
+
+        const bgfx::Memory* makeRef(const void* data, u32 size);
+
+        static void releaseRefCb(void* _ptr, void* _userData);
 
 	protected:
         std::vector<Vertex> m_vertices{};
-        std::vector<u16> m_indices{};
+        std::vector<u16> m_indices16{};
+        std::vector<u32> m_indices32{};
+        bool m_index32{ false };
 
 		bgfx::VertexBufferHandle m_hVertexBuffer{ bgfx::kInvalidHandle };
+		bgfx::VertexBufferHandle m_hPositionBuffer{ bgfx::kInvalidHandle };
 		bgfx::IndexBufferHandle m_hIndexBuffer{ bgfx::kInvalidHandle };
+
+        bx::Aabb m_aabb{ { 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 0.0f } };
+        bx::Sphere m_sphere{ { 0.0f, 0.0f, 0.0f }, 0.0f };
+
+        VertexCacheStats m_generatedCacheStats{};
+        VertexCacheStats m_optimizedCacheStats{};
+
+    private:
+        // What the vertex buffers reference, m_vertices encoded in VertexFormats::active().
+        std::vector<u8> m_packedVertices{};
+        std::vector<u8> m_packedPositions{};
+        PositionDequant m_dequant{};
+
+        std::atomic<u32> m_numPendingRefs{ 0 };
 	};
+
+    template <>
+    inline const std::vector<u16>& Geometry::indices<u16>() const { return m_indices16; }
+
+    template <>
+    inline const std::vector<u32>& Geometry::indices<u32>() const { return m_indices32; }
 }
\ No newline at end of file
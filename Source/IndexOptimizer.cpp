@@ -0,0 +1,316 @@
+#include <IndexOptimizer.h>
+
+
+#include <algorithm>
+#include <cstring>
+
+#include <bx/math.h>
+
+
+namespace zv
+{
+	namespace
+	{
+		vec3 position(const void* _vertices, u32 _stride, u32 _idx)
+		{
+			const f32* xyz = (const f32*)((const u8*)_vertices + size_t(_idx) * _stride);
+			return { xyz[0], xyz[1], xyz[2] };
+		}
+	}
+
+
+	template <typename IndexT>
+	u32 IndexOptimizer::optimize(void* _vertices, u32 _numVertices, u32 _stride, IndexT* _indices, u32 _numIndices, u32 _cacheSize, f32 _threshold)
+	{
+		std::vector<u32> clusters;
+		optimizeVertexCache(_indices, _numIndices, _numVertices, _cacheSize, &clusters, _threshold);
+		optimizeOverdraw(_indices, _numIndices, _vertices, _stride, clusters);
+		return optimizeVertexFetch(_vertices, _numVertices, _stride, _indices, _numIndices);
+	}
+
+	template <typename IndexT>
+	void IndexOptimizer::optimizeVertexCache(IndexT* _indices, u32 _numIndices, u32 _numVertices, u32 _cacheSize, std::vector<u32>* _clusters, f32 _threshold)
+	{
+		const u32 numTriangles = _numIndices / 3;
+		if (NULL != _clusters)
+		{
+			_clusters->assign(1, 0);
+		}
+		if (0 == numTriangles)
+			return;
+
+		// Triangles around every vertex, live counts the ones not emitted yet.
+		std::vector<u32> offsets(_numVertices + 1, 0);
+		for (u32 ii = 0; ii < numTriangles * 3; ++ii)
+		{
+			++offsets[_indices[ii] + 1];
+		}
+		for (u32 ii = 0; ii < _numVertices; ++ii)
+		{
+			offsets[ii + 1] += offsets[ii];
+		}
+
+		std::vector<u32> live(_numVertices);
+		std::vector<u32> adjacency(numTriangles * 3);
+		std::vector<u32> fill(offsets.begin(), offsets.end() - 1);
+		for (u32 ii = 0; ii < _numVertices; ++ii)
+		{
+			live[ii] = offsets[ii + 1] - offsets[ii];
+		}
+		for (u32 ii = 0; ii < numTriangles * 3; ++ii)
+		{
+			adjacency[fill[_indices[ii]]++] = ii / 3;
+		}
+
+		std::vector<u32> cacheTime(_numVertices, 0);
+		std::vector<u8> emitted(numTriangles, 0);
+		std::vector<IndexT> deadEnd;
+		std::vector<IndexT> candidates;
+		std::vector<IndexT> result;
+		deadEnd.reserve(numTriangles * 3);
+		result.reserve(numTriangles * 3);
+
+		// Counts cache insertions, a vertex is cached while fewer than _cacheSize followed it.
+		u32 time = _cacheSize + 1;
+		u32 cursor = 0;
+
+		// Of the cluster being emitted.
+		u32 clusterStart = 0;
+		u32 clusterMisses = 0;
+
+		// Sets _cold when nothing that was used so far is left to continue from.
+		auto skipDeadEnd = [&](bool& _cold) -> s32
+		{
+			_cold = false;
+
+			// Recently used vertices first, they may still be cached.
+			while (!deadEnd.empty())
+			{
+				const IndexT vertex = deadEnd.back();
+				deadEnd.pop_back();
+				if (0 < live[vertex])
+					return s32(vertex);
+			}
+
+			_cold = true;
+			for (; cursor < _numVertices; ++cursor)
+			{
+				if (0 < live[cursor])
+					return s32(cursor);
+			}
+			return -1;
+		};
+
+		bool cold;
+		s32 fanning = skipDeadEnd(cold);
+		while (0 <= fanning)
+		{
+			candidates.clear();
+			for (u32 ii = offsets[fanning]; ii < offsets[fanning + 1]; ++ii)
+			{
+				const u32 triangle = adjacency[ii];
+				if (0 != emitted[triangle])
+					continue;
+
+				emitted[triangle] = 1;
+				for (u32 jj = 0; jj < 3; ++jj)
+				{
+					const IndexT vertex = _indices[triangle * 3 + jj];
+					result.push_back(vertex);
+					deadEnd.push_back(vertex);
+					candidates.push_back(vertex);
+					--live[vertex];
+
+					if (time - cacheTime[vertex] > _cacheSize)
+					{
+						cacheTime[vertex] = time;
+						++time;
+						++clusterMisses;
+					}
+				}
+			}
+
+			// The oldest vertex that stays cached while fanning around it.
+			s32 next = -1;
+			u32 bestPriority = 0;
+			for (const IndexT vertex : candidates)
+			{
+				if (0 == live[vertex])
+					continue;
+
+				u32 priority = 0;
+				if (time - cacheTime[vertex] + 2 * live[vertex] <= _cacheSize)
+				{
+					priority = time - cacheTime[vertex];
+				}
+				if (0 > next || priority > bestPriority)
+				{
+					next = s32(vertex);
+					bestPriority = priority;
+				}
+			}
+
+			if (0 > next)
+			{
+				next = skipDeadEnd(cold);
+
+				// A dead end flushes at least part of the cache. The cluster ends here when
+				// nothing connected is left, or when it has made up for starting cold. The
+				// next one starts cold as well, clusters get drawn in any order.
+				const u32 numTriangles = u32(result.size() / 3);
+				const bool split = cold || f32(clusterMisses) <= _threshold * f32(numTriangles - clusterStart);
+				if (0 <= next && NULL != _clusters && split)
+				{
+					_clusters->push_back(numTriangles);
+					clusterStart = numTriangles;
+					clusterMisses = 0;
+					time += _cacheSize + 1;
+				}
+			}
+			fanning = next;
+		}
+
+		std::copy(result.begin(), result.end(), _indices);
+	}
+
+	template <typename IndexT>
+	void IndexOptimizer::optimizeOverdraw(IndexT* _indices, u32 _numIndices, const void* _vertices, u32 _stride, const std::vector<u32>& _clusters)
+	{
+		const u32 numTriangles = _numIndices / 3;
+		const u32 numClusters = u32(_clusters.size());
+		if (2 > numClusters)
+			return;
+
+		struct Cluster
+		{
+			u32 first;
+			u32 count;
+			f32 sortKey;
+		};
+
+		std::vector<Cluster> clusters(numClusters);
+		std::vector<vec3> centroids(numClusters, { 0.0f, 0.0f, 0.0f });
+		std::vector<vec3> normals(numClusters, { 0.0f, 0.0f, 0.0f });
+		std::vector<f32> areas(numClusters, 0.0f);
+		vec3 meshCentroid = { 0.0f, 0.0f, 0.0f };
+		f32 meshArea = 0.0f;
+
+		for (u32 cc = 0; cc < numClusters; ++cc)
+		{
+			Cluster& cluster = clusters[cc];
+			cluster.first = _clusters[cc];
+			cluster.count = (cc + 1 < numClusters ? _clusters[cc + 1] : numTriangles) - cluster.first;
+
+			// Area weighted, the cross product is the normal scaled by twice the area.
+			for (u32 tt = cluster.first; tt < cluster.first + cluster.count; ++tt)
+			{
+				const vec3 p0 = position(_vertices, _stride, _indices[tt * 3 + 0]);
+				const vec3 p1 = position(_vertices, _stride, _indices[tt * 3 + 1]);
+				const vec3 p2 = position(_vertices, _stride, _indices[tt * 3 + 2]);
+
+				const vec3 normal = bx::cross(bx::sub(p1, p0), bx::sub(p2, p0));
+				const f32 area = bx::length(normal);
+				const vec3 center = bx::mul(bx::add(bx::add(p0, p1), p2), 1.0f / 3.0f);
+
+				centroids[cc] = bx::add(centroids[cc], bx::mul(center, area));
+				normals[cc] = bx::add(normals[cc], normal);
+				areas[cc] += area;
+			}
+
+			meshCentroid = bx::add(meshCentroid, centroids[cc]);
+			meshArea += areas[cc];
+		}
+
+		if (0.0f == meshArea)
+			return;
+
+		meshCentroid = bx::mul(meshCentroid, 1.0f / meshArea);
+		for (u32 cc = 0; cc < numClusters; ++cc)
+		{
+			if (0.0f == areas[cc])
+			{
+				clusters[cc].sortKey = 0.0f;
+				continue;
+			}
+
+			// Far out and facing away from the center, such clusters rarely sit behind others.
+			const vec3 centroid = bx::mul(centroids[cc], 1.0f / areas[cc]);
+			const f32 length = bx::length(normals[cc]);
+			const vec3 normal = 0.0f < length ? bx::mul(normals[cc], 1.0f / length) : vec3{ 0.0f, 0.0f, 0.0f };
+			clusters[cc].sortKey = bx::dot(bx::sub(centroid, meshCentroid), normal);
+		}
+
+		std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster& _a, const Cluster& _b) { return _a.sortKey > _b.sortKey; });
+
+		std::vector<IndexT> result;
+		result.reserve(numTriangles * 3);
+		for (const Cluster& cluster : clusters)
+		{
+			result.insert(result.end(), _indices + cluster.first * 3, _indices + (cluster.first + cluster.count) * 3);
+		}
+		std::copy(result.begin(), result.end(), _indices);
+	}
+
+	template <typename IndexT>
+	u32 IndexOptimizer::optimizeVertexFetch(void* _vertices, u32 _numVertices, u32 _stride, IndexT* _indices, u32 _numIndices)
+	{
+		std::vector<u32> remap(_numVertices, UINT32_MAX);
+		std::vector<u8> fetched;
+		fetched.reserve(size_t(_numVertices) * _stride);
+
+		u32 numFetched = 0;
+		for (u32 ii = 0; ii < _numIndices; ++ii)
+		{
+			const IndexT vertex = _indices[ii];
+			if (UINT32_MAX == remap[vertex])
+			{
+				const u8* src = (const u8*)_vertices + size_t(vertex) * _stride;
+				fetched.insert(fetched.end(), src, src + _stride);
+				remap[vertex] = numFetched++;
+			}
+			_indices[ii] = IndexT(remap[vertex]);
+		}
+
+		memcpy(_vertices, fetched.data(), fetched.size());
+		return numFetched;
+	}
+
+	template <typename IndexT>
+	VertexCacheStats IndexOptimizer::analyze(const IndexT* _indices, u32 _numIndices, u32 _numVertices, u32 _cacheSize)
+	{
+		VertexCacheStats stats;
+		stats.numTriangles = _numIndices / 3;
+
+		// FIFO, a vertex leaves once _cacheSize others were transformed after it.
+		std::vector<u32> insertedAt(_numVertices, UINT32_MAX);
+		for (u32 ii = 0; ii < stats.numTriangles * 3; ++ii)
+		{
+			const IndexT vertex = _indices[ii];
+			if (UINT32_MAX == insertedAt[vertex])
+			{
+				++stats.numVertices;
+			}
+			else if (stats.numMisses - insertedAt[vertex] < _cacheSize)
+			{
+				continue;
+			}
+
+			insertedAt[vertex] = stats.numMisses;
+			++stats.numMisses;
+		}
+
+		return stats;
+	}
+
+	template u32 IndexOptimizer::optimize<u16>(void*, u32, u32, u16*, u32, u32, f32);
+	template void IndexOptimizer::optimizeVertexCache<u16>(u16*, u32, u32, u32, std::vector<u32>*, f32);
+	template void IndexOptimizer::optimizeOverdraw<u16>(u16*, u32, const void*, u32, const std::vector<u32>&);
+	template u32 IndexOptimizer::optimizeVertexFetch<u16>(void*, u32, u32, u16*, u32);
+	template VertexCacheStats IndexOptimizer::analyze<u16>(const u16*, u32, u32, u32);
+
+	template u32 IndexOptimizer::optimize<u32>(void*, u32, u32, u32*, u32, u32, f32);
+	template void IndexOptimizer::optimizeVertexCache<u32>(u32*, u32, u32, u32, std::vector<u32>*, f32);
+	template void IndexOptimizer::optimizeOverdraw<u32>(u32*, u32, const void*, u32, const std::vector<u32>&);
+	template u32 IndexOptimizer::optimizeVertexFetch<u32>(void*, u32, u32, u32*, u32);
+	template VertexCacheStats IndexOptimizer::analyze<u32>(const u32*, u32, u32, u32);
+}
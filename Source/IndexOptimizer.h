@@ -0,0 +1,71 @@
+#pragma once
+
+
+#include <vector>
+
+#include <Types.h>
+
+
+namespace zv
+{
+	// How an index buffer uses a FIFO post-transform cache.
+	struct VertexCacheStats
+	{
+		u32 numTriangles{ 0 };
+		u32 numVertices{ 0 };   // Referenced by the indices.
+		u32 numMisses{ 0 };     // Vertices transformed.
+
+		// Average cache miss ratio, transforms per triangle. 0.5 at best for a regular grid, 3 at worst.
+		f32 acmr() const { return 0 == numTriangles ? 0.0f : f32(numMisses) / f32(numTriangles); }
+		// Average transform to vertex ratio, 1 means every vertex is transformed once.
+		f32 atvr() const { return 0 == numVertices ? 0.0f : f32(numMisses) / f32(numVertices); }
+	};
+
+	/*
+	Reorders triangle lists for the GPU, in the order optimize() runs them:
+
+	- Vertex cache: Tipsify (Sander et al. 2007), fans triangles around the
+	  vertex that stays longest in a cache of the given size, linear time.
+	- Overdraw: Tipsify's output is cut into clusters where its cache was
+	  flushed anyway, at every cold restart between parts of the mesh that
+	  share no vertices, and at a dead end once the cluster's running ACMR
+	  is down to the threshold. The cache is treated as empty at every cut,
+	  so the clusters can be drawn in any order and the ACMR stays near the
+	  threshold. They are sorted to draw the ones facing out from the center
+	  first.
+	- Vertex fetch: vertices are renumbered in the order the indices first
+	  use them, unused ones are dropped.
+	*/
+	class IndexOptimizer
+	{
+	private:
+		IndexOptimizer() = default;
+
+	public:
+		// The size Tipsify plans for and analyze() simulates by default.
+		static constexpr u32 CacheSize = 16;
+
+		// ACMR a cluster has to be down to before it may end, lambda in the paper. Lower
+		// keeps the vertex cache efficiency, higher makes more and smaller clusters.
+		static constexpr f32 ClusterThreshold = 0.75f;
+
+		// Runs all three passes. The positions are three floats at the start of every vertex,
+		// _stride bytes apart. Returns the number of vertices left.
+		template <typename IndexT>
+		static u32 optimize(void* _vertices, u32 _numVertices, u32 _stride, IndexT* _indices, u32 _numIndices, u32 _cacheSize = CacheSize, f32 _threshold = ClusterThreshold);
+
+		// _clusters receives the first triangle of every cluster, for optimizeOverdraw(). Without
+		// it the order is cut nowhere and only optimized for the cache.
+		template <typename IndexT>
+		static void optimizeVertexCache(IndexT* _indices, u32 _numIndices, u32 _numVertices, u32 _cacheSize = CacheSize, std::vector<u32>* _clusters = NULL, f32 _threshold = ClusterThreshold);
+
+		template <typename IndexT>
+		static void optimizeOverdraw(IndexT* _indices, u32 _numIndices, const void* _vertices, u32 _stride, const std::vector<u32>& _clusters);
+
+		template <typename IndexT>
+		static u32 optimizeVertexFetch(void* _vertices, u32 _numVertices, u32 _stride, IndexT* _indices, u32 _numIndices);
+
+		template <typename IndexT>
+		static VertexCacheStats analyze(const IndexT* _indices, u32 _numIndices, u32 _numVertices, u32 _cacheSize = CacheSize);
+	};
+}
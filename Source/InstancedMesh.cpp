@@ -0,0 +1,74 @@
+#include <InstancedMesh.h>
+
+
+#include <bx/bx.h>
+#include <bx/math.h>
+
+
+namespace zv
+{
+	InstancedMesh::InstancedMesh(std::unique_ptr<Geometry>&& geometry, std::unique_ptr<Material>&& material)
+	{
+		acquireGeometry(geometry);
+		acquireMaterial(material);
+	}
+
+	void InstancedMesh::render(bgfx::Encoder* encoder) const
+	{
+		if (0 == numInstances())
+			return;
+
+		DrawPacket packet{ m_pMaterial->viewId(), 0, m_pGeometry.get(), m_pMaterial.get(), m_modelMatrix };
+		packet.instanceData = m_instanceMatrices.data();
+		packet.numInstances = numInstances();
+
+		RenderQueue::submit(encoder, packet);
+	}
+
+	void InstancedMesh::enqueue(RenderQueue& queue) const
+	{
+		if (0 == numInstances())
+			return;
+
+		queue.pushInstanced(m_pMaterial->viewId(), m_pGeometry.get(), m_pMaterial.get(), m_modelMatrix, m_instanceMatrices.data(), numInstances());
+	}
+
+	u32 InstancedMesh::addInstance(const f32* modelMatrix)
+	{
+		const u32 index = numInstances();
+		m_instanceMatrices.insert(m_instanceMatrices.end(), modelMatrix, modelMatrix + 16);
+		m_boundsDirty = true;
+		return index;
+	}
+
+	void InstancedMesh::setInstance(u32 index, const f32* modelMatrix)
+	{
+		BX_ASSERT(index < numInstances(), "InstancedMesh: instance %d out of range.", index);
+		bx::memCopy(&m_instanceMatrices[index * 16], modelMatrix, 16 * sizeof(f32));
+		m_boundsDirty = true;
+	}
+
+	bool InstancedMesh::worldAabb(bx::Aabb& result) const
+	{
+		if (0 == numInstances())
+			return false;
+
+		if (m_boundsDirty)
+		{
+			Culling::transformAabb(m_instanceAabb, m_pGeometry->aabb(), &m_instanceMatrices[0]);
+
+			for (u32 ii = 1; ii < numInstances(); ++ii)
+			{
+				bx::Aabb aabb;
+				Culling::transformAabb(aabb, m_pGeometry->aabb(), &m_instanceMatrices[ii * 16]);
+				m_instanceAabb.min = bx::min(m_instanceAabb.min, aabb.min);
+				m_instanceAabb.max = bx::max(m_instanceAabb.max, aabb.max);
+			}
+
+			m_boundsDirty = false;
+		}
+
+		Culling::transformAabb(result, m_instanceAabb, m_modelMatrix);
+		return true;
+	}
+}
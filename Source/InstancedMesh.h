@@ -0,0 +1,46 @@
+#pragma once
+
+
+#include <memory>
+#include <vector>
+
+#include <Object3D.h>
+#include <GeometryBase.h>
+#include <MaterialBase.h>
+#include <Types.h>
+
+
+namespace zv
+{
+	// Draws many copies of one geometry with hardware instancing. Each instance
+	// transform is relative to the mesh's own model matrix and reaches the
+	// shader through i_data0..i_data3, so the material needs an instanced program.
+	class InstancedMesh : public Object3D
+	{
+	public:
+		InstancedMesh(std::unique_ptr<Geometry>&& geometry, std::unique_ptr<Material>&& material);
+		~InstancedMesh() = default;
+
+		InstancedMesh() = delete;
+
+	public:
+		using Object3D::render;
+		void render(bgfx::Encoder* encoder) const override;
+		void enqueue(RenderQueue& queue) const override;
+
+		bool worldAabb(bx::Aabb& result) const override;
+
+		u32 addInstance(const f32* modelMatrix);
+		void setInstance(u32 index, const f32* modelMatrix);
+		void clearInstances() { m_instanceMatrices.clear(); m_boundsDirty = true; }
+
+		u32 numInstances() const { return (u32)m_instanceMatrices.size() / 16; }
+
+	private:
+		std::vector<f32> m_instanceMatrices{};
+
+		// Union of all instance bounds in mesh space, rebuilt lazily.
+		mutable bx::Aabb m_instanceAabb{ { 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 0.0f } };
+		mutable bool m_boundsDirty{ true };
+	};
+}
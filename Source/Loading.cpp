@@ -2,7 +2,15 @@
 
 
 #include <bimg/decode.h>
+#include <bx/debug.h>
+#include <bx/timer.h>
 
+#include <ShaderPermutation.h>
+#include <ShaderReloader.h>
+#include <TextureResidency.h>
+#include <TextureStreamer.h>
+
+#include <cinttypes>
 #include <iostream>
 
 
@@ -12,15 +20,47 @@ namespace zv
 	bx::FileReaderI* LoadingManager::s_FileReader = NULL;
 	bx::FileWriterI* LoadingManager::s_FileWriter = NULL;
 
+	ThreadPool* LoadingManager::s_ThreadPool = NULL;
+
+	std::deque<LoadingManager::FinalizeJob> LoadingManager::s_Finalize;
+	std::mutex LoadingManager::s_FinalizeMutex;
+	std::atomic<u32> LoadingManager::s_NumPending{ 0 };
+
+	std::unordered_map<u64, std::shared_ptr<TextureLoad>> LoadingManager::s_PendingTextures;
+	std::unordered_map<u64, std::shared_ptr<ProgramLoad>> LoadingManager::s_PendingPrograms;
+
+	std::unordered_map<u64, ProgramRef> LoadingManager::s_Permutations;
 
-	void LoadingManager::init()
+
+	void LoadingManager::init(u32 numWorkers)
 	{
-		s_FileReader = BX_NEW(getAllocator(), bx::FileReader);
+		s_FileReader = BX_NEW(getAllocator(), VfsFileReader);
 		s_FileWriter = BX_NEW(getAllocator(), bx::FileWriter);
+
+		if (0 == numWorkers)
+		{
+			numWorkers = bx::max<u32>(std::thread::hardware_concurrency() / 2, 1);
+		}
+
+		s_ThreadPool = new ThreadPool(numWorkers);
 	}
 
 	void LoadingManager::quit()
 	{
+		// Joins the workers after they drained their queue, then drops what was
+		// decoded but never finalized.
+		delete s_ThreadPool;
+		s_ThreadPool = NULL;
+
+		while (!s_Finalize.empty())
+		{
+			s_Finalize.front()(true);
+			s_Finalize.pop_front();
+		}
+		s_NumPending = 0;
+
+		clearPermutations();
+
 		bx::deleteObject(s_Allocator, s_FileReader);
         s_FileReader = NULL;
 
@@ -38,14 +78,275 @@ namespace zv
 		bx::free(getAllocator(), _ptr);
 	}
 
-	bgfx::TextureHandle LoadingManager::loadTexture(const char* _filePath, u64 _flags, u8 _skip, bgfx::TextureInfo* _info, bimg::Orientation::Enum* _orientation)
+	std::string LoadingManager::shaderPath(const char* _name)
+	{
+		return shaderDir() + _name + ".bin";
+	}
+
+	std::string LoadingManager::shaderDir()
+	{
+		const char* backend = "dx11";
+		switch (bgfx::getRendererType())
+		{
+		case bgfx::RendererType::Direct3D11:
+		case bgfx::RendererType::Direct3D12: backend = "dx11";  break;
+		case bgfx::RendererType::Agc:
+		case bgfx::RendererType::Gnm:        backend = "pssl";  break;
+		case bgfx::RendererType::Metal:      backend = "metal"; break;
+		case bgfx::RendererType::OpenGL:     backend = "glsl";  break;
+		case bgfx::RendererType::OpenGLES:   backend = "essl";  break;
+		case bgfx::RendererType::Vulkan:     backend = "spirv"; break;
+		default:
+			break;
+		}
+
+		return std::string("Assets/Shaders/") + backend + "/";
+	}
+
+	TextureRef LoadingManager::loadTexture(const char* _filePath, u64 _flags, u8 _skip, bgfx::TextureInfo* _info, bimg::Orientation::Enum* _orientation)
+	{
+		const u64 key = ResourceCache::textureKey(_filePath, _flags, _skip);
+
+		TextureRef ref = ResourceCache::findTexture(key, _info, _orientation);
+		ResourceCache::recordLookup(ref.isValid());
+		if (ref.isValid())
+			return ref;
+
+		bgfx::TextureInfo info{};
+		bimg::Orientation::Enum orientation = bimg::Orientation::R0;
+		bgfx::TextureHandle handle = loadTexture(getFileReader(), _filePath, _flags, _skip, &info, &orientation);
+		handle = TextureResidency::adopt(handle, _filePath, _flags, _skip, info);
+
+		if (NULL != _info)
+		{
+			*_info = info;
+		}
+		if (NULL != _orientation)
+		{
+			*_orientation = orientation;
+		}
+
+		return ResourceCache::insert(key, _filePath, handle, info, orientation);
+	}
+
+	ProgramRef LoadingManager::loadProgram(const char* _vsPath, const char* _fsPath)
+	{
+		const u64 key = ResourceCache::programKey(_vsPath, _fsPath);
+
+		ProgramRef ref = ResourceCache::findProgram(key);
+		ResourceCache::recordLookup(ref.isValid());
+		if (ref.isValid())
+			return ref;
+
+		u32 size = 0;
+		bgfx::ProgramHandle handle = loadProgram(getFileReader(), _vsPath, _fsPath, &size);
+
+		ProgramRef programRef = ResourceCache::insert(key, _vsPath, handle, size);
+		ShaderReloader::track(programRef.handle(), _vsPath, _fsPath);
+		return programRef;
+	}
+
+	bgfx::ProgramHandle LoadingManager::loadPermutation(const char* _vsName, const char* _fsName, u64 _key)
+	{
+		const u64 cacheKey = ResourceCache::permutationKey(_vsName, _fsName, _key);
+
+		auto it = s_Permutations.find(cacheKey);
+		if (s_Permutations.end() != it)
+			return it->second.handle();
+
+		const std::string vsPath = shaderPath(ShaderPermutation::vertexName(_vsName, _key).c_str());
+		const std::string fsPath = shaderPath(ShaderPermutation::fragmentName(_fsName, _key).c_str());
+		ProgramRef ref = loadProgram(vsPath.c_str(), fsPath.c_str());
+
+		// Not kept when it failed, the asset build may add the variant later.
+		if (!ref.isValid())
+		{
+			bx::debugPrintf("No program variant %" PRIx64 " of %s and %s\n", (uint64_t)_key, _vsName, _fsName);
+			return BGFX_INVALID_HANDLE;
+		}
+
+		const bgfx::ProgramHandle handle = ref.handle();
+		s_Permutations.emplace(cacheKey, std::move(ref));
+		return handle;
+	}
+
+	void LoadingManager::clearPermutations()
 	{
-		return loadTexture(getFileReader(), _filePath, _flags, _skip, _info, _orientation);
+		s_Permutations.clear();
 	}
 
-	bgfx::ProgramHandle LoadingManager::loadProgram(const char* _vsPath, const char* _fsPath)
+	TextureRequest LoadingManager::loadTextureAsync(const char* _filePath, u64 _flags, u8 _skip, TextureCallback _callback)
 	{
-		return loadProgram(getFileReader(), _vsPath, _fsPath);
+		const u64 key = ResourceCache::textureKey(_filePath, _flags, _skip);
+
+		auto pending = s_PendingTextures.find(key);
+		if (s_PendingTextures.end() != pending)
+		{
+			ResourceCache::recordLookup(true);
+			if (_callback)
+			{
+				pending->second->callbacks.emplace_back(std::move(_callback));
+			}
+			return TextureRequest(pending->second);
+		}
+
+		std::shared_ptr<TextureLoad> state = std::make_shared<TextureLoad>();
+		state->filePath = _filePath;
+		state->flags = _flags;
+		state->skip = _skip;
+		state->key = key;
+		if (_callback)
+		{
+			state->callbacks.emplace_back(std::move(_callback));
+		}
+
+		++s_NumPending;
+
+		state->ref = ResourceCache::findTexture(key, &state->info, &state->orientation);
+		ResourceCache::recordLookup(state->ref.isValid());
+		if (state->ref.isValid())
+		{
+			// Done already, the callbacks still run from update() like any other load.
+			state->status.store(eLoadStatus::Ready, std::memory_order_release);
+			pushFinalize([state](bool cancel) { finalizeTexture(state, cancel); });
+			return TextureRequest(state);
+		}
+
+		s_PendingTextures[key] = state;
+		s_ThreadPool->enqueue([state]()
+		{
+			state->file = mapInPlace(state->filePath.c_str(), state->flags, &state->orientation);
+			if (nullptr == state->file)
+			{
+				// The shared reader belongs to the API thread.
+				bx::FileReader reader;
+				state->imageContainer = parseImage(&reader, state->filePath.c_str());
+			}
+
+			pushFinalize([state](bool cancel) { finalizeTexture(state, cancel); });
+		});
+
+		return TextureRequest(state);
+	}
+
+	ProgramRequest LoadingManager::loadProgramAsync(const char* _vsPath, const char* _fsPath, ProgramCallback _callback)
+	{
+		const u64 key = ResourceCache::programKey(_vsPath, _fsPath);
+
+		auto pending = s_PendingPrograms.find(key);
+		if (s_PendingPrograms.end() != pending)
+		{
+			ResourceCache::recordLookup(true);
+			if (_callback)
+			{
+				pending->second->callbacks.emplace_back(std::move(_callback));
+			}
+			return ProgramRequest(pending->second);
+		}
+
+		std::shared_ptr<ProgramLoad> state = std::make_shared<ProgramLoad>();
+		state->vsPath = _vsPath;
+		state->fsPath = NULL != _fsPath ? _fsPath : "";
+		state->key = key;
+		if (_callback)
+		{
+			state->callbacks.emplace_back(std::move(_callback));
+		}
+
+		++s_NumPending;
+
+		state->ref = ResourceCache::findProgram(key);
+		ResourceCache::recordLookup(state->ref.isValid());
+		if (state->ref.isValid())
+		{
+			state->status.store(eLoadStatus::Ready, std::memory_order_release);
+			pushFinalize([state](bool cancel) { finalizeProgram(state, cancel); });
+			return ProgramRequest(state);
+		}
+
+		s_PendingPrograms[key] = state;
+		s_ThreadPool->enqueue([state]()
+		{
+			auto mapShader = [](const std::string& path) -> std::unique_ptr<AssetFile>
+			{
+				if (path.empty())
+					return nullptr;
+
+				// A missing shader fails the whole program in finalizeProgram().
+				std::unique_ptr<AssetFile> file = std::make_unique<AssetFile>();
+				if (!file->open(path.c_str()))
+				{
+					bx::debugPrintf("Failed to load shader %s\n", path.c_str());
+					return nullptr;
+				}
+				return file;
+			};
+			state->vsFile = mapShader(state->vsPath);
+			state->fsFile = mapShader(state->fsPath);
+
+			pushFinalize([state](bool cancel) { finalizeProgram(state, cancel); });
+		});
+
+		return ProgramRequest(state);
+	}
+
+	void LoadingManager::reloadTextureAsync(const char* _filePath, u64 _flags, u8 _skip, TextureReloadCallback _callback)
+	{
+		std::shared_ptr<TextureLoad> state = std::make_shared<TextureLoad>();
+		state->filePath = _filePath;
+		state->flags = _flags;
+		state->skip = _skip;
+		state->key = 0;
+
+		++s_NumPending;
+
+		s_ThreadPool->enqueue([state, _callback]()
+		{
+			state->file = mapInPlace(state->filePath.c_str(), state->flags, &state->orientation);
+			if (nullptr == state->file)
+			{
+				bx::FileReader reader;
+				state->imageContainer = parseImage(&reader, state->filePath.c_str());
+			}
+
+			pushFinalize([state, _callback](bool cancel) { finalizeReload(state, _callback, cancel); });
+		});
+	}
+
+	void LoadingManager::update(f32 _budgetMs)
+	{
+		const s64 start = bx::getHPCounter();
+
+		// No budget when it's not positive, or too long to count in ticks.
+		const f64 ticks = f64(_budgetMs) * f64(bx::getHPFrequency()) / 1000.0;
+		const bool unbounded = !(0.0 < ticks && ticks < f64(INT64_MAX));
+		const s64 budget = unbounded ? 0 : s64(ticks);
+
+		do
+		{
+			FinalizeJob finalize;
+			{
+				std::lock_guard<std::mutex> lock(s_FinalizeMutex);
+				if (s_Finalize.empty())
+					return;
+
+				finalize = std::move(s_Finalize.front());
+				s_Finalize.pop_front();
+			}
+
+			finalize(false);
+			--s_NumPending;
+		}
+		while (unbounded || bx::getHPCounter() - start < budget);
+	}
+
+	void LoadingManager::flush()
+	{
+		while (0 != s_NumPending.load())
+		{
+			update(0.0f);
+			std::this_thread::yield();
+		}
 	}
 
 
@@ -107,6 +408,165 @@ namespace zv
         return NULL;
     }
 
+    const bgfx::Memory* LoadingManager::makeRef(std::unique_ptr<AssetFile>& _file)
+    {
+        // bgfx closes the file through the release callback once it's done with it.
+        AssetFile* file = _file.release();
+        return bgfx::makeRef(file->data(), file->size(), AssetFile::releaseCb, file);
+    }
+
+    void LoadingManager::pushFinalize(FinalizeJob&& _finalize)
+    {
+        std::lock_guard<std::mutex> lock(s_FinalizeMutex);
+        s_Finalize.emplace_back(std::move(_finalize));
+    }
+
+    void LoadingManager::finalizeTexture(const std::shared_ptr<TextureLoad>& _load, bool _cancel)
+    {
+        auto pending = s_PendingTextures.find(_load->key);
+        if (s_PendingTextures.end() != pending && pending->second == _load)
+        {
+            s_PendingTextures.erase(pending);
+        }
+
+        bimg::ImageContainer* imageContainer = _load->imageContainer;
+        _load->imageContainer = NULL;
+
+        if (_cancel)
+        {
+            if (NULL != imageContainer)
+            {
+                bimg::imageFree(imageContainer);
+            }
+            _load->file.reset();
+            if (!_load->ref.isValid())
+            {
+                _load->status.store(eLoadStatus::Failed, std::memory_order_release);
+            }
+            return;
+        }
+
+        // Cache hits arrive with their reference taken already.
+        if (!_load->ref.isValid())
+        {
+            bgfx::TextureHandle handle = BGFX_INVALID_HANDLE;
+            if (nullptr != _load->file)
+            {
+                handle = createTextureInPlace(_load->file, _load->filePath.c_str(), _load->flags, _load->skip, &_load->info);
+            }
+            else if (NULL != imageContainer)
+            {
+                _load->orientation = imageContainer->m_orientation;
+                handle = createTexture(imageContainer, _load->filePath.c_str(), _load->flags, _load->skip, &_load->info);
+            }
+
+            handle = TextureResidency::adopt(handle, _load->filePath.c_str(), _load->flags, _load->skip, _load->info);
+            _load->ref = ResourceCache::insert(_load->key, _load->filePath.c_str(), handle, _load->info, _load->orientation);
+        }
+
+        _load->status.store(_load->ref.isValid() ? eLoadStatus::Ready : eLoadStatus::Failed, std::memory_order_release);
+
+        for (const TextureCallback& callback : _load->callbacks)
+        {
+            callback(TextureRequest(_load));
+        }
+    }
+
+    void LoadingManager::finalizeProgram(const std::shared_ptr<ProgramLoad>& _load, bool _cancel)
+    {
+        auto pending = s_PendingPrograms.find(_load->key);
+        if (s_PendingPrograms.end() != pending && pending->second == _load)
+        {
+            s_PendingPrograms.erase(pending);
+        }
+
+        if (_cancel)
+        {
+            _load->vsFile.reset();
+            _load->fsFile.reset();
+            if (!_load->ref.isValid())
+            {
+                _load->status.store(eLoadStatus::Failed, std::memory_order_release);
+            }
+            return;
+        }
+
+        if (!_load->ref.isValid())
+        {
+            bgfx::ShaderHandle vsh = BGFX_INVALID_HANDLE;
+            bgfx::ShaderHandle fsh = BGFX_INVALID_HANDLE;
+            bgfx::ProgramHandle handle = BGFX_INVALID_HANDLE;
+
+            if (nullptr != _load->vsFile)
+            {
+                _load->bytes += _load->vsFile->size();
+                vsh = bgfx::createShader(makeRef(_load->vsFile));
+            }
+            if (nullptr != _load->fsFile)
+            {
+                _load->bytes += _load->fsFile->size();
+                fsh = bgfx::createShader(makeRef(_load->fsFile));
+            }
+
+            // A missing fragment shader would leave a vertex only program, fail the load instead.
+            if (bgfx::isValid(vsh) && (bgfx::isValid(fsh) || _load->fsPath.empty()))
+            {
+                handle = bgfx::createProgram(vsh, fsh, true /* destroy shaders when program is destroyed */);
+            }
+            else
+            {
+                if (bgfx::isValid(vsh))
+                {
+                    bgfx::destroy(vsh);
+                }
+                if (bgfx::isValid(fsh))
+                {
+                    bgfx::destroy(fsh);
+                }
+            }
+
+            _load->ref = ResourceCache::insert(_load->key, _load->vsPath.c_str(), handle, _load->bytes);
+            ShaderReloader::track(_load->ref.handle(), _load->vsPath.c_str(), _load->fsPath.c_str());
+        }
+
+        _load->status.store(_load->ref.isValid() ? eLoadStatus::Ready : eLoadStatus::Failed, std::memory_order_release);
+
+        for (const ProgramCallback& callback : _load->callbacks)
+        {
+            callback(ProgramRequest(_load));
+        }
+    }
+
+    void LoadingManager::finalizeReload(const std::shared_ptr<TextureLoad>& _load, const TextureReloadCallback& _callback, bool _cancel)
+    {
+        bimg::ImageContainer* imageContainer = _load->imageContainer;
+        _load->imageContainer = NULL;
+
+        if (_cancel)
+        {
+            if (NULL != imageContainer)
+            {
+                bimg::imageFree(imageContainer);
+            }
+            _load->file.reset();
+            return;
+        }
+
+        // Created the way the first load was, minus the streamer, which never took it.
+        bgfx::TextureHandle handle = BGFX_INVALID_HANDLE;
+        if (nullptr != _load->file)
+        {
+            handle = createTextureInPlace(_load->file, _load->filePath.c_str(), _load->flags, _load->skip, &_load->info, false);
+        }
+        else if (NULL != imageContainer)
+        {
+            handle = createTexture(imageContainer, _load->filePath.c_str(), _load->flags, _load->skip, &_load->info);
+        }
+
+        _load->status.store(bgfx::isValid(handle) ? eLoadStatus::Ready : eLoadStatus::Failed, std::memory_order_release);
+        _callback(handle, _load->info);
+    }
+
     void LoadingManager::imageReleaseCb(void* _ptr, void* _userData)
     {
         BX_UNUSED(_ptr);
@@ -116,92 +576,227 @@ namespace zv
 
     bgfx::TextureHandle LoadingManager::loadTexture(bx::FileReaderI* _reader, const char* _filePath, u64 _flags, u8 _skip, bgfx::TextureInfo* _info, bimg::Orientation::Enum* _orientation)
     {
-        BX_UNUSED(_skip);
-        bgfx::TextureHandle handle = BGFX_INVALID_HANDLE;
+        std::unique_ptr<AssetFile> file = mapInPlace(_filePath, _flags, _orientation);
+        if (nullptr != file)
+        {
+            return createTextureInPlace(file, _filePath, _flags, _skip, _info);
+        }
+
+        bimg::ImageContainer* imageContainer = parseImage(_reader, _filePath);
+        if (NULL == imageContainer)
+        {
+            return BGFX_INVALID_HANDLE;
+        }
+
+        if (NULL != _orientation)
+        {
+            *_orientation = imageContainer->m_orientation;
+        }
+
+        return createTexture(imageContainer, _filePath, _flags, _skip, _info);
+    }
+
+    bimg::ImageContainer* LoadingManager::parseImage(bx::FileReaderI* _reader, const char* _filePath)
+    {
+        // Parse straight from the page cache, the heap only ever holds the decoded image.
+        AssetFile file;
+        if (file.open(_filePath))
+        {
+            return bimg::imageParse(getAllocator(), file.data(), file.size());
+        }
 
         u32 size;
         void* data = load(_reader, getAllocator(), _filePath, &size);
-        if (NULL != data)
+        if (NULL == data)
         {
-            bimg::ImageContainer* imageContainer = bimg::imageParse(getAllocator(), data, size);
+            return NULL;
+        }
 
-            if (NULL != imageContainer)
-            {
-                if (NULL != _orientation)
-                {
-                    *_orientation = imageContainer->m_orientation;
-                }
+        bimg::ImageContainer* imageContainer = bimg::imageParse(getAllocator(), data, size);
+        unload(data);
 
-                const bgfx::Memory* mem = bgfx::makeRef(
-                    imageContainer->m_data
-                    , imageContainer->m_size
-                    , imageReleaseCb
-                    , imageContainer
-                );
-                unload(data);
+        return imageContainer;
+    }
 
-                if (imageContainer->m_cubeMap)
-                {
-                    handle = bgfx::createTextureCube(
-                        u16(imageContainer->m_width)
-                        , 1 < imageContainer->m_numMips
-                        , imageContainer->m_numLayers
-                        , bgfx::TextureFormat::Enum(imageContainer->m_format)
-                        , _flags
-                        , mem
-                    );
-                }
-                else if (1 < imageContainer->m_depth)
-                {
-                    handle = bgfx::createTexture3D(
-                        u16(imageContainer->m_width)
-                        , u16(imageContainer->m_height)
-                        , u16(imageContainer->m_depth)
-                        , 1 < imageContainer->m_numMips
-                        , bgfx::TextureFormat::Enum(imageContainer->m_format)
-                        , _flags
-                        , mem
-                    );
-                }
-                else if (bgfx::isTextureValid(0, false, imageContainer->m_numLayers, bgfx::TextureFormat::Enum(imageContainer->m_format), _flags))
-                {
-                    handle = bgfx::createTexture2D(
-                        u16(imageContainer->m_width)
-                        , u16(imageContainer->m_height)
-                        , 1 < imageContainer->m_numMips
-                        , imageContainer->m_numLayers
-                        , bgfx::TextureFormat::Enum(imageContainer->m_format)
-                        , _flags
-                        , mem
-                    );
-                }
+    std::unique_ptr<AssetFile> LoadingManager::mapInPlace(const char* _filePath, u64 _flags, bimg::Orientation::Enum* _orientation)
+    {
+        std::unique_ptr<AssetFile> file = std::make_unique<AssetFile>();
+        if (!file->open(_filePath))
+        {
+            return nullptr;
+        }
 
-                if (bgfx::isValid(handle))
-                {
-                    bgfx::setName(handle, _filePath);
-                }
+        // Header only, fails for anything that isn't a DDS, KTX or PVR container.
+        bimg::ImageContainer header;
+        bx::Error err;
+        if (!bimg::imageParse(header, file->data(), file->size(), &err))
+        {
+            return nullptr;
+        }
 
-                if (NULL != _info)
-                {
-                    bgfx::calcTextureSize(
-                        *_info
-                        , u16(imageContainer->m_width)
-                        , u16(imageContainer->m_height)
-                        , u16(imageContainer->m_depth)
-                        , imageContainer->m_cubeMap
-                        , 1 < imageContainer->m_numMips
-                        , imageContainer->m_numLayers
-                        , bgfx::TextureFormat::Enum(imageContainer->m_format)
-                    );
-                }
+        // Emulated formats are converted by the renderer, which is the copy we're avoiding.
+        u16 native = BGFX_CAPS_FORMAT_TEXTURE_2D;
+        u16 emulated = BGFX_CAPS_FORMAT_TEXTURE_2D_EMULATED;
+        if (header.m_cubeMap)
+        {
+            native = BGFX_CAPS_FORMAT_TEXTURE_CUBE;
+            emulated = BGFX_CAPS_FORMAT_TEXTURE_CUBE_EMULATED;
+        }
+        else if (1 < header.m_depth)
+        {
+            native = BGFX_CAPS_FORMAT_TEXTURE_3D;
+            emulated = BGFX_CAPS_FORMAT_TEXTURE_3D_EMULATED;
+        }
+
+        if (0 != (_flags & BGFX_TEXTURE_SRGB))
+        {
+            native <<= 1; // The _SRGB bit follows each format bit.
+        }
+
+        const u16 formatCaps = bgfx::getCaps()->formats[header.m_format];
+        if (0 == (formatCaps & native) || 0 != (formatCaps & emulated))
+        {
+            return nullptr;
+        }
+
+        if (NULL != _orientation)
+        {
+            *_orientation = header.m_orientation;
+        }
+
+        return file;
+    }
+
+    bgfx::TextureHandle LoadingManager::createTextureInPlace(std::unique_ptr<AssetFile>& _file, const char* _filePath, u64 _flags, u8 _skip, bgfx::TextureInfo* _info, bool _stream)
+    {
+        // Mip chains of plain 2D textures are streamed, only their small mips go up now.
+        bgfx::TextureHandle handle = BGFX_INVALID_HANDLE;
+        if (_stream)
+        {
+            handle = TextureStreamer::create(_file, _filePath, _flags, _skip, _info);
+            if (bgfx::isValid(handle) || nullptr == _file)
+            {
+                return handle;
             }
         }
 
+        // bgfx parses the container itself and uploads straight from the mapping.
+        handle = bgfx::createTexture(makeRef(_file), _flags, _skip, _info);
+
+        if (bgfx::isValid(handle))
+        {
+            bgfx::setName(handle, _filePath);
+        }
+
+        return handle;
+    }
+
+    bgfx::TextureHandle LoadingManager::createTexture(bimg::ImageContainer* _imageContainer, const char* _filePath, u64 _flags, u8 _skip, bgfx::TextureInfo* _info)
+    {
+        bgfx::TextureHandle handle = BGFX_INVALID_HANDLE;
+
+        const bgfx::TextureFormat::Enum format = bgfx::TextureFormat::Enum(_imageContainer->m_format);
+        const u8* data = (const u8*)_imageContainer->m_data;
+        u32 size = _imageContainer->m_size;
+        u32 width = _imageContainer->m_width;
+        u32 height = _imageContainer->m_height;
+        u8 numMips = _imageContainer->m_numMips;
+
+        // A single 2D image stores its mips back to back, so skipping the top ones
+        // is an offset into the data. Cubes, volumes and arrays keep all of theirs.
+        const bool is2D = !_imageContainer->m_cubeMap && 1 == _imageContainer->m_depth && 1 == _imageContainer->m_numLayers;
+        const u8 skip = is2D ? bx::min<u8>(_skip, numMips - 1) : 0;
+        bimg::ImageMip mip;
+        if (0 != skip && bimg::imageGetRawData(*_imageContainer, 0, skip, data, size, mip))
+        {
+            size -= u32(mip.m_data - data);
+            data = mip.m_data;
+            width = bx::max<u32>(width >> skip, 1);
+            height = bx::max<u32>(height >> skip, 1);
+            numMips -= skip;
+        }
+
+        // The container owns the pixels until bgfx is done with them, the
+        // callback may run on the render thread.
+        const bgfx::Memory* mem = bgfx::makeRef(
+            data
+            , size
+            , imageReleaseCb
+            , _imageContainer
+        );
+
+        if (NULL != _info)
+        {
+            bgfx::calcTextureSize(
+                *_info
+                , u16(width)
+                , u16(height)
+                , u16(_imageContainer->m_depth)
+                , _imageContainer->m_cubeMap
+                , 1 < numMips
+                , _imageContainer->m_numLayers
+                , format
+            );
+        }
+
+        if (_imageContainer->m_cubeMap)
+        {
+            handle = bgfx::createTextureCube(
+                u16(width)
+                , 1 < numMips
+                , _imageContainer->m_numLayers
+                , format
+                , _flags
+                , mem
+            );
+        }
+        else if (1 < _imageContainer->m_depth)
+        {
+            handle = bgfx::createTexture3D(
+                u16(width)
+                , u16(height)
+                , u16(_imageContainer->m_depth)
+                , 1 < numMips
+                , format
+                , _flags
+                , mem
+            );
+        }
+        else if (bgfx::isTextureValid(0, false, _imageContainer->m_numLayers, format, _flags))
+        {
+            handle = bgfx::createTexture2D(
+                u16(width)
+                , u16(height)
+                , 1 < numMips
+                , _imageContainer->m_numLayers
+                , format
+                , _flags
+                , mem
+            );
+        }
+        else
+        {
+            // mem was never handed to bgfx, so its release callback won't run.
+            bimg::imageFree(_imageContainer);
+        }
+
+        if (bgfx::isValid(handle))
+        {
+            bgfx::setName(handle, _filePath);
+        }
+
         return handle;
     }
 
     const bgfx::Memory* LoadingManager::loadMem(bx::FileReaderI* _reader, const char* _filePath)
     {
+        // bgfx reads shader binaries by size, so the mapping needs no terminator.
+        std::unique_ptr<AssetFile> file = std::make_unique<AssetFile>();
+        if (file->open(_filePath))
+        {
+            return makeRef(file);
+        }
+
         if (bx::open(_reader, _filePath))
         {
             u32 size = (u32)bx::getSize(_reader);
@@ -217,21 +812,46 @@ namespace zv
         return NULL;
     }
 
-    bgfx::ShaderHandle LoadingManager::loadShader(bx::FileReaderI* _reader, const char* _path)
+    bgfx::ShaderHandle LoadingManager::loadShader(bx::FileReaderI* _reader, const char* _path, u32* _size)
     {
-        bgfx::ShaderHandle handle = bgfx::createShader(loadMem(_reader, _path));
+        const bgfx::Memory* mem = loadMem(_reader, _path);
+        if (NULL == mem)
+        {
+            return BGFX_INVALID_HANDLE;
+        }
+
+        if (NULL != _size)
+        {
+            *_size += mem->size;
+        }
+
+        bgfx::ShaderHandle handle = bgfx::createShader(mem);
         // TODO
         //bgfx::setName(handle, _name);
         return handle;
     }
 
-    bgfx::ProgramHandle LoadingManager::loadProgram(bx::FileReaderI* _reader, const char* _vsPath, const char* _fsPath)
+    bgfx::ProgramHandle LoadingManager::loadProgram(bx::FileReaderI* _reader, const char* _vsPath, const char* _fsPath, u32* _size)
     {
-        bgfx::ShaderHandle vsh = loadShader(_reader, _vsPath);
+        bgfx::ShaderHandle vsh = loadShader(_reader, _vsPath, _size);
         bgfx::ShaderHandle fsh = BGFX_INVALID_HANDLE;
         if (NULL != _fsPath)
         {
-            fsh = loadShader(_reader, _fsPath);
+            fsh = loadShader(_reader, _fsPath, _size);
+        }
+
+        // Both or nothing, a vertex only program would render garbage.
+        if (!bgfx::isValid(vsh) || (NULL != _fsPath && !bgfx::isValid(fsh)))
+        {
+            if (bgfx::isValid(vsh))
+            {
+                bgfx::destroy(vsh);
+            }
+            if (bgfx::isValid(fsh))
+            {
+                bgfx::destroy(fsh);
+            }
+            return BGFX_INVALID_HANDLE;
         }
 
         return bgfx::createProgram(vsh, fsh, true /* destroy shaders when program is destroyed */);
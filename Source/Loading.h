@@ -1,55 +1,248 @@
 #pragma once
 
 
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
 #include <bgfx/bgfx.h>
 #include <bx/file.h>
 #include <bx/pixelformat.h>
 #include <bimg/bimg.h>
 
+#include <Vfs.h>
+#include <ResourceCache.h>
+#include <ThreadPool.h>
 #include <Types.h>
 
 
 namespace zv
 {
+	class TextureRequest;
+	class ProgramRequest;
+
+	using TextureCallback = std::function<void(const TextureRequest&)>;
+	using ProgramCallback = std::function<void(const ProgramRequest&)>;
+	using TextureReloadCallback = std::function<void(bgfx::TextureHandle, const bgfx::TextureInfo&)>;
+
+	enum class eLoadStatus {
+		Pending = 0,
+		Ready = 1,
+		Failed = 2,
+	};
+
+	// Shared state of an asynchronous load. Workers fill in the decoded data,
+	// the rest is written on the API thread when the load is finalized.
+	struct TextureLoad
+	{
+		std::string filePath;
+		u64 flags;
+		u8 skip;
+		u64 key;
+
+		// Requests for the same key share the load, each adds its callback.
+		std::vector<TextureCallback> callbacks;
+
+		// Either the mapped file when bgfx can take it as it is, or the decoded image.
+		std::unique_ptr<AssetFile> file{ nullptr };
+		bimg::ImageContainer* imageContainer{ NULL };
+
+		std::atomic<eLoadStatus> status{ eLoadStatus::Pending };
+		TextureRef ref{};
+		bgfx::TextureInfo info{};
+		bimg::Orientation::Enum orientation{ bimg::Orientation::R0 };
+	};
+
+	struct ProgramLoad
+	{
+		std::string vsPath;
+		std::string fsPath;
+		u64 key;
+		std::vector<ProgramCallback> callbacks;
+
+		// Shader binaries, mapped or from an archive, handed to bgfx by reference when finalized.
+		std::unique_ptr<AssetFile> vsFile{ nullptr };
+		std::unique_ptr<AssetFile> fsFile{ nullptr };
+
+		std::atomic<eLoadStatus> status{ eLoadStatus::Pending };
+		ProgramRef ref{};
+		u32 bytes{ 0 };
+	};
+
+	// Future-like handle to a texture load. Copies refer to the same load, which
+	// keeps a reference to the texture while any of them is alive.
+	class TextureRequest
+	{
+	public:
+		TextureRequest() = default;
+
+	public:
+		bool isValid() const { return nullptr != m_pLoad; }
+		eLoadStatus status() const { return m_pLoad->status.load(std::memory_order_acquire); }
+		bool isDone() const { return eLoadStatus::Pending != status(); }
+
+		// Only meaningful once the request is done.
+		bgfx::TextureHandle handle() const { return isDone() ? m_pLoad->ref.handle() : bgfx::TextureHandle{ bgfx::kInvalidHandle }; }
+		TextureRef ref() const { return isDone() ? m_pLoad->ref : TextureRef(); }
+		const bgfx::TextureInfo& info() const { return m_pLoad->info; }
+		bimg::Orientation::Enum orientation() const { return m_pLoad->orientation; }
+		const char* filePath() const { return m_pLoad->filePath.c_str(); }
+
+	private:
+		friend class LoadingManager;
+		explicit TextureRequest(const std::shared_ptr<TextureLoad>& load) : m_pLoad(load) {}
+
+	private:
+		std::shared_ptr<TextureLoad> m_pLoad{ nullptr };
+	};
+
+	class ProgramRequest
+	{
+	public:
+		ProgramRequest() = default;
+
+	public:
+		bool isValid() const { return nullptr != m_pLoad; }
+		eLoadStatus status() const { return m_pLoad->status.load(std::memory_order_acquire); }
+		bool isDone() const { return eLoadStatus::Pending != status(); }
+
+		bgfx::ProgramHandle handle() const { return isDone() ? m_pLoad->ref.handle() : bgfx::ProgramHandle{ bgfx::kInvalidHandle }; }
+		ProgramRef ref() const { return isDone() ? m_pLoad->ref : ProgramRef(); }
+
+	private:
+		friend class LoadingManager;
+		explicit ProgramRequest(const std::shared_ptr<ProgramLoad>& load) : m_pLoad(load) {}
+
+	private:
+		std::shared_ptr<ProgramLoad> m_pLoad{ nullptr };
+	};
+
 	class LoadingManager
 	{
 	private:
 		LoadingManager() = default;
 
 	public:
-		static void init();
+		// numWorkers == 0 picks half the hardware threads, at least one.
+		static void init(u32 numWorkers = 0);
 		static void quit();
 
 		static void* load(const char* _filePath, u32* _size = NULL);
 		static void unload(void* _ptr);
 
-		static bgfx::TextureHandle loadTexture(const char* _filePath,
-												u64 _flags = 0x00, 
-												u8 _skip = 0, 
-												bgfx::TextureInfo* _info = NULL, 
-												bimg::Orientation::Enum* _orientation = NULL);
-		static bgfx::ProgramHandle loadProgram(const char* _vsPath, const char* _fsPath);
+		// Assets/Shaders/<backend>/<_name>.bin for the renderer bgfx runs on, laid out
+		// the way the asset build writes them. Only valid after bgfx::init().
+		static std::string shaderPath(const char* _name);
+		static std::string shaderDir();
+
+		// Cached by path and flags, see ResourceCache. Loading a file again returns
+		// another reference to the same texture or program.
+		static TextureRef loadTexture(const char* _filePath,
+										u64 _flags = 0x00,
+										u8 _skip = 0,
+										bgfx::TextureInfo* _info = NULL,
+										bimg::Orientation::Enum* _orientation = NULL);
+		static ProgramRef loadProgram(const char* _vsPath, const char* _fsPath);
+
+		// Keyed program cache. The _key variant of a shader pair, see ShaderPermutation,
+		// loads on its first request, later ones return it without touching a path.
+		// Variants nobody asks for never load. Kept until clearPermutations().
+		static bgfx::ProgramHandle loadPermutation(const char* _vsName, const char* _fsName, u64 _key);
+		static void clearPermutations();
+		static u32 numPermutations() { return u32(s_Permutations.size()); }
+
+		// File I/O and decoding run on the workers. bgfx objects are created on the
+		// API thread by update(), which then invokes the callback. Cache hits and
+		// loads already in flight don't touch the workers.
+		static TextureRequest loadTextureAsync(const char* _filePath,
+												u64 _flags = 0x00,
+												u8 _skip = 0,
+												TextureCallback _callback = nullptr);
+		static ProgramRequest loadProgramAsync(const char* _vsPath, const char* _fsPath, ProgramCallback _callback = nullptr);
+
+		// Loads an evicted texture again for TextureResidency, past the cache and the
+		// streamer. The callback owns the new texture, invalid when the load failed,
+		// and runs from update(). It doesn't run when the load is dropped on quit().
+		static void reloadTextureAsync(const char* _filePath, u64 _flags, u8 _skip, TextureReloadCallback _callback);
+
+		// Finalizes decoded loads on the API thread until _budgetMs is spent. At least
+		// one load is finalized per call so progress never stalls. _budgetMs <= 0
+		// finalizes everything that is ready, as do budgets too long to time.
+		static void update(f32 _budgetMs = 2.0f);
+
+		// Blocks until every load issued so far is finalized.
+		static void flush();
+
+		static u32 numPending() { return s_NumPending.load(); }
 
 	private:
 		static bx::AllocatorI* getDefaultAllocator();
-		static bx::AllocatorI* LoadingManager::getAllocator();
-		static bx::FileReaderI* LoadingManager::getFileReader();
-		static bx::FileWriterI* LoadingManager::getFileWriter();
-		static void* LoadingManager::load(bx::FileReaderI* _reader, bx::AllocatorI* _allocator, const char* _filePath, u32* _size);
-		static void LoadingManager::imageReleaseCb(void* _ptr, void* _userData);
-		static bgfx::TextureHandle LoadingManager::loadTexture(bx::FileReaderI* _reader,
-																const char* _filePath, 
-																u64 _flags, 
-																u8 _skip, 
-																bgfx::TextureInfo* _info, 
-																bimg::Orientation::Enum* _orientation);
-		static const bgfx::Memory* LoadingManager::loadMem(bx::FileReaderI* _reader, const char* _filePath);
-		static bgfx::ShaderHandle LoadingManager::loadShader(bx::FileReaderI* _reader, const char* _path);
-		static bgfx::ProgramHandle LoadingManager::loadProgram(bx::FileReaderI* _reader, const char* _vsPath, const char* _fsPath);
+		static bx::AllocatorI* getAllocator();
+		static bx::FileReaderI* getFileReader();
+		static bx::FileWriterI* getFileWriter();
+		static void* load(bx::FileReaderI* _reader, bx::AllocatorI* _allocator, const char* _filePath, u32* _size);
+		static void imageReleaseCb(void* _ptr, void* _userData);
+		static bgfx::TextureHandle loadTexture(bx::FileReaderI* _reader,
+											   const char* _filePath, 
+											   u64 _flags, 
+											   u8 _skip, 
+											   bgfx::TextureInfo* _info, 
+											   bimg::Orientation::Enum* _orientation);
+		static const bgfx::Memory* loadMem(bx::FileReaderI* _reader, const char* _filePath);
+		// _size, when given, accumulates the bytes of the shader binaries.
+		static bgfx::ShaderHandle loadShader(bx::FileReaderI* _reader, const char* _path, u32* _size = NULL);
+		static bgfx::ProgramHandle loadProgram(bx::FileReaderI* _reader, const char* _vsPath, const char* _fsPath, u32* _size = NULL);
+
+		// Worker safe halves of loadTexture.
+		static bimg::ImageContainer* parseImage(bx::FileReaderI* _reader, const char* _filePath);
+		static bgfx::TextureHandle createTexture(bimg::ImageContainer* _imageContainer,
+												 const char* _filePath,
+												 u64 _flags,
+												 u8 _skip,
+												 bgfx::TextureInfo* _info);
+
+		// DDS, KTX and PVR files whose format the GPU samples natively skip decoding.
+		// Only the header is parsed and bgfx gets the mapped file by reference, or the
+		// TextureStreamer takes it. Returns NULL when the file has to go through
+		// parseImage instead.
+		static std::unique_ptr<AssetFile> mapInPlace(const char* _filePath, u64 _flags, bimg::Orientation::Enum* _orientation);
+		static bgfx::TextureHandle createTextureInPlace(std::unique_ptr<AssetFile>& _file,
+														const char* _filePath,
+														u64 _flags,
+														u8 _skip,
+														bgfx::TextureInfo* _info,
+														bool _stream = true);
+
+		// _cancel frees the decoded data without touching bgfx, used on quit().
+		static void finalizeTexture(const std::shared_ptr<TextureLoad>& _load, bool _cancel);
+		static void finalizeProgram(const std::shared_ptr<ProgramLoad>& _load, bool _cancel);
+		static void finalizeReload(const std::shared_ptr<TextureLoad>& _load, const TextureReloadCallback& _callback, bool _cancel);
+		static const bgfx::Memory* makeRef(std::unique_ptr<AssetFile>& _file);
+
+		using FinalizeJob = std::function<void(bool _cancel)>;
+		static void pushFinalize(FinalizeJob&& _finalize);
 
 	private:
 		static bx::FileReaderI* s_FileReader;
 		static bx::FileWriterI* s_FileWriter;
 		static bx::AllocatorI* s_Allocator;
+
+		static ThreadPool* s_ThreadPool;
+
+		// Decoded loads waiting for the API thread, filled by the workers.
+		static std::deque<FinalizeJob> s_Finalize;
+		static std::mutex s_FinalizeMutex;
+		static std::atomic<u32> s_NumPending;
+
+		static std::unordered_map<u64, ProgramRef> s_Permutations;
+
+		// Loads in flight by cache key, API thread only.
+		static std::unordered_map<u64, std::shared_ptr<TextureLoad>> s_PendingTextures;
+		static std::unordered_map<u64, std::shared_ptr<ProgramLoad>> s_PendingPrograms;
 	};
 }
\ No newline at end of file
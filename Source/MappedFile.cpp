@@ -0,0 +1,126 @@
+#include <MappedFile.h>
+
+
+#include <bx/bx.h>
+
+#if BX_PLATFORM_WINDOWS
+#	ifndef WIN32_LEAN_AND_MEAN
+#		define WIN32_LEAN_AND_MEAN
+#	endif // WIN32_LEAN_AND_MEAN
+#	include <windows.h>
+#else
+#	include <fcntl.h>
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#	include <unistd.h>
+#endif // BX_PLATFORM_WINDOWS
+
+
+namespace zv
+{
+#if BX_PLATFORM_WINDOWS
+	bool MappedFile::open(const char* _filePath)
+	{
+		close();
+
+		HANDLE file = CreateFileA(_filePath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		if (INVALID_HANDLE_VALUE == file)
+			return false;
+
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(file, &size) || 0 == size.QuadPart || UINT32_MAX < size.QuadPart)
+		{
+			CloseHandle(file);
+			return false;
+		}
+
+		HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (NULL == mapping)
+		{
+			CloseHandle(file);
+			return false;
+		}
+
+		void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		if (NULL == data)
+		{
+			CloseHandle(mapping);
+			CloseHandle(file);
+			return false;
+		}
+
+		// Windows 8+ equivalent of MADV_WILLNEED.
+		WIN32_MEMORY_RANGE_ENTRY range{ data, SIZE_T(size.QuadPart) };
+		PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+
+		m_hFile = file;
+		m_hMapping = mapping;
+		m_pData = (const u8*)data;
+		m_size = u32(size.QuadPart);
+		return true;
+	}
+
+	void MappedFile::close()
+	{
+		if (NULL != m_pData)
+		{
+			UnmapViewOfFile(m_pData);
+			CloseHandle(m_hMapping);
+			CloseHandle(m_hFile);
+		}
+
+		m_pData = NULL;
+		m_size = 0;
+		m_hFile = NULL;
+		m_hMapping = NULL;
+	}
+#else
+	bool MappedFile::open(const char* _filePath)
+	{
+		close();
+
+		const int fd = ::open(_filePath, O_RDONLY);
+		if (fd < 0)
+			return false;
+
+		struct stat info;
+		if (0 != fstat(fd, &info) || 0 == info.st_size || UINT32_MAX < u64(info.st_size))
+		{
+			::close(fd);
+			return false;
+		}
+
+		void* data = mmap(NULL, size_t(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+
+		// The mapping keeps the file referenced, the descriptor is no longer needed.
+		::close(fd);
+
+		if (MAP_FAILED == data)
+			return false;
+
+		madvise(data, size_t(info.st_size), MADV_SEQUENTIAL);
+		madvise(data, size_t(info.st_size), MADV_WILLNEED);
+
+		m_pData = (const u8*)data;
+		m_size = u32(info.st_size);
+		return true;
+	}
+
+	void MappedFile::close()
+	{
+		if (NULL != m_pData)
+		{
+			munmap((void*)m_pData, m_size);
+		}
+
+		m_pData = NULL;
+		m_size = 0;
+	}
+#endif // BX_PLATFORM_WINDOWS
+
+	void MappedFile::releaseCb(void* _ptr, void* _userData)
+	{
+		BX_UNUSED(_ptr);
+		delete (MappedFile*)_userData;
+	}
+}
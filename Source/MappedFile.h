@@ -0,0 +1,46 @@
+#pragma once
+
+
+#include <bx/bx.h>
+
+#include <Types.h>
+
+
+namespace zv
+{
+	/*
+	Read only memory mapping of a whole file. The bytes come straight from the
+	page cache, nothing is copied onto the heap. The mapping is advised as read
+	sequentially and needed soon, so the kernel reads ahead of the parser.
+	*/
+	class MappedFile
+	{
+	public:
+		MappedFile() = default;
+		~MappedFile() { close(); }
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+	public:
+		bool open(const char* _filePath);
+		void close();
+
+		bool isOpen() const { return NULL != m_pData; }
+		const u8* data() const { return m_pData; }
+		u32 size() const { return m_size; }
+
+		// bgfx::ReleaseFn for a heap allocated MappedFile passed as user data, e.g.
+		// bgfx::makeRef(file->data(), file->size(), MappedFile::releaseCb, file).
+		static void releaseCb(void* _ptr, void* _userData);
+
+	private:
+		const u8* m_pData{ NULL };
+		u32 m_size{ 0 };
+
+#if BX_PLATFORM_WINDOWS
+		void* m_hFile{ NULL };
+		void* m_hMapping{ NULL };
+#endif // BX_PLATFORM_WINDOWS
+	};
+}
@@ -1,6 +1,11 @@
 #include <MaterialBase.h>
 
 
+#include <ShaderReloader.h>
+#include <TextureResidency.h>
+#include <TextureStreamer.h>
+
+
 namespace zv
 {
 	void Material::setTexture(eTextureType type, const bgfx::TextureHandle& handle)
@@ -19,24 +24,98 @@ namespace zv
 		}
 	}
 
+	u16 Material::textureKey() const
+	{
+		// Only used to group draws, collisions cost a state change, nothing more.
+		const u32 hash = (u32(m_hTextureDiffuse.idx) * 2654435761u) ^ (u32(m_hTextureNormal.idx) * 40503u);
+		return u16(hash >> 16);
+	}
+
+	bool Material::sharesTextures(const Material& other) const
+	{
+		return m_hTextureDiffuse.idx == other.m_hTextureDiffuse.idx
+			&& m_hTextureNormal.idx == other.m_hTextureNormal.idx;
+	}
+
+	bool Material::canBatchWith(const Material& other) const
+	{
+		return 0 != uniformKey()
+			&& uniformKey() == other.uniformKey()
+			&& m_viewId == other.m_viewId
+			&& m_renderState == other.m_renderState
+			&& m_hProgram.idx == other.m_hProgram.idx
+			&& m_hProgramInstanced.idx == other.m_hProgramInstanced.idx
+			&& sharesTextures(other);
+	}
+
+	void Material::updateRenderState()
+	{
+		u64 state = BGFX_STATE_WRITE_RGB | BGFX_STATE_WRITE_A | BGFX_STATE_MSAA | m_depthTest;
+
+		// Blended surfaces are sorted back to front and must not occlude each other.
+		if (m_depthWrite && eBlendMode::Opaque == m_blendMode)
+			state |= BGFX_STATE_WRITE_Z;
+
+		switch (m_blendMode)
+		{
+		case eBlendMode::Alpha:
+			state |= BGFX_STATE_BLEND_ALPHA;
+			break;
+		case eBlendMode::Additive:
+			state |= BGFX_STATE_BLEND_ADD;
+			break;
+		default:
+			break;
+		}
+
+		switch (m_cullMode)
+		{
+		case eCullMode::Clockwise:
+			state |= BGFX_STATE_CULL_CW;
+			break;
+		case eCullMode::CounterClockwise:
+			state |= BGFX_STATE_CULL_CCW;
+			break;
+		default:
+			break;
+		}
+
+		m_renderState = state;
+	}
+
 	void Material::cleanup()
 	{
 		bgfx::destroy(m_hUTextureDiffuse);
 		bgfx::destroy(m_hUTextureNormal);
 	}
 
-	void Material::bindTextures() const
+	bgfx::TextureHandle Material::texture(eTextureType type) const
+	{
+		switch (type)
+		{
+		case eTextureType::Diffuse:
+			return m_hTextureDiffuse;
+		case eTextureType::Normal:
+			return m_hTextureNormal;
+		default:
+			return BGFX_INVALID_HANDLE;
+		}
+	}
+
+	void Material::bindTextures(bgfx::Encoder* encoder) const
 	{
+		// Streamed textures bind whichever mips are resident, budgeted ones their
+		// placeholder while evicted. Binding counts as sampling for the budget.
 		if (bgfx::isValid(m_hTextureDiffuse))
-			bgfx::setTexture(0, m_hUTextureDiffuse, m_hTextureDiffuse);
+			encoder->setTexture(0, m_hUTextureDiffuse, TextureStreamer::resolve(TextureResidency::resolve(m_hTextureDiffuse)));
 
 		if (bgfx::isValid(m_hTextureNormal))
-			bgfx::setTexture(1, m_hUTextureNormal, m_hTextureNormal);
+			encoder->setTexture(1, m_hUTextureNormal, TextureStreamer::resolve(TextureResidency::resolve(m_hTextureNormal)));
 	}
 
-	void Material::bindProgram() const
+	void Material::bindProgram(bgfx::Encoder* encoder, bgfx::ViewId view, u32 depth, bool instanced, u8 discardFlags) const
 	{
-		// TODO: ViewId, depth, flags
-		bgfx::submit(0, m_hProgram);
+		// The latest version when the shaders were reloaded.
+		encoder->submit(view, ShaderReloader::resolve(instanced ? m_hProgramInstanced : m_hProgram), depth, discardFlags);
 	}
 }
\ No newline at end of file
@@ -3,6 +3,8 @@
 
 #include <bgfx/bgfx.h>
 
+#include <Types.h>
+
 
 namespace zv
 {
@@ -11,6 +13,18 @@ namespace zv
 		Normal = 1,
 	};
 
+	enum class eBlendMode {
+		Opaque = 0,
+		Alpha = 1,
+		Additive = 2,
+	};
+
+	enum class eCullMode {
+		None = 0,
+		Clockwise = 1,
+		CounterClockwise = 2,
+	};
+
 	class Material
 	{
 	public:
@@ -18,22 +32,62 @@ namespace zv
 		~Material() = default;
 
 	public:
-		virtual void updateUniforms() = 0;
+		virtual void updateUniforms(bgfx::Encoder* encoder) = 0;
 		virtual void cleanup();
 
-		void bindTextures() const;
-		void bindProgram() const;
+		void bindTextures(bgfx::Encoder* encoder) const;
+		void bindProgram(bgfx::Encoder* encoder, bgfx::ViewId view, u32 depth = 0, bool instanced = false, u8 discardFlags = BGFX_DISCARD_ALL) const;
+
+		const bgfx::ProgramHandle& program() const { return m_hProgram; }
+		const bgfx::ProgramHandle& instancedProgram() const { return m_hProgramInstanced; }
+		bgfx::TextureHandle texture(eTextureType type) const;
+		u16 textureKey() const;
+		bool sharesTextures(const Material& other) const;
+
+		bgfx::ViewId viewId() const { return m_viewId; }
+		eBlendMode blendMode() const { return m_blendMode; }
+		eCullMode cullMode() const { return m_cullMode; }
+		bool isTranslucent() const { return eBlendMode::Opaque != m_blendMode; }
+
+		// BGFX_STATE_* flags for draws with this material.
+		u64 renderState() const { return m_renderState; }
+
+		void setViewId(bgfx::ViewId viewId) { m_viewId = viewId; }
+		void setBlendMode(eBlendMode blendMode) { m_blendMode = blendMode; updateRenderState(); }
+		void setCullMode(eCullMode cullMode) { m_cullMode = cullMode; updateRenderState(); }
+		void setDepthWrite(bool depthWrite) { m_depthWrite = depthWrite; updateRenderState(); }
+		void setDepthTest(u64 depthTest) { m_depthTest = depthTest; updateRenderState(); }
+
+		// Materials returning the same non-zero key set identical uniform values, so
+		// draws using them may be merged into one instanced draw. 0 opts out.
+		virtual u64 uniformKey() const { return 0; }
+
+		// True when both materials bind the same program, textures, state and uniforms.
+		bool canBatchWith(const Material& other) const;
 
 	protected:
 		void setProgram(const bgfx::ProgramHandle& programHandle) { m_hProgram = programHandle; }
+		void setInstancedProgram(const bgfx::ProgramHandle& programHandle) { m_hProgramInstanced = programHandle; }
 		void setTexture(eTextureType type, const bgfx::TextureHandle& textureHandle);
 
+	private:
+		void updateRenderState();
+
 	protected:
 		bgfx::ProgramHandle m_hProgram{ bgfx::kInvalidHandle };
+		bgfx::ProgramHandle m_hProgramInstanced{ bgfx::kInvalidHandle };
 
 		bgfx::TextureHandle m_hTextureDiffuse{ bgfx::kInvalidHandle };
 		bgfx::TextureHandle m_hTextureNormal{ bgfx::kInvalidHandle };
 
+		bgfx::ViewId m_viewId{ 0 };
+		eBlendMode m_blendMode{ eBlendMode::Opaque };
+		eCullMode m_cullMode{ eCullMode::None };
+		bool m_depthWrite{ true };
+		u64 m_depthTest{ BGFX_STATE_DEPTH_TEST_LESS };
+
+		u64 m_renderState{ BGFX_STATE_WRITE_RGB | BGFX_STATE_WRITE_A | BGFX_STATE_WRITE_Z | BGFX_STATE_DEPTH_TEST_LESS | BGFX_STATE_MSAA };
+
 	private:
 		bgfx::UniformHandle m_hUTextureDiffuse = bgfx::createUniform("s_texColor", bgfx::UniformType::Sampler);
 		bgfx::UniformHandle m_hUTextureNormal = bgfx::createUniform("s_texNormal", bgfx::UniformType::Sampler);
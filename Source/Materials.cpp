@@ -1,12 +1,25 @@
 #include <Materials.h>
 
 
+#include <bx/hash.h>
+
+#include <Loading.h>
+#include <ShaderPermutation.h>
+
 namespace zv
 {
-    TestMaterial::TestMaterial(const bgfx::ProgramHandle& programHandle, const bgfx::TextureHandle& diffuseTexture, const bgfx::TextureHandle& normalTexture, f32* time)
+    TestMaterial::TestMaterial(const bgfx::TextureHandle& diffuseTexture, const bgfx::TextureHandle& normalTexture, f32* time, u16 numLights)
         : m_time(time)
+        , m_numLights(bx::min(numLights, MaxLights))
+        , m_variantLights(variantLights(m_numLights))
     {
-        setProgram(programHandle);
+        m_permutation = ShaderPermutation::numLights(m_variantLights);
+        if (bgfx::isValid(normalTexture))
+            m_permutation |= ShaderPermutation::NormalMap;
+
+        // Both, draws of any mesh may get merged into instanced ones.
+        setProgram(LoadingManager::loadPermutation("test_v", "test_f", m_permutation));
+        setInstancedProgram(LoadingManager::loadPermutation("test_v", "test_f", m_permutation | ShaderPermutation::Instanced));
 
         setTexture(eTextureType::Diffuse, diffuseTexture);
         setTexture(eTextureType::Normal, normalTexture);
@@ -20,10 +33,32 @@ namespace zv
         base_type::cleanup();
     }
 
-    void TestMaterial::updateUniforms()
+    u64 TestMaterial::uniformKey() const
+    {
+        bx::HashMurmur2A hash;
+        hash.begin();
+        hash.add(m_time);
+        hash.add(m_numLights);
+        hash.add(m_variantLights);
+
+        // 0 means the uniforms can't be shared, see Material::canBatchWith().
+        return bx::max<u64>(hash.end(), 1);
+    }
+
+    u16 TestMaterial::variantLights(u16 _numLights)
+    {
+        for (const u16 count : { 1, 2, 4 })
+        {
+            if (_numLights <= count)
+                return count;
+        }
+        return MaxLights;
+    }
+
+    void TestMaterial::updateUniforms(bgfx::Encoder* encoder)
 	{
-        f32 lightPosRadius[4][4];
-        for (u32 ii = 0; ii < NumLights; ++ii)
+        f32 lightPosRadius[MaxLights][4];
+        for (u32 ii = 0; ii < m_variantLights; ++ii)
         {
             lightPosRadius[ii][0] = bx::sin((*m_time * (0.1f + ii * 0.17f) + ii * bx::kPiHalf * 1.37f)) * 3.0f;
             lightPosRadius[ii][1] = bx::cos((*m_time * (0.2f + ii * 0.29f) + ii * bx::kPiHalf * 1.49f)) * 3.0f;
@@ -31,9 +66,9 @@ namespace zv
             lightPosRadius[ii][3] = 3.0f;
         }
 
-        bgfx::setUniform(m_hULightPosRadius, lightPosRadius, NumLights);
+        encoder->setUniform(m_hULightPosRadius, lightPosRadius, m_variantLights);
 
-        f32 lightRgbInnerR[4][4] =
+        f32 lightRgbInnerR[MaxLights][4] =
         {
             { 1.0f, 0.7f, 0.2f, 0.8f },
             { 0.7f, 0.2f, 1.0f, 0.8f },
@@ -41,6 +76,12 @@ namespace zv
             { 1.0f, 0.4f, 0.2f, 0.8f },
         };
 
-        bgfx::setUniform(m_hULightRgbInnerR, lightRgbInnerR, NumLights);
+        // The variant may light more than asked for, those add nothing.
+        for (u32 ii = m_numLights; ii < m_variantLights; ++ii)
+        {
+            lightRgbInnerR[ii][0] = lightRgbInnerR[ii][1] = lightRgbInnerR[ii][2] = 0.0f;
+        }
+
+        encoder->setUniform(m_hULightRgbInnerR, lightRgbInnerR, m_variantLights);
 	}
 }
\ No newline at end of file
@@ -7,12 +7,13 @@
 
 namespace zv
 {
+	// Requests the test shader variant for its inputs, without a normal texture it skips normal mapping.
 	class TestMaterial : public Material
 	{
 		using base_type = Material;
 
 	public:
-		TestMaterial(const bgfx::ProgramHandle& programHandle, const bgfx::TextureHandle& diffuseTexture, const bgfx::TextureHandle& normalTexture, f32* time);
+		TestMaterial(const bgfx::TextureHandle& diffuseTexture, const bgfx::TextureHandle& normalTexture, f32* time, u16 numLights = MaxLights);
 		~TestMaterial() = default;
 
 		TestMaterial() = delete;
@@ -20,14 +21,27 @@ namespace zv
 	public:
 		void cleanup() override;
 
-		void updateUniforms() override;
+		void updateUniforms(bgfx::Encoder* encoder) override;
 
-	private:
-		const u16 NumLights = 4;
+		// Uniforms only depend on the shared time value and the light count.
+		u64 uniformKey() const override;
+
+		u64 permutation() const { return m_permutation; }
+
+		// Lights of the smallest built variant that fits _numLights, the test_f
+		// "// permutations:" line builds 1, 2 and 4.
+		static u16 variantLights(u16 _numLights);
 
+	public:
+		static const u16 MaxLights = 4;
+
+	private:
 		f32* m_time{ nullptr };
+		u16 m_numLights{ MaxLights };
+		u16 m_variantLights{ MaxLights };  // Past m_numLights they are black.
+		u64 m_permutation{ 0 };
 
-		bgfx::UniformHandle m_hULightPosRadius = bgfx::createUniform("u_lightPosRadius", bgfx::UniformType::Vec4, NumLights);
-		bgfx::UniformHandle m_hULightRgbInnerR = bgfx::createUniform("u_lightRgbInnerR", bgfx::UniformType::Vec4, NumLights);
+		bgfx::UniformHandle m_hULightPosRadius = bgfx::createUniform("u_lightPosRadius", bgfx::UniformType::Vec4, MaxLights);
+		bgfx::UniformHandle m_hULightRgbInnerR = bgfx::createUniform("u_lightRgbInnerR", bgfx::UniformType::Vec4, MaxLights);
 	};
 }
\ No newline at end of file
@@ -12,25 +12,13 @@ namespace zv
 		acquireMaterial(material);
 	}
 
-	void Mesh::render() const
+	void Mesh::render(bgfx::Encoder* encoder) const
 	{
-		m_pMaterial->updateUniforms();
-
-		bgfx::setTransform(m_modelMatrix);
-
-		m_pGeometry->bindBuffers();
-
-		m_pMaterial->bindTextures();
-
-		// Set render states.
-		bgfx::setState(0
-			| BGFX_STATE_WRITE_RGB
-			| BGFX_STATE_WRITE_A
-			| BGFX_STATE_WRITE_Z
-			| BGFX_STATE_DEPTH_TEST_LESS
-			| BGFX_STATE_MSAA
-		);
+		RenderQueue::submit(encoder, DrawPacket{ m_pMaterial->viewId(), 0, m_pGeometry.get(), m_pMaterial.get(), m_modelMatrix });
+	}
 
-		m_pMaterial->bindProgram();
+	void Mesh::enqueue(RenderQueue& queue) const
+	{
+		queue.push(m_pMaterial->viewId(), m_pGeometry.get(), m_pMaterial.get(), m_modelMatrix);
 	}
 }
\ No newline at end of file
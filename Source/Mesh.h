@@ -19,6 +19,8 @@ namespace zv
 		Mesh() = delete;
 
 	public:
-		void render() const override;
+		using Object3D::render;
+		void render(bgfx::Encoder* encoder) const override;
+		void enqueue(RenderQueue& queue) const override;
 	};
 }
\ No newline at end of file
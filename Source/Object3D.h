@@ -3,10 +3,14 @@
 
 #include <memory>
 
+#include <bgfx/bgfx.h>
 #include <bx/bx.h>
+#include <bx/math.h>
 
+#include <Culling.h>
 #include <GeometryBase.h>
 #include <MaterialBase.h>
+#include <RenderQueue.h>
 
 
 namespace zv
@@ -23,7 +27,36 @@ namespace zv
 			m_pMaterial->cleanup();
 			m_pGeometry->cleanup();
 		};
-		virtual void render() const = 0;
+		virtual void render(bgfx::Encoder* encoder) const = 0;
+		virtual void enqueue(RenderQueue& queue) const = 0;
+
+		void render() const
+		{
+			bgfx::Encoder* encoder = bgfx::begin();
+			render(encoder);
+			bgfx::end(encoder);
+		}
+
+		// World space bounds for culling. Returning false means "always visible".
+		virtual bool worldAabb(bx::Aabb& result) const
+		{
+			Culling::transformAabb(result, m_pGeometry->aabb(), m_modelMatrix);
+			return true;
+		}
+
+		const f32* modelMatrix() const { return m_modelMatrix; }
+		void setModelMatrix(const f32* modelMatrix) { bx::memCopy(m_modelMatrix, modelMatrix, sizeof(m_modelMatrix)); }
+
+		// Static objects never move and may be merged by StaticBatch::build.
+		bool isStatic() const { return m_static; }
+		void setStatic(bool isStatic) { m_static = isStatic; }
+
+		// Occluders are large, simple meshes rasterized for CPU occlusion culling.
+		bool isOccluder() const { return m_occluder; }
+		void setOccluder(bool isOccluder) { m_occluder = isOccluder; }
+
+		const Geometry* geometry() const { return m_pGeometry.get(); }
+		virtual Material* material() const { return m_pMaterial.get(); }
 
 	protected:
 		void acquireGeometry(std::unique_ptr<Geometry>& geometry) { m_pGeometry = std::move(geometry); }
@@ -33,10 +66,11 @@ namespace zv
 		std::unique_ptr<Geometry> m_pGeometry{ nullptr };
 		std::unique_ptr<Material> m_pMaterial{ nullptr };
 		f32 m_modelMatrix[16];
+		bool m_static{ false };
+		bool m_occluder{ false };
 		// Transform / Matrix
 		
 		// UUID
-		// Render order
 		// Children ?
 	};
 }
\ No newline at end of file
@@ -0,0 +1,288 @@
+#include <Occlusion.h>
+
+
+#include <bx/math.h>
+
+
+namespace zv
+{
+	OcclusionBuffer::OcclusionBuffer(u32 width, u32 height)
+		: m_width((bx::max<u32>(width, 4) + 3) & ~3u)
+		, m_height(bx::max<u32>(height, 1))
+	{
+		m_depth.resize(m_width / 4 * m_height);
+
+		// Each level halves the previous one, rounding up, until a single texel is left.
+		u32 levelWidth = m_width;
+		u32 levelHeight = m_height;
+		u32 offset = 0;
+		m_levels.push_back(Level{ levelWidth, levelHeight, 0 });
+		while (levelWidth > 1 || levelHeight > 1)
+		{
+			levelWidth = (levelWidth + 1) / 2;
+			levelHeight = (levelHeight + 1) / 2;
+			m_levels.push_back(Level{ levelWidth, levelHeight, offset });
+			offset += levelWidth * levelHeight;
+		}
+		m_hiZ.resize(offset);
+
+		bx::mtxIdentity(m_viewProj);
+	}
+
+	void OcclusionBuffer::clear(const f32* viewProj, bool homogeneousDepth)
+	{
+		bx::memCopy(m_viewProj, viewProj, sizeof(m_viewProj));
+		m_homogeneousDepth = homogeneousDepth;
+
+		using namespace bx;
+		const simd128_t farDepth = simd_splat<simd128_t>(1.0f);
+		for (simd128_t& word : m_depth)
+		{
+			word = farDepth;
+		}
+
+		m_numTriangles = 0;
+	}
+
+	void OcclusionBuffer::rasterize(const void* positions, u32 stride, const u16* indices, u32 numIndices, const f32* modelMatrix)
+	{
+		rasterizeIndexed(positions, stride, indices, numIndices, modelMatrix);
+	}
+
+	void OcclusionBuffer::rasterize(const void* positions, u32 stride, const u32* indices, u32 numIndices, const f32* modelMatrix)
+	{
+		rasterizeIndexed(positions, stride, indices, numIndices, modelMatrix);
+	}
+
+	template <typename IndexT>
+	void OcclusionBuffer::rasterizeIndexed(const void* positions, u32 stride, const IndexT* indices, u32 numIndices, const f32* modelMatrix)
+	{
+		f32 modelViewProj[16];
+		bx::mtxMul(modelViewProj, modelMatrix, m_viewProj);
+
+		for (u32 ii = 0; ii + 2 < numIndices; ii += 3)
+		{
+			f32 screen[3][3];
+			bool clipped = false;
+
+			for (u32 corner = 0; corner < 3; ++corner)
+			{
+				const f32* position = (const f32*)((const u8*)positions + indices[ii + corner] * stride);
+				const f32 point[4] = { position[0], position[1], position[2], 1.0f };
+
+				f32 clip[4];
+				bx::vec4MulMtx(clip, point, modelViewProj);
+
+				clipped |= !toScreen(clip, screen[corner]);
+			}
+
+			if (!clipped)
+			{
+				rasterizeTriangle(screen[0], screen[1], screen[2]);
+			}
+		}
+	}
+
+	void OcclusionBuffer::rasterizeTriangle(const f32* v0, const f32* v1, const f32* v2)
+	{
+		f32 area = (v1[0] - v0[0]) * (v2[1] - v0[1]) - (v2[0] - v0[0]) * (v1[1] - v0[1]);
+		if (bx::abs(area) < 1.0e-8f)
+			return;
+
+		// Both windings are drawn, flip clockwise ones so the edge functions are positive inside.
+		if (area < 0.0f)
+		{
+			bx::swap(v1, v2);
+			area = -area;
+		}
+
+		const f32 minX = bx::min(bx::min(v0[0], v1[0]), v2[0]);
+		const f32 maxX = bx::max(bx::max(v0[0], v1[0]), v2[0]);
+		const f32 minY = bx::min(bx::min(v0[1], v1[1]), v2[1]);
+		const f32 maxY = bx::max(bx::max(v0[1], v1[1]), v2[1]);
+
+		if (maxX < 0.0f || maxY < 0.0f || minX >= f32(m_width) || minY >= f32(m_height))
+			return;
+
+		// Pixel bounds, the first column aligned to a SIMD word.
+		const s32 x0 = s32(bx::max(minX, 0.0f)) & ~3;
+		const s32 x1 = s32(bx::min(maxX, f32(m_width - 1)));
+		const s32 y0 = s32(bx::max(minY, 0.0f));
+		const s32 y1 = s32(bx::min(maxY, f32(m_height - 1)));
+
+		// Edge functions e(p) = a * x + b * y + c, one per edge, positive on the inside.
+		const f32* verts[3] = { v0, v1, v2 };
+		f32 edgeA[3], edgeB[3], edgeC[3];
+		for (u32 ii = 0; ii < 3; ++ii)
+		{
+			const f32* from = verts[(ii + 1) % 3];
+			const f32* to = verts[(ii + 2) % 3];
+			edgeA[ii] = from[1] - to[1];
+			edgeB[ii] = to[0] - from[0];
+			edgeC[ii] = -(edgeA[ii] * from[0] + edgeB[ii] * from[1]);
+		}
+
+		// Edge ii is opposite vertex ii, so e_ii / area is vertex ii's barycentric weight.
+		const f32 invArea = 1.0f / area;
+		const f32 depthA = (edgeA[1] * (v1[2] - v0[2]) + edgeA[2] * (v2[2] - v0[2])) * invArea;
+		const f32 depthB = (edgeB[1] * (v1[2] - v0[2]) + edgeB[2] * (v2[2] - v0[2])) * invArea;
+		const f32 depthC = v0[2] - depthA * v0[0] - depthB * v0[1];
+
+		using namespace bx;
+
+		const simd128_t zero = simd_zero<simd128_t>();
+		const simd128_t laneOffset = simd_ld<simd128_t>(0.5f, 1.5f, 2.5f, 3.5f);
+
+		const simd128_t a0 = simd_splat<simd128_t>(edgeA[0]);
+		const simd128_t a1 = simd_splat<simd128_t>(edgeA[1]);
+		const simd128_t a2 = simd_splat<simd128_t>(edgeA[2]);
+		const simd128_t za = simd_splat<simd128_t>(depthA);
+
+		const u32 wordsPerRow = m_width / 4;
+
+		for (s32 y = y0; y <= y1; ++y)
+		{
+			const f32 py = f32(y) + 0.5f;
+
+			const simd128_t c0 = simd_splat<simd128_t>(edgeB[0] * py + edgeC[0]);
+			const simd128_t c1 = simd_splat<simd128_t>(edgeB[1] * py + edgeC[1]);
+			const simd128_t c2 = simd_splat<simd128_t>(edgeB[2] * py + edgeC[2]);
+			const simd128_t zc = simd_splat<simd128_t>(depthB * py + depthC);
+
+			simd128_t* row = &m_depth[y * wordsPerRow];
+
+			for (s32 x = x0; x <= x1; x += 4)
+			{
+				const simd128_t px = simd_add(simd_splat<simd128_t>(f32(x)), laneOffset);
+
+				const simd128_t e0 = simd_madd(a0, px, c0);
+				const simd128_t e1 = simd_madd(a1, px, c1);
+				const simd128_t e2 = simd_madd(a2, px, c2);
+
+				const simd128_t inside = simd_and(simd_cmpge(e0, zero), simd_and(simd_cmpge(e1, zero), simd_cmpge(e2, zero)));
+				if (0 == simd_signbits(inside))
+					continue;
+
+				const simd128_t depth = simd_madd(za, px, zc);
+
+				simd128_t& word = row[x / 4];
+				word = simd_selb(inside, simd_min(word, depth), word);
+			}
+		}
+
+		++m_numTriangles;
+	}
+
+	void OcclusionBuffer::buildHiZ()
+	{
+		for (u32 level = 1; level < numLevels(); ++level)
+		{
+			const Level& parent = m_levels[level - 1];
+			const Level& current = m_levels[level];
+			const f32* src = levelData(level - 1);
+			f32* dst = &m_hiZ[current.offset];
+
+			for (u32 y = 0; y < current.height; ++y)
+			{
+				// Odd sizes fold their last row or column into the previous texel.
+				const u32 sy0 = 2 * y;
+				const u32 sy1 = bx::min(sy0 + 1, parent.height - 1);
+
+				for (u32 x = 0; x < current.width; ++x)
+				{
+					const u32 sx0 = 2 * x;
+					const u32 sx1 = bx::min(sx0 + 1, parent.width - 1);
+
+					dst[y * current.width + x] = bx::max(
+						bx::max(src[sy0 * parent.width + sx0], src[sy0 * parent.width + sx1]),
+						bx::max(src[sy1 * parent.width + sx0], src[sy1 * parent.width + sx1])
+					);
+				}
+			}
+		}
+	}
+
+	bool OcclusionBuffer::isVisible(const bx::Aabb& aabb) const
+	{
+		f32 minX = bx::kFloatLargest, minY = bx::kFloatLargest, minZ = bx::kFloatLargest;
+		f32 maxX = -bx::kFloatLargest, maxY = -bx::kFloatLargest;
+
+		for (u32 ii = 0; ii < 8; ++ii)
+		{
+			const f32 corner[4] = {
+				(ii & 1) ? aabb.max.x : aabb.min.x,
+				(ii & 2) ? aabb.max.y : aabb.min.y,
+				(ii & 4) ? aabb.max.z : aabb.min.z,
+				1.0f,
+			};
+
+			f32 clip[4];
+			bx::vec4MulMtx(clip, corner, m_viewProj);
+
+			// Reaches behind the camera, can't be bounded on screen.
+			f32 screen[3];
+			if (!toScreen(clip, screen))
+				return true;
+
+			minX = bx::min(minX, screen[0]);
+			maxX = bx::max(maxX, screen[0]);
+			minY = bx::min(minY, screen[1]);
+			maxY = bx::max(maxY, screen[1]);
+			minZ = bx::min(minZ, screen[2]);
+		}
+
+		// Off screen boxes are left to frustum culling.
+		if (maxX < 0.0f || maxY < 0.0f || minX >= f32(m_width) || minY >= f32(m_height))
+			return true;
+
+		const u32 x0 = u32(bx::max(minX, 0.0f));
+		const u32 x1 = u32(bx::min(maxX, f32(m_width - 1)));
+		const u32 y0 = u32(bx::max(minY, 0.0f));
+		const u32 y1 = u32(bx::min(maxY, f32(m_height - 1)));
+
+		// Coarsest level at which the rectangle spans at most 2x2 texels.
+		u32 level = 0;
+		while ((x1 >> level) - (x0 >> level) > 1 || (y1 >> level) - (y0 >> level) > 1)
+		{
+			++level;
+		}
+
+		f32 maxDepth = 0.0f;
+		for (u32 y = y0 >> level; y <= y1 >> level; ++y)
+		{
+			for (u32 x = x0 >> level; x <= x1 >> level; ++x)
+			{
+				maxDepth = bx::max(maxDepth, depth(level, x, y));
+			}
+		}
+
+		return minZ <= maxDepth;
+	}
+
+	f32 OcclusionBuffer::depth(u32 level, u32 x, u32 y) const
+	{
+		return levelData(level)[y * m_levels[level].width + x];
+	}
+
+	bool OcclusionBuffer::toScreen(const f32* clip, f32* screen) const
+	{
+		if (clip[3] <= MinW)
+			return false;
+
+		const f32 invW = 1.0f / clip[3];
+		const f32 z = clip[2] * invW;
+
+		screen[0] = (clip[0] * invW * 0.5f + 0.5f) * f32(m_width);
+		screen[1] = (0.5f - clip[1] * invW * 0.5f) * f32(m_height);
+		screen[2] = m_homogeneousDepth ? z * 0.5f + 0.5f : z;
+		return true;
+	}
+
+	const f32* OcclusionBuffer::levelData(u32 level) const
+	{
+		if (0 == level)
+			return (const f32*)m_depth.data();
+
+		return &m_hiZ[m_levels[level].offset];
+	}
+}
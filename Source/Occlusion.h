@@ -0,0 +1,90 @@
+#pragma once
+
+
+#include <vector>
+
+#include <bx/bounds.h>
+#include <bx/simd_t.h>
+
+#include <Types.h>
+
+
+namespace zv
+{
+	/*
+	Low resolution software depth buffer for occlusion culling. A few large
+	occluders are rasterized on the CPU, four pixels per SIMD step, then a
+	Hi-Z chain keeps the farthest depth of every 2x2 block per level. A box is
+	hidden when its nearest depth is behind the farthest depth of the Hi-Z
+	texels it covers.
+
+	Depends on bx only, so it runs without a GPU or bgfx.
+	*/
+	class OcclusionBuffer
+	{
+	public:
+		// width is rounded up to a multiple of four.
+		OcclusionBuffer(u32 width = 256, u32 height = 128);
+		~OcclusionBuffer() = default;
+
+	public:
+		// Starts a frame: clears depth to the far plane and captures the view projection.
+		void clear(const f32* viewProj, bool homogeneousDepth);
+
+		// Rasterizes an indexed triangle list. positions points at the first vertex's
+		// x, y, z and vertices are stride bytes apart. Triangles crossing the near
+		// plane are dropped, which only ever makes the buffer less conservative about
+		// hiding things.
+		void rasterize(const void* positions, u32 stride, const u16* indices, u32 numIndices, const f32* modelMatrix);
+		void rasterize(const void* positions, u32 stride, const u32* indices, u32 numIndices, const f32* modelMatrix);
+
+		// Builds the Hi-Z levels from the rasterized depth. Call after all occluders.
+		void buildHiZ();
+
+		// False when the world space box is fully hidden behind the occluders.
+		bool isVisible(const bx::Aabb& aabb) const;
+
+		u32 width() const { return m_width; }
+		u32 height() const { return m_height; }
+		u32 numLevels() const { return (u32)m_levels.size(); }
+
+		// Depth at a texel of a Hi-Z level, level 0 is the rasterized buffer.
+		f32 depth(u32 level, u32 x, u32 y) const;
+
+		u32 numTriangles() const { return m_numTriangles; }
+
+	private:
+		struct Level
+		{
+			u32 width;
+			u32 height;
+			u32 offset;  // Into m_hiZ, level 0 lives in m_depth.
+		};
+
+		template <typename IndexT>
+		void rasterizeIndexed(const void* positions, u32 stride, const IndexT* indices, u32 numIndices, const f32* modelMatrix);
+		void rasterizeTriangle(const f32* v0, const f32* v1, const f32* v2);
+
+		// Clip space to pixel x, y and depth. False when w is at or behind the near plane.
+		bool toScreen(const f32* clip, f32* screen) const;
+
+		const f32* levelData(u32 level) const;
+
+	private:
+		static constexpr f32 MinW = 1.0e-4f;
+
+		u32 m_width;
+		u32 m_height;
+
+		// Row major, width / 4 SIMD words per row.
+		std::vector<bx::simd128_t> m_depth{};
+
+		std::vector<f32> m_hiZ{};
+		std::vector<Level> m_levels{};
+
+		f32 m_viewProj[16];
+		bool m_homogeneousDepth{ false };
+
+		u32 m_numTriangles{ 0 };
+	};
+}
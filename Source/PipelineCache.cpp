@@ -0,0 +1,347 @@
+#include <PipelineCache.h>
+
+
+#include <algorithm>
+#include <cctype>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#include <bx/debug.h>
+#include <bx/hash.h>
+
+
+namespace zv
+{
+	namespace
+	{
+		namespace fs = std::filesystem;
+
+		u32 hashPayload(const void* _data, u32 _size)
+		{
+			bx::HashMurmur2A hash;
+			hash.begin();
+			hash.add(_data, (s32)_size);
+			return hash.end();
+		}
+	}
+
+
+	PipelineCache::PipelineCache(const char* _dirPath, u64 _maxBytes)
+		: m_maxBytes(_maxBytes)
+	{
+		// Entries of another bgfx or format version are never read again. The
+		// versions live in a directory of their own, whatever else _dirPath holds
+		// is left alone.
+		char version[32];
+		snprintf(version, sizeof(version), "v%u-bgfx%u", Version, (u32)BGFX_API_VERSION);
+		const fs::path rootPath = fs::path(_dirPath) / RootName;
+		m_dirPath = (rootPath / version).string();
+
+		std::error_code ec;
+		fs::create_directories(m_dirPath, ec);
+		if (ec)
+		{
+			bx::debugPrintf("Failed to create pipeline cache directory %s: %s\n", m_dirPath.c_str(), ec.message().c_str());
+			return;
+		}
+
+		for (fs::directory_iterator it(rootPath, ec), end; !ec && it != end; it.increment(ec))
+		{
+			u32 oldVersion = 0;
+			u32 oldApiVersion = 0;
+			const std::string name = it->path().filename().string();
+			if (name != version && it->is_directory() && 2 == sscanf(name.c_str(), "v%u-bgfx%u", &oldVersion, &oldApiVersion))
+			{
+				removeVersion(it->path().string());
+			}
+		}
+
+		struct Found
+		{
+			fs::file_time_type time;
+			u64 id;
+			u64 bytes;
+		};
+
+		std::vector<Found> found;
+		for (fs::directory_iterator it(m_dirPath, ec), end; !ec && it != end; it.increment(ec))
+		{
+			const fs::path& path = it->path();
+
+			bool temp = false;
+			u64 id = 0;
+			if (!parseEntryName(path.filename().string(), id, temp))
+				continue;
+
+			// Left behind by a write that didn't finish.
+			if (temp)
+			{
+				std::error_code removeEc;
+				fs::remove(path, removeEc);
+				continue;
+			}
+
+			std::error_code statEc;
+			const u64 bytes = fs::file_size(path, statEc);
+			const fs::file_time_type time = fs::last_write_time(path, statEc);
+			if (!statEc)
+			{
+				found.push_back({ time, id, bytes });
+			}
+		}
+
+		// Last write times carry the use order across runs, reads touch them.
+		std::sort(found.begin(), found.end(), [](const Found& _a, const Found& _b) { return _a.time < _b.time; });
+		for (const Found& item : found)
+		{
+			m_entries[item.id] = { item.bytes, ++m_clock };
+			m_totalBytes += item.bytes;
+		}
+
+		// The limit may have shrunk since the last run.
+		makeRoom(0);
+		m_bytes.store(m_totalBytes, std::memory_order_relaxed);
+	}
+
+	void PipelineCache::fatal(const char* _filePath, u16 _line, bgfx::Fatal::Enum _code, const char* _str)
+	{
+		bx::debugPrintf("%s(%d): bgfx fatal error 0x%08x: %s\n", _filePath, _line, (u32)_code, _str);
+
+		if (bgfx::Fatal::DebugCheck == _code)
+		{
+			bx::debugBreak();
+		}
+		else
+		{
+			abort();
+		}
+	}
+
+	void PipelineCache::traceVargs(const char* _filePath, u16 _line, const char* _format, va_list _argList)
+	{
+		char temp[2048];
+		const s32 len = snprintf(temp, sizeof(temp), "%s (%d): ", _filePath, _line);
+		if (len >= 0 && len < (s32)sizeof(temp))
+		{
+			vsnprintf(temp + len, sizeof(temp) - len, _format, _argList);
+		}
+		bx::debugOutput(temp);
+	}
+
+	u32 PipelineCache::cacheReadSize(u64 _id)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		m_pending.clear();
+		if (m_entries.end() == m_entries.find(_id))
+		{
+			m_misses.fetch_add(1, std::memory_order_relaxed);
+			return 0;
+		}
+
+		const std::string path = entryPath(_id);
+		std::ifstream file(path, std::ios::binary);
+
+		EntryHeader header{};
+		file.read((char*)&header, sizeof(header));
+
+		std::error_code ec;
+		const u64 fileSize = fs::file_size(path, ec);
+
+		// Checked before the size is trusted for the allocation.
+		bool valid = file.good() && !ec
+			&& Magic == header.magic
+			&& Version == header.version
+			&& _id == header.id
+			&& fileSize == sizeof(header) + header.size;
+
+		if (valid)
+		{
+			m_pending.resize(header.size);
+			file.read((char*)m_pending.data(), header.size);
+			valid = file.good() && header.hash == hashPayload(m_pending.data(), header.size);
+		}
+		file.close();
+
+		if (!valid)
+		{
+			m_pending.clear();
+			drop(_id);
+			m_corrupt.fetch_add(1, std::memory_order_relaxed);
+			m_misses.fetch_add(1, std::memory_order_relaxed);
+			return 0;
+		}
+
+		m_pendingId = _id;
+		return header.size;
+	}
+
+	bool PipelineCache::cacheRead(u64 _id, void* _data, u32 _size)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		if (m_pending.empty() || m_pendingId != _id || m_pending.size() != _size)
+		{
+			m_pending.clear();
+			m_misses.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+
+		memcpy(_data, m_pending.data(), _size);
+		m_pending.clear();
+		touch(_id);
+
+		m_hits.fetch_add(1, std::memory_order_relaxed);
+		return true;
+	}
+
+	void PipelineCache::cacheWrite(u64 _id, const void* _data, u32 _size)
+	{
+		const u64 bytes = sizeof(EntryHeader) + _size;
+		if (NULL == _data || 0 == _size || bytes > m_maxBytes)
+			return;
+
+		EntryHeader header{};
+		header.magic = Magic;
+		header.version = Version;
+		header.id = _id;
+		header.size = _size;
+		header.hash = hashPayload(_data, _size);
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		// Rewrites replace the old entry.
+		drop(_id);
+		makeRoom(bytes);
+
+		// Written aside and renamed, a crash mid-write leaves no entry rather than a torn one.
+		const std::string path = entryPath(_id);
+		const std::string temp = path + ".tmp";
+		{
+			std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+			file.write((const char*)&header, sizeof(header));
+			file.write((const char*)_data, _size);
+			file.close();
+
+			std::error_code ec;
+			if (!file)
+			{
+				fs::remove(temp, ec);
+				return;
+			}
+
+			fs::rename(temp, path, ec);
+			if (ec)
+			{
+				fs::remove(temp, ec);
+				return;
+			}
+		}
+
+		m_entries[_id] = { bytes, ++m_clock };
+		m_totalBytes += bytes;
+		m_bytes.store(m_totalBytes, std::memory_order_relaxed);
+		m_writes.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	PipelineCacheStats PipelineCache::stats() const
+	{
+		PipelineCacheStats stats;
+		stats.hits = m_hits.load(std::memory_order_relaxed);
+		stats.misses = m_misses.load(std::memory_order_relaxed);
+		stats.writes = m_writes.load(std::memory_order_relaxed);
+		stats.corrupt = m_corrupt.load(std::memory_order_relaxed);
+		stats.evictions = m_evictions.load(std::memory_order_relaxed);
+		stats.bytes = m_bytes.load(std::memory_order_relaxed);
+		stats.maxBytes = m_maxBytes;
+		return stats;
+	}
+
+	std::string PipelineCache::entryPath(u64 _id) const
+	{
+		char name[32];
+		snprintf(name, sizeof(name), "%016" PRIx64 ".bin", (uint64_t)_id);
+		return (fs::path(m_dirPath) / name).string();
+	}
+
+	bool PipelineCache::parseEntryName(const std::string& _name, u64& _id, bool& _temp)
+	{
+		// <16 hex digits>.bin, or .bin.tmp while it is written, see entryPath().
+		constexpr size_t IdLength = 16;
+		_temp = _name.size() == IdLength + 8 && 0 == _name.compare(IdLength, 8, ".bin.tmp");
+		if (!_temp && !(_name.size() == IdLength + 4 && 0 == _name.compare(IdLength, 4, ".bin")))
+			return false;
+
+		for (size_t ii = 0; ii < IdLength; ++ii)
+		{
+			if (!isxdigit((unsigned char)_name[ii]))
+				return false;
+		}
+
+		_id = std::strtoull(_name.substr(0, IdLength).c_str(), NULL, 16);
+		return true;
+	}
+
+	void PipelineCache::removeVersion(const std::string& _dirPath)
+	{
+		// Only entries go, anything else someone put there keeps the directory.
+		std::error_code ec;
+		for (fs::directory_iterator it(_dirPath, ec), end; !ec && it != end; it.increment(ec))
+		{
+			bool temp = false;
+			u64 id = 0;
+			if (it->is_regular_file() && parseEntryName(it->path().filename().string(), id, temp))
+			{
+				std::error_code removeEc;
+				fs::remove(it->path(), removeEc);
+			}
+		}
+
+		// Fails unless it is empty now.
+		fs::remove(_dirPath, ec);
+	}
+
+	void PipelineCache::touch(u64 _id)
+	{
+		auto it = m_entries.find(_id);
+		if (m_entries.end() == it)
+			return;
+
+		it->second.lastUsed = ++m_clock;
+
+		std::error_code ec;
+		fs::last_write_time(entryPath(_id), fs::file_time_type::clock::now(), ec);
+	}
+
+	void PipelineCache::drop(u64 _id)
+	{
+		std::error_code ec;
+		fs::remove(entryPath(_id), ec);
+
+		auto it = m_entries.find(_id);
+		if (m_entries.end() == it)
+			return;
+
+		m_totalBytes -= it->second.bytes;
+		m_entries.erase(it);
+		m_bytes.store(m_totalBytes, std::memory_order_relaxed);
+	}
+
+	void PipelineCache::makeRoom(u64 _bytes)
+	{
+		while (!m_entries.empty() && m_totalBytes + _bytes > m_maxBytes)
+		{
+			auto oldest = std::min_element(m_entries.begin(), m_entries.end(), [](const auto& _a, const auto& _b)
+			{
+				return _a.second.lastUsed < _b.second.lastUsed;
+			});
+
+			drop(oldest->first);
+			m_evictions.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+
+#include <atomic>
+#include <cstdarg>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <bgfx/bgfx.h>
+
+#include <Types.h>
+
+
+namespace zv
+{
+	struct PipelineCacheStats
+	{
+		u32 hits{ 0 };
+		u32 misses{ 0 };
+		u32 writes{ 0 };
+		u32 corrupt{ 0 };    // Entries that failed validation and were dropped.
+		u32 evictions{ 0 };
+		u64 bytes{ 0 };
+		u64 maxBytes{ 0 };
+	};
+
+	/*
+	bgfx callback that persists what the backend builds from shaders, the
+	translated shaders, linked GL programs and the like, so a warm start
+	skips that work. bgfx picks the 64-bit ids, which are hashes of the
+	content, and each one becomes a file in a directory versioned by bgfx's
+	API and the entry format, under zv-pipeline-cache in the directory given.
+	The entries of older versions are deleted on start.
+
+	Every entry carries a header and a hash of its payload, a truncated or
+	corrupt entry is dropped and reads as a miss, so bgfx builds it again.
+	Once the directory grows past its size limit, the least recently used
+	entries go first.
+
+	The rest of bgfx::CallbackI behaves like bgfx's default. Called from the
+	render thread, stats() from any thread.
+	*/
+	class PipelineCache : public bgfx::CallbackI
+	{
+	public:
+		PipelineCache(const char* _dirPath, u64 _maxBytes = 64 << 20);
+		~PipelineCache() override = default;
+
+		PipelineCache(const PipelineCache&) = delete;
+		PipelineCache& operator=(const PipelineCache&) = delete;
+
+	public:
+		void fatal(const char* _filePath, u16 _line, bgfx::Fatal::Enum _code, const char* _str) override;
+		void traceVargs(const char* _filePath, u16 _line, const char* _format, va_list _argList) override;
+
+		void profilerBegin(const char* /*_name*/, u32 /*_abgr*/, const char* /*_filePath*/, u16 /*_line*/) override {}
+		void profilerBeginLiteral(const char* /*_name*/, u32 /*_abgr*/, const char* /*_filePath*/, u16 /*_line*/) override {}
+		void profilerEnd() override {}
+
+		// bgfx asks for the size first and reads right after, the entry is loaded and checked once.
+		u32 cacheReadSize(u64 _id) override;
+		bool cacheRead(u64 _id, void* _data, u32 _size) override;
+		void cacheWrite(u64 _id, const void* _data, u32 _size) override;
+
+		void screenShot(const char* /*_filePath*/, u32 /*_width*/, u32 /*_height*/, u32 /*_pitch*/, const void* /*_data*/, u32 /*_size*/, bool /*_yflip*/) override {}
+		void captureBegin(u32 /*_width*/, u32 /*_height*/, u32 /*_pitch*/, bgfx::TextureFormat::Enum /*_format*/, bool /*_yflip*/) override {}
+		void captureEnd() override {}
+		void captureFrame(const void* /*_data*/, u32 /*_size*/) override {}
+
+		PipelineCacheStats stats() const;
+
+	private:
+		struct EntryHeader
+		{
+			u32 magic;
+			u32 version;
+			u64 id;
+			u32 size;
+			u32 hash;  // Of the payload.
+		};
+
+		struct Entry
+		{
+			u64 bytes;     // On disk, header included.
+			u64 lastUsed;  // Ordered by m_clock.
+		};
+
+		std::string entryPath(u64 _id) const;
+
+		// Whether _name is an entry file this cache writes, _temp for one still being written.
+		static bool parseEntryName(const std::string& _name, u64& _id, bool& _temp);
+
+		// Deletes the entries of an older version and then its directory, when nothing else is left in it.
+		static void removeVersion(const std::string& _dirPath);
+		void touch(u64 _id);
+		void drop(u64 _id);
+
+		// Evicts least recently used entries until _bytes more fit.
+		void makeRoom(u64 _bytes);
+
+	private:
+		static constexpr u32 Magic = BX_MAKEFOURCC('Z', 'V', 'P', 'C');
+		static constexpr u32 Version = 1;
+		static constexpr const char* RootName = "zv-pipeline-cache";
+
+		std::string m_dirPath;
+		u64 m_maxBytes;
+
+		std::mutex m_mutex;
+		std::unordered_map<u64, Entry> m_entries{};
+		u64 m_totalBytes{ 0 };
+		u64 m_clock{ 0 };
+
+		// Loaded by cacheReadSize(), handed over by cacheRead().
+		u64 m_pendingId{ 0 };
+		std::vector<u8> m_pending{};
+
+		std::atomic<u32> m_hits{ 0 };
+		std::atomic<u32> m_misses{ 0 };
+		std::atomic<u32> m_writes{ 0 };
+		std::atomic<u32> m_corrupt{ 0 };
+		std::atomic<u32> m_evictions{ 0 };
+		std::atomic<u64> m_bytes{ 0 };
+	};
+}
@@ -0,0 +1,230 @@
+#include <RenderQueue.h>
+
+
+#include <bx/math.h>
+#include <bx/sort.h>
+
+#include <StateCache.h>
+
+
+namespace zv
+{
+	void RenderQueue::reset(const Camera& camera, const Frustum& frustum)
+	{
+		m_packets.clear();
+		m_keys.clear();
+		m_batchMatrices.clear();
+		m_numMergedDraws = 0;
+
+		m_frustum = frustum;
+		m_eye = camera.position();
+		m_forward = camera.forward();
+		m_zNear = camera.zNear();
+		m_zFar = camera.zFar();
+	}
+
+	void RenderQueue::push(bgfx::ViewId view, const Geometry* geometry, Material* material, const f32* modelMatrix)
+	{
+		const u32 depth = quantizeDepth({ modelMatrix[12], modelMatrix[13], modelMatrix[14] });
+
+		m_keys.push_back(makeKey(view, material->isTranslucent(), material->program().idx, material->textureKey(), depth));
+		m_packets.push_back(DrawPacket{ view, depth, geometry, material, modelMatrix });
+	}
+
+	void RenderQueue::pushInstanced(bgfx::ViewId view, const Geometry* geometry, Material* material, const f32* modelMatrix,
+									const f32* instanceData, u32 numInstances)
+	{
+		const u32 depth = quantizeDepth({ modelMatrix[12], modelMatrix[13], modelMatrix[14] });
+
+		m_keys.push_back(makeKey(view, material->isTranslucent(), material->instancedProgram().idx, material->textureKey(), depth));
+		m_packets.push_back(DrawPacket{ view, depth, geometry, material, modelMatrix, instanceData, numInstances });
+	}
+
+	void RenderQueue::pushRange(bgfx::ViewId view, const Geometry* geometry, Material* material, const f32* modelMatrix,
+								u32 firstIndex, u32 numIndices, const vec3& center)
+	{
+		const u32 depth = quantizeDepth(center);
+
+		m_keys.push_back(makeKey(view, material->isTranslucent(), material->program().idx, material->textureKey(), depth));
+		m_packets.push_back(DrawPacket{ view, depth, geometry, material, modelMatrix, nullptr, 0, firstIndex, numIndices });
+	}
+
+	void RenderQueue::batch()
+	{
+		static const f32 s_identity[16] = {
+			1.0f, 0.0f, 0.0f, 0.0f,
+			0.0f, 1.0f, 0.0f, 0.0f,
+			0.0f, 0.0f, 1.0f, 0.0f,
+			0.0f, 0.0f, 0.0f, 1.0f,
+		};
+
+		// Radix sort the candidates by a hash of everything that has to match,
+		// equal draws then form runs.
+		m_batchHashes.clear();
+		m_batchCandidates.clear();
+		for (u32 ii = 0; ii < size(); ++ii)
+		{
+			if (isBatchable(m_packets[ii]))
+			{
+				m_batchHashes.push_back(batchHash(m_packets[ii]));
+				m_batchCandidates.push_back(ii);
+			}
+		}
+
+		const u32 numCandidates = (u32)m_batchCandidates.size();
+		if (numCandidates < MinBatchSize)
+			return;
+
+		m_tempKeys.resize(numCandidates);
+		m_tempOrder.resize(numCandidates);
+		bx::radixSort(m_batchHashes.data(), m_tempKeys.data(), m_batchCandidates.data(), m_tempOrder.data(), numCandidates);
+
+		m_batchMatrices.reserve(numCandidates * 16);
+
+		m_merged.assign(size(), false);
+		m_batches.clear();
+		m_batchKeys.clear();
+
+		u32 runBegin = 0;
+		while (runBegin < numCandidates)
+		{
+			const DrawPacket& first = m_packets[m_batchCandidates[runBegin]];
+
+			u32 runEnd = runBegin + 1;
+			while (runEnd < numCandidates
+				&& m_batchHashes[runEnd] == m_batchHashes[runBegin]
+				&& canBatch(first, m_packets[m_batchCandidates[runEnd]]))
+			{
+				++runEnd;
+			}
+
+			if (runEnd - runBegin >= MinBatchSize)
+			{
+				const f32* instanceData = m_batchMatrices.data() + m_batchMatrices.size();
+				u32 depth = DepthMax;
+
+				for (u32 ii = runBegin; ii < runEnd; ++ii)
+				{
+					const DrawPacket& packet = m_packets[m_batchCandidates[ii]];
+					m_batchMatrices.insert(m_batchMatrices.end(), packet.modelMatrix, packet.modelMatrix + 16);
+					depth = bx::min(depth, packet.depth);
+					m_merged[m_batchCandidates[ii]] = true;
+				}
+
+				const u32 numInstances = runEnd - runBegin;
+				m_batches.push_back(DrawPacket{ first.view, depth, first.geometry, first.material, s_identity, instanceData, numInstances });
+				m_batchKeys.push_back(makeKey(first.view, false, first.material->instancedProgram().idx, first.material->textureKey(), depth));
+
+				m_numMergedDraws += numInstances;
+			}
+
+			runBegin = runEnd;
+		}
+
+		if (m_batches.empty())
+			return;
+
+		// Compact the surviving packets and append the merged ones.
+		u32 numKept = 0;
+		for (u32 ii = 0; ii < size(); ++ii)
+		{
+			if (!m_merged[ii])
+			{
+				m_packets[numKept] = m_packets[ii];
+				m_keys[numKept] = m_keys[ii];
+				++numKept;
+			}
+		}
+
+		m_packets.resize(numKept);
+		m_keys.resize(numKept);
+		m_packets.insert(m_packets.end(), m_batches.begin(), m_batches.end());
+		m_keys.insert(m_keys.end(), m_batchKeys.begin(), m_batchKeys.end());
+	}
+
+	void RenderQueue::sort()
+	{
+		const u32 numPackets = size();
+
+		m_order.resize(numPackets);
+		for (u32 ii = 0; ii < numPackets; ++ii)
+		{
+			m_order[ii] = ii;
+		}
+
+		m_tempKeys.resize(numPackets);
+		m_tempOrder.resize(numPackets);
+
+		bx::radixSort(m_keys.data(), m_tempKeys.data(), m_order.data(), m_tempOrder.data(), numPackets);
+
+		for (u32 ii = 0; ii < numPackets; ++ii)
+		{
+			m_packets[m_order[ii]].depth = ii;
+		}
+	}
+
+	void RenderQueue::submit(bgfx::Encoder* encoder, const DrawPacket& packet)
+	{
+		StateCache(encoder).submit(packet);
+	}
+
+	u32 RenderQueue::quantizeDepth(const vec3& position) const
+	{
+		// Projected onto the view direction.
+		const f32 viewZ = bx::dot(bx::sub(position, m_eye), m_forward);
+
+		const f32 normalized = bx::clamp((viewZ - m_zNear) / (m_zFar - m_zNear), 0.0f, 1.0f);
+		return u32(normalized * f32(DepthMax));
+	}
+
+	u64 RenderQueue::makeKey(bgfx::ViewId view, bool translucent, u16 program, u16 textures, u32 depth)
+	{
+		const u64 viewBits = u64(view) << 56;
+		const u64 programBits = u64(program & 0xfff);
+		const u64 textureBits = u64(textures);
+		const u64 depthBits = u64(depth & DepthMax);
+
+		if (translucent)
+		{
+			return viewBits
+				| (u64(1) << 55)
+				| ((DepthMax - depthBits) << 31)
+				| (programBits << 19)
+				| (textureBits << 3);
+		}
+
+		return viewBits
+			| (programBits << 43)
+			| (textureBits << 27)
+			| (depthBits << 3);
+	}
+
+	bool RenderQueue::isBatchable(const DrawPacket& packet)
+	{
+		// Translucent draws must keep their back to front order.
+		return 0 == packet.numInstances
+			&& UINT32_MAX == packet.numIndices
+			&& !packet.material->isTranslucent()
+			&& 0 != packet.material->uniformKey()
+			&& bgfx::isValid(packet.material->instancedProgram());
+	}
+
+	bool RenderQueue::canBatch(const DrawPacket& a, const DrawPacket& b)
+	{
+		return a.view == b.view
+			&& a.geometry->vertexBuffer().idx == b.geometry->vertexBuffer().idx
+			&& a.geometry->indexBuffer().idx == b.geometry->indexBuffer().idx
+			&& a.material->canBatchWith(*b.material);
+	}
+
+	u64 RenderQueue::batchHash(const DrawPacket& packet)
+	{
+		u64 hash = packet.material->uniformKey();
+		hash = hash * 0x100000001b3ull ^ packet.view;
+		hash = hash * 0x100000001b3ull ^ packet.geometry->vertexBuffer().idx;
+		hash = hash * 0x100000001b3ull ^ packet.geometry->indexBuffer().idx;
+		hash = hash * 0x100000001b3ull ^ packet.material->program().idx;
+		hash = hash * 0x100000001b3ull ^ packet.material->textureKey();
+		return hash;
+	}
+}
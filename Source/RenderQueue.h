@@ -0,0 +1,127 @@
+#pragma once
+
+
+#include <vector>
+
+#include <bgfx/bgfx.h>
+
+#include <Camera.h>
+#include <Culling.h>
+#include <GeometryBase.h>
+#include <MaterialBase.h>
+#include <Types.h>
+
+
+namespace zv
+{
+	struct DrawPacket
+	{
+		bgfx::ViewId view;
+		// Quantized view depth until RenderQueue::sort(), then the packet's place in
+		// the sorted queue. Forwarded to bgfx::submit either way.
+		u32 depth;
+
+		const Geometry* geometry;
+		Material* material;
+		const f32* modelMatrix;
+
+		// Instanced draws only: numInstances column-major 4x4 matrices.
+		const f32* instanceData{ nullptr };
+		u32 numInstances{ 0 };
+
+		// Index range, the whole index buffer by default.
+		u32 firstIndex{ 0 };
+		u32 numIndices{ UINT32_MAX };
+	};
+
+	/*
+	Sort key layout, most significant bit first:
+
+	  opaque:      view:8 | 0:1 | program:12 | textures:16 | depth:24      | unused:3
+	  translucent: view:8 | 1:1 | ~depth:24  | program:12  | textures:16   | unused:3
+
+	Opaque draws group by program and texture set, then go front to back for
+	early-Z. Translucent draws go back to front after all opaque draws.
+
+	bgfx sorts every view again by its own key. Renderer::submit() runs the
+	queue's views in DepthAscending mode and sort() replaces the depths with
+	sorted positions, so that order is the queue's whatever encoder a draw
+	went through.
+	*/
+	class RenderQueue
+	{
+	public:
+		RenderQueue() = default;
+		~RenderQueue() = default;
+
+	public:
+		// Clears the queue and captures the camera used for depth keys. Objects
+		// with finer grained bounds than their own can cull against frustum.
+		void reset(const Camera& camera, const Frustum& frustum);
+
+		void push(bgfx::ViewId view, const Geometry* geometry, Material* material, const f32* modelMatrix);
+		void pushInstanced(bgfx::ViewId view, const Geometry* geometry, Material* material, const f32* modelMatrix,
+						   const f32* instanceData, u32 numInstances);
+		void pushRange(bgfx::ViewId view, const Geometry* geometry, Material* material, const f32* modelMatrix,
+					   u32 firstIndex, u32 numIndices, const vec3& center);
+
+		// Merges opaque single draws that share buffers, program, textures, state
+		// and uniforms into instanced draws. Call before sort().
+		void batch();
+
+		// Radix sorts the packets by key. Indexing afterwards follows the sorted order
+		// and each packet's depth is its index.
+		void sort();
+
+		u32 size() const { return (u32)m_packets.size(); }
+		u32 numMergedDraws() const { return m_numMergedDraws; }
+		const Frustum& frustum() const { return m_frustum; }
+		const DrawPacket& operator[](u32 index) const { return m_packets[m_order[index]]; }
+
+		// Issues a single packet with no state carried over, for immediate rendering.
+		static void submit(bgfx::Encoder* encoder, const DrawPacket& packet);
+
+		// Bytes per instance, one 4x4 matrix.
+		static constexpr u16 InstanceStride = 16 * sizeof(f32);
+
+	private:
+		u32 quantizeDepth(const vec3& position) const;
+
+		static u64 makeKey(bgfx::ViewId view, bool translucent, u16 program, u16 textures, u32 depth);
+
+		static bool isBatchable(const DrawPacket& packet);
+		static bool canBatch(const DrawPacket& a, const DrawPacket& b);
+		static u64 batchHash(const DrawPacket& packet);
+
+	private:
+		static constexpr u32 DepthBits = 24;
+		static constexpr u32 DepthMax = (1u << DepthBits) - 1;
+
+		// Runs shorter than this stay separate draws.
+		static constexpr u32 MinBatchSize = 2;
+
+		std::vector<DrawPacket> m_packets{};
+		std::vector<u64> m_keys{};
+		std::vector<u32> m_order{};
+
+		std::vector<u64> m_tempKeys{};
+		std::vector<u32> m_tempOrder{};
+
+		// Model matrices of merged draws. Reserved up front so packets can point into it.
+		std::vector<f32> m_batchMatrices{};
+
+		// batch() scratch, kept between frames so it stops allocating.
+		std::vector<u64> m_batchHashes{};
+		std::vector<u32> m_batchCandidates{};
+		std::vector<bool> m_merged{};
+		std::vector<DrawPacket> m_batches{};
+		std::vector<u64> m_batchKeys{};
+		u32 m_numMergedDraws{ 0 };
+
+		Frustum m_frustum{};
+		vec3 m_eye{ 0.0f, 0.0f, 0.0f };
+		vec3 m_forward{ 0.0f, 0.0f, 1.0f };
+		f32 m_zNear{ 0.0f };
+		f32 m_zFar{ 1.0f };
+	};
+}
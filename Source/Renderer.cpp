@@ -0,0 +1,158 @@
+#include <Renderer.h>
+
+
+#include <bx/bx.h>
+
+#include <StateCache.h>
+#include <VertexFormat.h>
+
+
+namespace zv
+{
+	ThreadPool* Renderer::s_ThreadPool = NULL;
+	bool Renderer::s_AutoInstancing = true;
+
+	bool Renderer::s_DepthPrepass = false;
+	bgfx::ViewId Renderer::s_DepthPrepassSceneView = 0;
+	bgfx::ProgramHandle Renderer::s_hDepthProgram = BGFX_INVALID_HANDLE;
+	bgfx::ProgramHandle Renderer::s_hDepthProgramInstanced = BGFX_INVALID_HANDLE;
+
+	bgfx::UniformHandle Renderer::s_hUVertexDequant = BGFX_INVALID_HANDLE;
+
+
+	void Renderer::init(u32 numWorkers)
+	{
+		// Encoder 0 belongs to the API thread, every worker needs one of its own.
+		const u32 maxWorkers = bgfx::getCaps()->limits.maxEncoders - 1;
+
+		if (0 == numWorkers)
+		{
+			numWorkers = bx::max<u32>(std::thread::hardware_concurrency(), 1) - 1;
+		}
+
+		s_ThreadPool = new ThreadPool(bx::min(numWorkers, maxWorkers));
+
+		// Move the prepass view in front of all others, views otherwise run in id order.
+		std::vector<bgfx::ViewId> order;
+		order.push_back(DepthPrepassView);
+		for (u32 view = 0; view < bgfx::getCaps()->limits.maxViews; ++view)
+		{
+			if (DepthPrepassView != view)
+				order.push_back(bgfx::ViewId(view));
+		}
+		bgfx::setViewOrder(0, u16(order.size()), order.data());
+
+		bgfx::setViewName(DepthPrepassView, "Depth prepass");
+		bgfx::setViewMode(DepthPrepassView, bgfx::ViewMode::DepthAscending);
+		bgfx::setViewClear(DepthPrepassView, BGFX_CLEAR_DEPTH, 0, 1.0f, 0);
+
+		// Shared by every geometry, set up once before any of them uploads.
+		VertexFormats::init();
+		s_hUVertexDequant = bgfx::createUniform("u_vertexDequant", bgfx::UniformType::Vec4, 2);
+	}
+
+	void Renderer::quit()
+	{
+		bgfx::destroy(s_hUVertexDequant);
+		s_hUVertexDequant = BGFX_INVALID_HANDLE;
+
+		delete s_ThreadPool;
+		s_ThreadPool = NULL;
+	}
+
+	void Renderer::submit(const std::vector<Object3D*>& objects)
+	{
+		const u32 numObjects = (u32)objects.size();
+
+		s_ThreadPool->parallelFor(numObjects, numChunks(numObjects), [&objects](u32 chunk, u32 begin, u32 end)
+		{
+			// Chunk 0 runs on the API thread and records into encoder 0.
+			bgfx::Encoder* encoder = bgfx::begin(0 != chunk);
+			BX_ASSERT(NULL != encoder, "Renderer: out of bgfx encoders.");
+
+			for (u32 ii = begin; ii < end; ++ii)
+			{
+				objects[ii]->render(encoder);
+			}
+
+			bgfx::end(encoder);
+		});
+	}
+
+	void Renderer::submit(RenderQueue& queue)
+	{
+		if (s_AutoInstancing)
+		{
+			queue.batch();
+		}
+		queue.sort();
+
+		// Packet depths are their sorted positions, see RenderQueue. Views come
+		// in runs, the key starts with them.
+		for (u32 ii = 0; ii < queue.size(); ++ii)
+		{
+			if (0 == ii || queue[ii].view != queue[ii - 1].view)
+				bgfx::setViewMode(queue[ii].view, bgfx::ViewMode::DepthAscending);
+		}
+
+		const bool prepass = depthPrepass();
+
+		// Contiguous chunks keep each encoder's run of packets in key order.
+		s_ThreadPool->parallelFor(queue.size(), numChunks(queue.size()), [&queue, prepass](u32 chunk, u32 begin, u32 end)
+		{
+			bgfx::Encoder* encoder = bgfx::begin(0 != chunk);
+			BX_ASSERT(NULL != encoder, "Renderer: out of bgfx encoders.");
+
+			if (prepass)
+			{
+				StateCache depthCache(encoder);
+				depthCache.setDepthOnly(DepthPrepassView, s_hDepthProgram, s_hDepthProgramInstanced);
+
+				for (u32 ii = begin; ii < end; ++ii)
+				{
+					if (!inDepthPrepass(queue[ii]))
+						continue;
+
+					const bool hasNext = ii + 1 < end && inDepthPrepass(queue[ii + 1]);
+					depthCache.submit(queue[ii], hasNext ? &queue[ii + 1] : nullptr);
+				}
+			}
+
+			// Neighbouring packets share most bindings once sorted, carry them over.
+			StateCache stateCache(encoder);
+			if (prepass)
+			{
+				stateCache.setDepthEqual(s_DepthPrepassSceneView);
+			}
+
+			for (u32 ii = begin; ii < end; ++ii)
+			{
+				stateCache.submit(queue[ii], ii + 1 < end ? &queue[ii + 1] : nullptr);
+			}
+
+			bgfx::end(encoder);
+		});
+	}
+
+	void Renderer::setDepthPrepass(bool enabled, bgfx::ViewId sceneView)
+	{
+		s_DepthPrepass = enabled;
+		s_DepthPrepassSceneView = sceneView;
+	}
+
+	void Renderer::setDepthPrograms(bgfx::ProgramHandle program, bgfx::ProgramHandle instancedProgram)
+	{
+		s_hDepthProgram = program;
+		s_hDepthProgramInstanced = instancedProgram;
+	}
+
+	bool Renderer::inDepthPrepass(const DrawPacket& packet)
+	{
+		return s_DepthPrepassSceneView == packet.view && StateCache::writesDepth(packet);
+	}
+
+	u32 Renderer::numChunks(u32 count)
+	{
+		return (count + MinObjectsPerChunk - 1) / MinObjectsPerChunk;
+	}
+}
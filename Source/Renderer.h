@@ -0,0 +1,69 @@
+#pragma once
+
+
+#include <vector>
+
+#include <bgfx/bgfx.h>
+
+#include <Object3D.h>
+#include <RenderQueue.h>
+#include <ThreadPool.h>
+#include <Types.h>
+
+
+namespace zv
+{
+	class Renderer
+	{
+	private:
+		Renderer() = default;
+
+	public:
+		// Must be called after bgfx::init. numWorkers == 0 picks one worker per
+		// spare hardware thread, capped by the number of bgfx encoders.
+		static void init(u32 numWorkers = 0);
+		static void quit();
+
+		// Submits all objects, split across the worker threads. Each chunk records
+		// into its own bgfx::Encoder. Must be called from the API thread.
+		static void submit(const std::vector<Object3D*>& objects);
+
+		// Sorts the queue and submits it in key order, split the same way. Switches
+		// the queue's views to DepthAscending, which keeps that order in bgfx.
+		static void submit(RenderQueue& queue);
+
+		// Merge identical draws into instanced ones before sorting.
+		static void setAutoInstancing(bool enabled) { s_AutoInstancing = enabled; }
+		static bool autoInstancing() { return s_AutoInstancing; }
+
+		// Depth prepass for queued draws in sceneView. Opaque draws are first rendered
+		// depth only into DepthPrepassView, which runs ahead of all other views, and
+		// then shaded with an EQUAL depth test. The prepass view clears depth and
+		// needs sceneView's transform and rect, sceneView must not clear depth.
+		static void setDepthPrepass(bool enabled, bgfx::ViewId sceneView = 0);
+		static bool depthPrepass() { return s_DepthPrepass && bgfx::isValid(s_hDepthProgram) && bgfx::isValid(s_hDepthProgramInstanced); }
+		static void setDepthPrograms(bgfx::ProgramHandle program, bgfx::ProgramHandle instancedProgram);
+
+		static constexpr bgfx::ViewId DepthPrepassView = 254;
+
+		// u_vertexDequant, set from Geometry::dequant() for every draw.
+		static bgfx::UniformHandle vertexDequantUniform() { return s_hUVertexDequant; }
+
+	private:
+		static bool inDepthPrepass(const DrawPacket& packet);
+		static u32 numChunks(u32 count);
+
+		// Below this many objects per chunk a worker costs more than it saves.
+		static constexpr u32 MinObjectsPerChunk = 256;
+
+		static ThreadPool* s_ThreadPool;
+		static bool s_AutoInstancing;
+
+		static bool s_DepthPrepass;
+		static bgfx::ViewId s_DepthPrepassSceneView;
+		static bgfx::ProgramHandle s_hDepthProgram;
+		static bgfx::ProgramHandle s_hDepthProgramInstanced;
+
+		static bgfx::UniformHandle s_hUVertexDequant;
+	};
+}
@@ -0,0 +1,171 @@
+#include <ResourceCache.h>
+
+
+#include <Archive.h>
+#include <ShaderReloader.h>
+#include <TextureResidency.h>
+#include <TextureStreamer.h>
+
+
+namespace zv
+{
+	std::unordered_map<u64, ResourceCache::Entry> ResourceCache::s_Entries;
+	ResourceCacheStats ResourceCache::s_Stats;
+
+
+	namespace
+	{
+		// Folds a value into an FNV-1a hash, continuing Archive::hashPath.
+		u64 hashCombine(u64 _hash, u64 _value)
+		{
+			for (u32 ii = 0; ii < 8; ++ii)
+			{
+				_hash ^= (_value >> (ii * 8)) & 0xff;
+				_hash *= UINT64_C(0x100000001b3);
+			}
+			return _hash;
+		}
+	}
+
+
+	u64 ResourceCache::textureKey(const char* _filePath, u64 _flags, u8 _skip)
+	{
+		return hashCombine(hashCombine(Archive::hashPath(_filePath), _flags), _skip);
+	}
+
+	u64 ResourceCache::programKey(const char* _vsPath, const char* _fsPath)
+	{
+		// Tagged so a program never collides with a texture of the same path.
+		const u64 fsHash = NULL != _fsPath ? Archive::hashPath(_fsPath) : 0;
+		return hashCombine(hashCombine(Archive::hashPath(_vsPath), fsHash), UINT64_C(0x70726f6772616d));
+	}
+
+	u64 ResourceCache::permutationKey(const char* _vsName, const char* _fsName, u64 _permutation)
+	{
+		return hashCombine(hashCombine(Archive::hashPath(_vsName), Archive::hashPath(_fsName)), _permutation);
+	}
+
+	TextureRef ResourceCache::findTexture(u64 _key, bgfx::TextureInfo* _info, bimg::Orientation::Enum* _orientation)
+	{
+		auto it = s_Entries.find(_key);
+		if (s_Entries.end() == it || !it->second.isTexture)
+			return TextureRef();
+
+		Entry& entry = it->second;
+		++entry.refs;
+
+		if (NULL != _info)
+		{
+			*_info = entry.info;
+		}
+		if (NULL != _orientation)
+		{
+			*_orientation = entry.orientation;
+		}
+
+		return TextureRef(_key, bgfx::TextureHandle{ entry.idx });
+	}
+
+	ProgramRef ResourceCache::findProgram(u64 _key)
+	{
+		auto it = s_Entries.find(_key);
+		if (s_Entries.end() == it || it->second.isTexture)
+			return ProgramRef();
+
+		++it->second.refs;
+		return ProgramRef(_key, bgfx::ProgramHandle{ it->second.idx });
+	}
+
+	TextureRef ResourceCache::insert(u64 _key, const char* _name, bgfx::TextureHandle _handle, const bgfx::TextureInfo& _info, bimg::Orientation::Enum _orientation)
+	{
+		if (!bgfx::isValid(_handle))
+			return TextureRef();
+
+		if (0 != s_Entries.count(_key))
+		{
+			destroyTexture(_handle);
+			return findTexture(_key);
+		}
+
+		s_Entries[_key] = Entry{ true, _handle.idx, 1, _info.storageSize, _name, _info, _orientation };
+
+		++s_Stats.numTextures;
+		s_Stats.textureBytes += _info.storageSize;
+
+		return TextureRef(_key, _handle);
+	}
+
+	ProgramRef ResourceCache::insert(u64 _key, const char* _name, bgfx::ProgramHandle _handle, u32 _bytes)
+	{
+		if (!bgfx::isValid(_handle))
+			return ProgramRef();
+
+		if (0 != s_Entries.count(_key))
+		{
+			destroyProgram(_handle);
+			return findProgram(_key);
+		}
+
+		s_Entries[_key] = Entry{ false, _handle.idx, 1, _bytes, _name, bgfx::TextureInfo{}, bimg::Orientation::R0 };
+
+		++s_Stats.numPrograms;
+		s_Stats.programBytes += _bytes;
+
+		return ProgramRef(_key, _handle);
+	}
+
+	void ResourceCache::recordLookup(bool _hit)
+	{
+		if (_hit)
+		{
+			++s_Stats.hits;
+		}
+		else
+		{
+			++s_Stats.misses;
+		}
+	}
+
+	void ResourceCache::addRef(u64 _key)
+	{
+		++s_Entries.at(_key).refs;
+	}
+
+	void ResourceCache::release(u64 _key)
+	{
+		auto it = s_Entries.find(_key);
+		BX_ASSERT(s_Entries.end() != it, "Released a resource that isn't cached.");
+
+		Entry& entry = it->second;
+		if (0 != --entry.refs)
+			return;
+
+		if (entry.isTexture)
+		{
+			destroyTexture(bgfx::TextureHandle{ entry.idx });
+			--s_Stats.numTextures;
+			s_Stats.textureBytes -= entry.bytes;
+		}
+		else
+		{
+			destroyProgram(bgfx::ProgramHandle{ entry.idx });
+			--s_Stats.numPrograms;
+			s_Stats.programBytes -= entry.bytes;
+		}
+
+		s_Entries.erase(it);
+	}
+
+	void ResourceCache::destroyTexture(bgfx::TextureHandle _handle)
+	{
+		TextureStreamer::remove(_handle);
+		TextureResidency::remove(_handle);
+		bgfx::destroy(_handle);
+	}
+
+	void ResourceCache::destroyProgram(bgfx::ProgramHandle _handle)
+	{
+		ShaderReloader::remove(_handle);
+		bgfx::destroy(_handle);
+	}
+}
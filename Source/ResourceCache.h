@@ -0,0 +1,149 @@
+#pragma once
+
+
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include <bgfx/bgfx.h>
+#include <bimg/bimg.h>
+
+#include <Types.h>
+
+
+namespace zv
+{
+	template <typename HandleT>
+	class ResourceRef;
+
+	using TextureRef = ResourceRef<bgfx::TextureHandle>;
+	using ProgramRef = ResourceRef<bgfx::ProgramHandle>;
+
+	struct ResourceCacheStats
+	{
+		u32 hits{ 0 };
+		u32 misses{ 0 };
+
+		u32 numTextures{ 0 };
+		u32 numPrograms{ 0 };
+		u64 textureBytes{ 0 };
+		u64 programBytes{ 0 };
+
+		f32 hitRate() const { return 0 == hits + misses ? 0.0f : f32(hits) / f32(hits + misses); }
+	};
+
+	/*
+	Interns bgfx textures and programs by normalized path and load flags, so a
+	file loaded twice is read, decoded and uploaded once. Entries are counted
+	by ResourceRef and destroyed with their last reference. API thread only.
+	*/
+	class ResourceCache
+	{
+	private:
+		ResourceCache() = default;
+
+	public:
+		static u64 textureKey(const char* _filePath, u64 _flags, u8 _skip);
+		static u64 programKey(const char* _vsPath, const char* _fsPath);
+		static u64 permutationKey(const char* _vsName, const char* _fsName, u64 _permutation);
+
+		// A new reference when _key is cached, an invalid one otherwise.
+		static TextureRef findTexture(u64 _key, bgfx::TextureInfo* _info = NULL, bimg::Orientation::Enum* _orientation = NULL);
+		static ProgramRef findProgram(u64 _key);
+
+		// Takes ownership of a freshly created handle and returns its first reference.
+		// When _key got cached meanwhile, by a load that finished first, _handle is
+		// destroyed and a reference to the cached one returned instead.
+		static TextureRef insert(u64 _key, const char* _name, bgfx::TextureHandle _handle, const bgfx::TextureInfo& _info, bimg::Orientation::Enum _orientation);
+		static ProgramRef insert(u64 _key, const char* _name, bgfx::ProgramHandle _handle, u32 _bytes);
+
+		// One per load request, joining a load that's still in flight counts as a hit.
+		static void recordLookup(bool _hit);
+
+		static const ResourceCacheStats& stats() { return s_Stats; }
+
+	private:
+		template <typename HandleT>
+		friend class ResourceRef;
+
+		static void addRef(u64 _key);
+		static void release(u64 _key);
+
+		// Along with whatever the streamer and the residency budget keep behind it.
+		static void destroyTexture(bgfx::TextureHandle _handle);
+		// Along with the versions the shader reloader swapped in.
+		static void destroyProgram(bgfx::ProgramHandle _handle);
+
+	private:
+		struct Entry
+		{
+			bool isTexture;
+			u16 idx;
+			u32 refs;
+			u32 bytes;
+			std::string name;
+
+			bgfx::TextureInfo info;
+			bimg::Orientation::Enum orientation;
+		};
+
+		static std::unordered_map<u64, Entry> s_Entries;
+		static ResourceCacheStats s_Stats;
+	};
+
+	// Counted reference to a cached texture or program, copies share the resource.
+	template <typename HandleT>
+	class ResourceRef
+	{
+	public:
+		ResourceRef() = default;
+		~ResourceRef() { reset(); }
+
+		ResourceRef(const ResourceRef& _other)
+			: m_key(_other.m_key)
+			, m_handle(_other.m_handle)
+		{
+			if (isValid())
+			{
+				ResourceCache::addRef(m_key);
+			}
+		}
+
+		ResourceRef(ResourceRef&& _other) noexcept
+			: m_key(_other.m_key)
+			, m_handle(_other.m_handle)
+		{
+			_other.m_handle = BGFX_INVALID_HANDLE;
+		}
+
+		ResourceRef& operator=(ResourceRef _other)
+		{
+			std::swap(m_key, _other.m_key);
+			std::swap(m_handle, _other.m_handle);
+			return *this;
+		}
+
+	public:
+		void reset()
+		{
+			if (isValid())
+			{
+				ResourceCache::release(m_key);
+			}
+			m_handle = BGFX_INVALID_HANDLE;
+		}
+
+		bool isValid() const { return bgfx::isValid(m_handle); }
+		HandleT handle() const { return m_handle; }
+
+	private:
+		friend class ResourceCache;
+
+		// Adopts a reference that was already counted.
+		ResourceRef(u64 _key, HandleT _handle) : m_key(_key), m_handle(_handle) {}
+
+	private:
+		u64 m_key{ 0 };
+		HandleT m_handle = BGFX_INVALID_HANDLE;
+	};
+}
@@ -0,0 +1,91 @@
+#include <ShaderPermutation.h>
+
+
+#include <cctype>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+
+
+namespace zv
+{
+	namespace
+	{
+		struct Switch
+		{
+			const char* define;
+			u32 shift;
+			u64 mask;
+		};
+
+		// Hex digits of the key in a variant's name.
+		constexpr u32 KeyDigits = 16;
+
+		const Switch s_Switches[] = {
+			{ "ZV_NORMAL_MAP", 1, ShaderPermutation::NormalMap },
+			{ "ZV_NUM_LIGHTS", ShaderPermutation::NumLightsShift, ShaderPermutation::NumLightsMask },
+		};
+	}
+
+
+	std::string ShaderPermutation::vertexName(const char* _vsName, u64 _key)
+	{
+		return 0 != (_key & Instanced) ? std::string(_vsName) + "i" : std::string(_vsName);
+	}
+
+	std::string ShaderPermutation::fragmentName(const char* _fsName, u64 _key)
+	{
+		return name(_fsName, _key & FragmentMask);
+	}
+
+	std::string ShaderPermutation::name(const char* _baseName, u64 _key)
+	{
+		if (0 == _key)
+			return _baseName;
+
+		char suffix[20];
+		snprintf(suffix, sizeof(suffix), "-%0*" PRIx64, int(KeyDigits), (uint64_t)_key);
+		return std::string(_baseName) + suffix;
+	}
+
+	void ShaderPermutation::parse(const std::string& _name, std::string& _baseName, u64& _key)
+	{
+		_baseName = _name;
+		_key = 0;
+
+		// Only a suffix of exactly KeyDigits, any shorter one belongs to the name.
+		if (_name.size() <= KeyDigits + 1)
+			return;
+
+		const size_t dash = _name.size() - KeyDigits - 1;
+		if ('-' != _name[dash])
+			return;
+
+		for (size_t ii = dash + 1; ii < _name.size(); ++ii)
+		{
+			if (!isxdigit((unsigned char)_name[ii]))
+				return;
+		}
+
+		const u64 key = std::strtoull(_name.c_str() + dash + 1, NULL, 16);
+
+		_baseName = _name.substr(0, dash);
+		_key = key;
+	}
+
+	std::string ShaderPermutation::defines(u64 _key)
+	{
+		std::string defines;
+		for (const Switch& sw : s_Switches)
+		{
+			const u64 value = (_key & sw.mask) >> sw.shift;
+			if (0 == value)
+				continue;
+
+			if (!defines.empty())
+				defines += ";";
+			defines += std::string(sw.define) + "=" + std::to_string(value);
+		}
+		return defines;
+	}
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+
+#include <string>
+
+#include <Types.h>
+
+
+namespace zv
+{
+	/*
+	Packs what a program is specialized on into a 64-bit key. The fragment
+	switches become #defines, the asset build compiles every combination a
+	shader lists in its "// permutations:" line into <name>-<hex key>.bin,
+	<name>.bin when the key is 0. The key takes exactly 16 hex digits, so a
+	name like sky-cafe is never mistaken for a variant. Shaders test the defines at compile time,
+	an undefined one reads as 0.
+
+	Instancing adds vertex inputs, which shaderc reads before preprocessing,
+	so it picks the *_vi vertex shader instead of a define.
+
+	A key only selects variants the shaders declare, the layout is mirrored
+	by ZV_SHADER_SWITCHES in cmake/Assets.cmake.
+	*/
+	class ShaderPermutation
+	{
+	private:
+		ShaderPermutation() = default;
+
+	public:
+		static constexpr u64 Instanced = u64(1) << 0;
+		static constexpr u64 NormalMap = u64(1) << 1;        // ZV_NORMAL_MAP
+
+		static constexpr u32 NumLightsShift = 8;             // ZV_NUM_LIGHTS, 0 to 7
+		static constexpr u64 NumLightsMask = u64(7) << NumLightsShift;
+
+		static constexpr u64 FragmentMask = NormalMap | NumLightsMask;
+
+		static u64 numLights(u32 _count) { return (u64(_count) << NumLightsShift) & NumLightsMask; }
+
+		// Shader names of the _key variant of a program.
+		static std::string vertexName(const char* _vsName, u64 _key);
+		static std::string fragmentName(const char* _fsName, u64 _key);
+
+		// test_f with key 0x402 is test_f-0000000000000402, parse() splits it again.
+		static std::string name(const char* _baseName, u64 _key);
+		static void parse(const std::string& _name, std::string& _baseName, u64& _key);
+
+		// For shaderc's --define, the switches set in _key.
+		static std::string defines(u64 _key);
+	};
+}
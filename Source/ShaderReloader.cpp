@@ -0,0 +1,591 @@
+#include <ShaderReloader.h>
+
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+
+#include <bx/bx.h>
+#include <bx/debug.h>
+
+#if BX_PLATFORM_LINUX
+#	include <poll.h>
+#	include <sys/inotify.h>
+#	include <unistd.h>
+#elif BX_PLATFORM_WINDOWS
+#	define popen _popen
+#	define pclose _pclose
+#endif // BX_PLATFORM_LINUX
+
+#include <Loading.h>
+#include <ShaderPermutation.h>
+
+
+namespace zv
+{
+	bool ShaderReloader::s_Enabled = false;
+
+	std::string ShaderReloader::s_SourceDir;
+	std::string ShaderReloader::s_ShadercPath;
+	std::string ShaderReloader::s_OutputDir;
+	const char* ShaderReloader::s_Platform = NULL;
+	const char* ShaderReloader::s_Profile = NULL;
+
+	std::thread ShaderReloader::s_Thread;
+	std::atomic<bool> ShaderReloader::s_Quit{ false };
+	std::atomic<u32> ShaderReloader::s_NumCompiling{ 0 };
+
+	std::deque<ShaderReloader::Result> ShaderReloader::s_Results;
+	std::mutex ShaderReloader::s_ResultsMutex;
+	std::vector<std::string> ShaderReloader::s_Variants;
+	std::mutex ShaderReloader::s_VariantsMutex;
+	std::unordered_map<std::string, std::vector<u8>> ShaderReloader::s_Binaries;
+
+	std::unique_ptr<ShaderReloader::Program[]> ShaderReloader::s_Programs;
+	std::vector<u16> ShaderReloader::s_Tracked;
+	ShaderReloaderStats ShaderReloader::s_Stats;
+
+
+	bool ShaderReloader::init(const char* _sourceDir, const char* _shadercPath)
+	{
+		std::error_code ec;
+		if (NULL == _sourceDir || NULL == _shadercPath || !std::filesystem::is_directory(_sourceDir, ec))
+			return false;
+
+		// The profiles the asset build compiles for, see cmake/Assets.cmake.
+		switch (bgfx::getRendererType())
+		{
+		case bgfx::RendererType::Direct3D11:
+		case bgfx::RendererType::Direct3D12: s_Profile = "s_5_0";  break;
+		case bgfx::RendererType::Metal:      s_Profile = "metal";  break;
+		case bgfx::RendererType::OpenGL:     s_Profile = "120";    break;
+		case bgfx::RendererType::OpenGLES:   s_Profile = "300_es"; break;
+		case bgfx::RendererType::Vulkan:     s_Profile = "spirv";  break;
+		default:
+			return false;
+		}
+
+#if BX_PLATFORM_WINDOWS
+		s_Platform = "windows";
+#elif BX_PLATFORM_OSX
+		s_Platform = "osx";
+#else
+		s_Platform = "linux";
+#endif // BX_PLATFORM_WINDOWS
+
+		s_SourceDir = _sourceDir;
+		s_ShadercPath = _shadercPath;
+		s_OutputDir = LoadingManager::shaderDir();
+		std::filesystem::create_directories(s_OutputDir, ec);
+
+		s_Programs = std::make_unique<Program[]>(bgfx::getCaps()->limits.maxPrograms);
+
+		s_Quit = false;
+		s_Enabled = true;
+		s_Thread = std::thread(watch);
+
+		return true;
+	}
+
+	void ShaderReloader::quit()
+	{
+		if (!s_Enabled)
+			return;
+
+		s_Quit = true;
+		s_Thread.join();
+
+		for (u16 idx : s_Tracked)
+		{
+			const bgfx::ProgramHandle current = s_Programs[idx].current;
+			if (current.idx != idx)
+			{
+				bgfx::destroy(current);
+			}
+		}
+		s_Tracked.clear();
+		s_Programs.reset();
+
+		s_Results.clear();
+		s_Variants.clear();
+		s_Binaries.clear();
+		s_Stats = ShaderReloaderStats{};
+		s_Enabled = false;
+	}
+
+	void ShaderReloader::track(bgfx::ProgramHandle _handle, const char* _vsPath, const char* _fsPath)
+	{
+		if (!s_Enabled || !bgfx::isValid(_handle))
+			return;
+
+		// Another reference to a cached program.
+		Program& program = s_Programs[_handle.idx];
+		if (program.tracked)
+			return;
+
+		program.tracked = true;
+		program.vsPath = _vsPath;
+		program.vsName = std::filesystem::path(program.vsPath).stem().string();
+		if (NULL != _fsPath && '\0' != _fsPath[0])
+		{
+			program.fsPath = _fsPath;
+			program.fsName = std::filesystem::path(program.fsPath).stem().string();
+		}
+		program.current = _handle;
+
+		{
+			std::lock_guard<std::mutex> lock(s_VariantsMutex);
+			for (const std::string* name : { &program.vsName, &program.fsName })
+			{
+				if (!name->empty() && s_Variants.end() == std::find(s_Variants.begin(), s_Variants.end(), *name))
+				{
+					s_Variants.push_back(*name);
+				}
+			}
+		}
+
+		s_Tracked.push_back(_handle.idx);
+		++s_Stats.numPrograms;
+	}
+
+	void ShaderReloader::remove(bgfx::ProgramHandle _handle)
+	{
+		if (!s_Enabled || !bgfx::isValid(_handle))
+			return;
+
+		Program& program = s_Programs[_handle.idx];
+		if (!program.tracked)
+			return;
+
+		if (program.current.idx != _handle.idx)
+		{
+			bgfx::destroy(program.current);
+		}
+		program = Program{};
+
+		s_Tracked.erase(std::find(s_Tracked.begin(), s_Tracked.end(), _handle.idx));
+		--s_Stats.numPrograms;
+	}
+
+	bgfx::ProgramHandle ShaderReloader::resolve(bgfx::ProgramHandle _handle)
+	{
+		if (!s_Enabled || !bgfx::isValid(_handle))
+			return _handle;
+
+		const Program& program = s_Programs[_handle.idx];
+		return program.tracked ? program.current : _handle;
+	}
+
+	void ShaderReloader::update()
+	{
+		if (!s_Enabled)
+			return;
+
+		s_Stats.numCompiling = s_NumCompiling.load();
+
+		std::deque<Result> results;
+		{
+			std::lock_guard<std::mutex> lock(s_ResultsMutex);
+			results.swap(s_Results);
+		}
+		if (results.empty())
+			return;
+
+		std::vector<std::string> compiled;
+		for (Result& result : results)
+		{
+			if (result.binary.empty())
+			{
+				bx::debugPrintf("%s\n", result.log.c_str());
+				++s_Stats.numFailures;
+				s_Stats.lastError = std::move(result.log);
+				continue;
+			}
+
+			s_Binaries[result.name] = std::move(result.binary);
+			compiled.push_back(result.name);
+		}
+
+		// Relinked once per update, even when both of its shaders changed.
+		for (u16 idx : s_Tracked)
+		{
+			const Program& program = s_Programs[idx];
+			const bool changed = compiled.end() != std::find(compiled.begin(), compiled.end(), program.vsName)
+				|| compiled.end() != std::find(compiled.begin(), compiled.end(), program.fsName);
+			if (!changed)
+				continue;
+
+			if (swap(idx))
+			{
+				++s_Stats.numReloads;
+			}
+			else
+			{
+				++s_Stats.numFailures;
+				s_Stats.lastError = "Failed to link " + program.vsName + " with " + program.fsName + ", kept the old program.";
+				bx::debugPrintf("%s\n", s_Stats.lastError.c_str());
+			}
+		}
+	}
+
+	void ShaderReloader::watch()
+	{
+		namespace fs = std::filesystem;
+
+		auto isShaderFile = [](const fs::path& _path)
+		{
+			return ".sc" == _path.extension() || ".sh" == _path.extension();
+		};
+
+#if BX_PLATFORM_LINUX
+		// Not recursive, every shader set directory gets a watch of its own.
+		const int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		if (0 > fd)
+		{
+			bx::debugPrintf("Shader reloading is off, inotify is unavailable.\n");
+			return;
+		}
+
+		std::unordered_map<int, fs::path> dirs;
+		auto addWatch = [fd, &dirs](const fs::path& _dir)
+		{
+			const int wd = inotify_add_watch(fd, _dir.string().c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+			if (0 <= wd)
+			{
+				dirs[wd] = _dir;
+			}
+		};
+
+		std::error_code ec;
+		addWatch(s_SourceDir);
+		for (const fs::directory_entry& entry : fs::directory_iterator(s_SourceDir, ec))
+		{
+			if (entry.is_directory(ec))
+			{
+				addWatch(entry.path());
+			}
+		}
+#else
+		std::unordered_map<std::string, fs::file_time_type> writeTimes;
+		auto pollWriteTimes = [&writeTimes, &isShaderFile](std::vector<std::string>& _changed)
+		{
+			std::error_code ec;
+			for (const fs::directory_entry& entry : fs::recursive_directory_iterator(s_SourceDir, ec))
+			{
+				if (!entry.is_regular_file(ec) || !isShaderFile(entry.path()))
+					continue;
+
+				const fs::file_time_type writeTime = entry.last_write_time(ec);
+				auto it = writeTimes.find(entry.path().string());
+				if (writeTimes.end() == it)
+				{
+					writeTimes.emplace(entry.path().string(), writeTime);
+				}
+				else if (it->second != writeTime)
+				{
+					it->second = writeTime;
+					_changed.push_back(entry.path().string());
+				}
+			}
+		};
+
+		std::vector<std::string> ignored;
+		pollWriteTimes(ignored);
+#endif // BX_PLATFORM_LINUX
+
+		std::vector<std::string> changed;
+		while (!s_Quit)
+		{
+			const size_t numChanged = changed.size();
+
+#if BX_PLATFORM_LINUX
+			pollfd pfd = { fd, POLLIN, 0 };
+			if (0 < ::poll(&pfd, 1, 100))
+			{
+				alignas(inotify_event) char buffer[4096];
+				ssize_t size;
+				while (0 < (size = read(fd, buffer, sizeof(buffer))))
+				{
+					for (const char* ptr = buffer; ptr < buffer + size; ptr += sizeof(inotify_event) + ((const inotify_event*)ptr)->len)
+					{
+						const inotify_event* event = (const inotify_event*)ptr;
+						auto dir = dirs.find(event->wd);
+						if (dirs.end() == dir || 0 == event->len)
+							continue;
+
+						const fs::path path = dir->second / event->name;
+						if (0 != (event->mask & IN_ISDIR))
+						{
+							addWatch(path);
+						}
+						else if (0 != (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) && isShaderFile(path))
+						{
+							changed.push_back(path.string());
+						}
+					}
+				}
+			}
+#else
+			std::this_thread::sleep_for(std::chrono::milliseconds(250));
+			pollWriteTimes(changed);
+#endif // BX_PLATFORM_LINUX
+
+			// Editors save in several writes, compile once they went quiet.
+			if (!changed.empty() && numChanged == changed.size())
+			{
+				compile(changed);
+				changed.clear();
+			}
+		}
+
+#if BX_PLATFORM_LINUX
+		close(fd);
+#endif // BX_PLATFORM_LINUX
+	}
+
+	std::vector<ShaderReloader::Source> ShaderReloader::scan()
+	{
+		namespace fs = std::filesystem;
+
+		std::vector<Source> sources;
+		std::error_code ec;
+		for (const fs::directory_entry& dir : fs::directory_iterator(s_SourceDir, ec))
+		{
+			const fs::path varyingDef = dir.path() / "varying.def.sc";
+			if (!dir.is_directory(ec) || !fs::exists(varyingDef, ec))
+				continue;
+
+			for (const fs::directory_entry& file : fs::directory_iterator(dir.path(), ec))
+			{
+				const fs::path& path = file.path();
+				if (".sc" != path.extension() || "varying.def.sc" == path.filename())
+					continue;
+
+				Source source;
+				source.name = path.stem().string();
+				source.path = path.lexically_normal().string();
+				source.dir = dir.path().lexically_normal().string();
+				source.varyingDef = varyingDef.lexically_normal().string();
+
+				// Named like the asset build expects, *_f fragment, *_c compute, the rest vertex.
+				const size_t length = source.name.size();
+				const char suffix = 2 <= length && '_' == source.name[length - 2] ? source.name[length - 1] : '\0';
+				source.type = 'f' == suffix ? eShaderType::Fragment : 'c' == suffix ? eShaderType::Compute : eShaderType::Vertex;
+
+				sources.push_back(std::move(source));
+			}
+		}
+
+		return sources;
+	}
+
+	void ShaderReloader::compile(const std::vector<std::string>& _changed)
+	{
+		namespace fs = std::filesystem;
+
+		// Scanned anew, shaders may have been added since the last change.
+		const std::vector<Source> sources = scan();
+
+		std::vector<const Source*> dirty;
+		for (const Source& source : sources)
+		{
+			for (const std::string& changed : _changed)
+			{
+				const fs::path path = fs::path(changed).lexically_normal();
+				const bool header = ".sh" == path.extension();
+				const bool varyings = "varying.def.sc" == path.filename() && path.parent_path().string() == source.dir;
+				if (header || varyings || path.string() == source.path)
+				{
+					dirty.push_back(&source);
+					break;
+				}
+			}
+		}
+
+		// Every permutation in use of a dirty source, the plain one when none is.
+		std::vector<std::pair<const Source*, u64>> jobs;
+		{
+			std::lock_guard<std::mutex> lock(s_VariantsMutex);
+			for (const Source* source : dirty)
+			{
+				const size_t numJobs = jobs.size();
+				for (const std::string& variant : s_Variants)
+				{
+					std::string baseName;
+					u64 permutation;
+					ShaderPermutation::parse(variant, baseName, permutation);
+					if (baseName == source->name)
+					{
+						jobs.emplace_back(source, permutation);
+					}
+				}
+
+				if (numJobs == jobs.size())
+				{
+					jobs.emplace_back(source, 0);
+				}
+			}
+		}
+
+		s_NumCompiling += u32(jobs.size());
+		for (const auto& job : jobs)
+		{
+			Result result;
+			compile(*job.first, job.second, result);
+
+			{
+				std::lock_guard<std::mutex> lock(s_ResultsMutex);
+				s_Results.emplace_back(std::move(result));
+			}
+			--s_NumCompiling;
+		}
+	}
+
+	bool ShaderReloader::compile(const Source& _source, u64 _permutation, Result& _result)
+	{
+		namespace fs = std::filesystem;
+
+		static const char* s_TypeNames[] = { "vertex", "fragment", "compute" };
+
+		_result.name = ShaderPermutation::name(_source.name.c_str(), _permutation);
+
+		// Written next to the binary first, a failed compile leaves the last good one alone.
+		const std::string output = s_OutputDir + _result.name + ".bin";
+		const std::string temp = output + ".tmp";
+
+		std::string command = "\"" + s_ShadercPath + "\""
+			+ " -f \"" + _source.path + "\""
+			+ " -o \"" + temp + "\""
+			+ " --type " + s_TypeNames[u32(_source.type)]
+			+ " --platform " + s_Platform
+			+ " -p " + s_Profile
+			+ " --varyingdef \"" + _source.varyingDef + "\""
+			+ " -i \"" + _source.dir + "\""
+			+ " -i \"" + s_SourceDir + "\""
+			+ " -O 3";
+		const std::string defines = ShaderPermutation::defines(_permutation);
+		if (!defines.empty())
+		{
+			command += " --define \"" + defines + "\"";
+		}
+		command += " 2>&1";
+#if BX_PLATFORM_WINDOWS
+		// cmd.exe strips the outer quotes of the whole line.
+		command = "\"" + command + "\"";
+#endif // BX_PLATFORM_WINDOWS
+
+		FILE* pipe = popen(command.c_str(), "r");
+		if (NULL == pipe)
+		{
+			_result.log = "Failed to run " + s_ShadercPath;
+			return false;
+		}
+
+		char line[256];
+		while (NULL != fgets(line, sizeof(line), pipe))
+		{
+			_result.log += line;
+		}
+
+		std::error_code ec;
+		if (0 != pclose(pipe))
+		{
+			fs::remove(temp, ec);
+			if (_result.log.empty())
+			{
+				_result.log = "Failed to compile " + _source.path;
+			}
+			return false;
+		}
+
+		std::ifstream file(temp, std::ios::binary);
+		_result.binary.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+		file.close();
+
+		if (_result.binary.empty())
+		{
+			fs::remove(temp, ec);
+			_result.log = "shaderc wrote nothing for " + _source.path;
+			return false;
+		}
+
+		// Replaces the file rather than writing into it, a mapping of the old one stays intact.
+		fs::rename(temp, output, ec);
+		if (ec)
+		{
+			fs::remove(temp, ec);
+		}
+
+		return true;
+	}
+
+	bool ShaderReloader::swap(u16 _idx)
+	{
+		Program& program = s_Programs[_idx];
+
+		bgfx::ShaderHandle vsh = createShader(program.vsName, program.vsPath);
+		bgfx::ShaderHandle fsh = BGFX_INVALID_HANDLE;
+		if (!program.fsName.empty())
+		{
+			fsh = createShader(program.fsName, program.fsPath);
+		}
+
+		if (!bgfx::isValid(vsh) || (!program.fsName.empty() && !bgfx::isValid(fsh)))
+		{
+			if (bgfx::isValid(vsh))
+			{
+				bgfx::destroy(vsh);
+			}
+			if (bgfx::isValid(fsh))
+			{
+				bgfx::destroy(fsh);
+			}
+			return false;
+		}
+
+		// Fails when the stages no longer agree on their varyings.
+		bgfx::ProgramHandle handle = bgfx::createProgram(vsh, fsh, true /* destroy shaders when program is destroyed */);
+		if (!bgfx::isValid(handle))
+			return false;
+
+		// bgfx defers the destruction past the frames still submitting it.
+		if (program.current.idx != _idx)
+		{
+			bgfx::destroy(program.current);
+		}
+		program.current = handle;
+
+		return true;
+	}
+
+	bgfx::ShaderHandle ShaderReloader::createShader(const std::string& _name, const std::string& _path)
+	{
+		const bgfx::Memory* mem = NULL;
+
+		auto binary = s_Binaries.find(_name);
+		if (s_Binaries.end() != binary)
+		{
+			mem = bgfx::copy(binary->second.data(), u32(binary->second.size()));
+		}
+		else
+		{
+			// Unchanged since start, the same binary the program was loaded from.
+			u32 size = 0;
+			void* data = LoadingManager::load(_path.c_str(), &size);
+			if (NULL == data)
+				return BGFX_INVALID_HANDLE;
+
+			mem = bgfx::copy(data, size);
+			LoadingManager::unload(data);
+		}
+
+		bgfx::ShaderHandle handle = bgfx::createShader(mem);
+		if (bgfx::isValid(handle))
+		{
+			bgfx::setName(handle, _name.c_str());
+		}
+		return handle;
+	}
+}
@@ -0,0 +1,142 @@
+#pragma once
+
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <bgfx/bgfx.h>
+
+#include <Types.h>
+
+
+namespace zv
+{
+	struct ShaderReloaderStats
+	{
+		u32 numPrograms{ 0 };
+		u32 numCompiling{ 0 };
+		u32 numReloads{ 0 };   // Programs swapped.
+		u32 numFailures{ 0 };  // Compiles or program links that kept the old program.
+		std::string lastError{};
+	};
+
+	/*
+	Recompiles shaders while the app runs. A background thread watches the
+	shader sources, with inotify on Linux and by polling elsewhere, and runs
+	shaderc on whatever changed for the renderer in use. Editing a .sh header
+	rebuilds every shader, a varying.def.sc the shaders next to it. Of a shader
+	with permutations, the variants programs use are rebuilt.
+
+	update() creates the new programs on the API thread and swaps them in
+	between frames. Materials keep the handle they were given, binding goes
+	through resolve() to the latest program. When a shader fails to compile
+	or link, the old program stays live and the error shows in stats().
+
+	The compiled binaries replace the ones in Assets/Shaders, so the next
+	start picks them up. resolve() may run on the render workers, everything
+	else on the API thread.
+	*/
+	class ShaderReloader
+	{
+	private:
+		ShaderReloader() = default;
+
+	public:
+		// After bgfx::init(), _sourceDir holds one directory per shader set, as the asset build expects.
+		static bool init(const char* _sourceDir, const char* _shadercPath);
+		static void quit();
+
+		static bool isEnabled() { return s_Enabled; }
+
+		// Programs loaded from Assets/Shaders, by the paths of their shader binaries.
+		static void track(bgfx::ProgramHandle _handle, const char* _vsPath, const char* _fsPath);
+		static void remove(bgfx::ProgramHandle _handle);
+
+		// Program to submit in place of _handle.
+		static bgfx::ProgramHandle resolve(bgfx::ProgramHandle _handle);
+
+		// Swaps in the programs whose shaders finished compiling. Once per frame, outside of Renderer::submit().
+		static void update();
+
+		static const ShaderReloaderStats& stats() { return s_Stats; }
+
+	private:
+		enum class eShaderType {
+			Vertex = 0,
+			Fragment = 1,
+			Compute = 2,
+		};
+
+		struct Source
+		{
+			std::string name;        // test_f for Source/Shaders/test/test_f.sc.
+			std::string path;
+			std::string dir;
+			std::string varyingDef;
+			eShaderType type;
+		};
+
+		struct Program
+		{
+			bool tracked{ false };
+			std::string vsName{};
+			std::string fsName{};
+			std::string vsPath{};
+			std::string fsPath{};
+
+			// The tracked handle stays alive as the identity materials hold, later versions replace each other.
+			bgfx::ProgramHandle current = BGFX_INVALID_HANDLE;
+		};
+
+		// A finished compile, handed from the watcher to the API thread.
+		struct Result
+		{
+			std::string name;
+			std::vector<u8> binary;  // Empty when the compile failed.
+			std::string log;
+		};
+
+		static void watch();
+		static std::vector<Source> scan();
+		static void compile(const std::vector<std::string>& _changed);
+		static bool compile(const Source& _source, u64 _permutation, Result& _result);
+
+		// Links the program tracked at _idx anew from the latest binaries of its shaders.
+		static bool swap(u16 _idx);
+		static bgfx::ShaderHandle createShader(const std::string& _name, const std::string& _path);
+
+	private:
+		static bool s_Enabled;
+
+		static std::string s_SourceDir;
+		static std::string s_ShadercPath;
+		static std::string s_OutputDir;
+		static const char* s_Platform;
+		static const char* s_Profile;
+
+		static std::thread s_Thread;
+		static std::atomic<bool> s_Quit;
+		static std::atomic<u32> s_NumCompiling;
+
+		static std::deque<Result> s_Results;
+		static std::mutex s_ResultsMutex;
+
+		// Names of the shader permutations in use, compiled along with their source.
+		static std::vector<std::string> s_Variants;
+		static std::mutex s_VariantsMutex;
+
+		// Compiled since start by shader name, a program relinked later uses them for its other stage.
+		static std::unordered_map<std::string, std::vector<u8>> s_Binaries;
+
+		// By tracked program handle index.
+		static std::unique_ptr<Program[]> s_Programs;
+		static std::vector<u16> s_Tracked;
+		static ShaderReloaderStats s_Stats;
+	};
+}
@@ -0,0 +1,7 @@
+#include <../bgfx_shader.sh>
+
+void main()
+{
+	// Color writes are masked off, only depth is kept.
+	gl_FragColor = vec4(0.0, 0.0, 0.0, 0.0);
+}
@@ -0,0 +1,11 @@
+$input a_position
+
+#include <../bgfx_shader.sh>
+#include <../vertex.sh>
+
+void main()
+{
+	// Same operations as test_v.sc, EQUAL depth testing needs bit identical depth.
+	vec3 wpos = mul(u_model[0], vec4(dequantizePosition(a_position), 1.0) ).xyz;
+	gl_Position = mul(u_viewProj, vec4(wpos, 1.0) );
+}
@@ -0,0 +1,13 @@
+$input a_position, i_data0, i_data1, i_data2, i_data3
+
+#include <../bgfx_shader.sh>
+#include <../vertex.sh>
+
+void main()
+{
+	// Same operations as test_vi.sc, EQUAL depth testing needs bit identical depth.
+	mat4 model = mul(u_model[0], mtxFromCols(i_data0, i_data1, i_data2, i_data3) );
+
+	vec3 wpos = mul(model, vec4(dequantizePosition(a_position), 1.0) ).xyz;
+	gl_Position = mul(u_viewProj, vec4(wpos, 1.0) );
+}
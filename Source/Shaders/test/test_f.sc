@@ -1,10 +1,22 @@
 $input v_wpos, v_view, v_normal, v_tangent, v_bitangent, v_texcoord0// in...
 
+// permutations: ZV_NORMAL_MAP=0,1 ZV_NUM_LIGHTS=1,2,4
+
 #include <../bgfx_shader.sh>
 #include <../shaderlib.sh>
 
+// Specialized per variant, see ShaderPermutation.h.
+#ifndef ZV_NORMAL_MAP
+#	define ZV_NORMAL_MAP 0
+#endif
+#ifndef ZV_NUM_LIGHTS
+#	define ZV_NUM_LIGHTS 0
+#endif
+
 SAMPLER2D(s_texColor,  0);
+#if ZV_NORMAL_MAP
 SAMPLER2D(s_texNormal, 1);
+#endif
 uniform vec4 u_lightPosRadius[4];
 uniform vec4 u_lightRgbInnerR[4];
 
@@ -53,16 +65,20 @@ void main()
 {
 	mat3 tbn = mtxFromCols(v_tangent, v_bitangent, v_normal);
 
+#if ZV_NORMAL_MAP
 	vec3 normal;
 	normal.xy = texture2D(s_texNormal, v_texcoord0).xy * 2.0 - 1.0;
 	normal.z = sqrt(1.0 - dot(normal.xy, normal.xy) );
+#else
+	vec3 normal = vec3(0.0, 0.0, 1.0);
+#endif
 	vec3 view = normalize(v_view);
 
-	vec3 lightColor;
-	lightColor =  calcLight(0, tbn, v_wpos, normal, view);
-	lightColor += calcLight(1, tbn, v_wpos, normal, view);
-	lightColor += calcLight(2, tbn, v_wpos, normal, view);
-	lightColor += calcLight(3, tbn, v_wpos, normal, view);
+	vec3 lightColor = vec3_splat(0.0);
+	for (int ii = 0; ii < ZV_NUM_LIGHTS; ++ii)
+	{
+		lightColor += calcLight(ii, tbn, v_wpos, normal, view);
+	}
 
 	vec4 color = toLinear(texture2D(s_texColor, v_texcoord0) );
 
@@ -1,19 +1,21 @@
-$input a_position, a_normal, a_tangent, a_texcoord0
+$input a_position, a_normal, a_texcoord0
 $output v_wpos, v_view, v_normal, v_tangent, v_bitangent, v_texcoord0
 
 #include <../bgfx_shader.sh>
+#include <../vertex.sh>
 
 void main()
 {
-	vec3 wpos = mul(u_model[0], vec4(a_position, 1.0) ).xyz;
+	vec3 wpos = mul(u_model[0], vec4(dequantizePosition(a_position), 1.0) ).xyz;
 	v_wpos = wpos;
 
 	gl_Position = mul(u_viewProj, vec4(wpos, 1.0) );
 	
-	vec4 normal = a_normal * 2.0 - 1.0;
-	vec4 tangent = a_tangent * 2.0 - 1.0;
+	vec3 normal;
+	vec4 tangent;
+	decodeTangentFrame(a_normal, normal, tangent);
 
-	vec3 wnormal = mul(u_model[0], vec4(normal.xyz, 0.0) ).xyz;
+	vec3 wnormal = mul(u_model[0], vec4(normal, 0.0) ).xyz;
 	vec3 wtangent = mul(u_model[0], vec4(tangent.xyz, 0.0) ).xyz;
 
 	v_normal = normalize(wnormal);
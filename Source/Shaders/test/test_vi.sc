@@ -0,0 +1,35 @@
+$input a_position, a_normal, a_texcoord0, i_data0, i_data1, i_data2, i_data3
+$output v_wpos, v_view, v_normal, v_tangent, v_bitangent, v_texcoord0
+
+#include <../bgfx_shader.sh>
+#include <../vertex.sh>
+
+void main()
+{
+	// Per-instance model matrix, relative to the mesh transform in u_model[0].
+	mat4 model = mul(u_model[0], mtxFromCols(i_data0, i_data1, i_data2, i_data3) );
+
+	vec3 wpos = mul(model, vec4(dequantizePosition(a_position), 1.0) ).xyz;
+	v_wpos = wpos;
+
+	gl_Position = mul(u_viewProj, vec4(wpos, 1.0) );
+	
+	vec3 normal;
+	vec4 tangent;
+	decodeTangentFrame(a_normal, normal, tangent);
+
+	vec3 wnormal = mul(model, vec4(normal, 0.0) ).xyz;
+	vec3 wtangent = mul(model, vec4(tangent.xyz, 0.0) ).xyz;
+
+	v_normal = normalize(wnormal);
+	v_tangent = normalize(wtangent);
+	v_bitangent = cross(v_normal, v_tangent) * tangent.w;
+
+	mat3 tbn = mtxFromCols(v_tangent, v_bitangent, v_normal);
+
+	// eye position in world space
+	vec3 weyepos = mul(vec4(0.0, 0.0, 0.0, 1.0), u_view).xyz;
+	// tangent space view dir
+	v_view = mul(weyepos - wpos, tbn);
+	v_texcoord0 = a_texcoord0;
+}
@@ -7,7 +7,6 @@ vec3 v_bitangent : BINORMAL  = vec3(0.0, 1.0, 0.0);
 
 vec3 a_position  : POSITION;
 vec4 a_normal    : NORMAL;
-vec4 a_tangent   : TANGENT;
 vec2 a_texcoord0 : TEXCOORD0;
 vec4 i_data0     : TEXCOORD7;
 vec4 i_data1     : TEXCOORD6;
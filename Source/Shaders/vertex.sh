@@ -0,0 +1,41 @@
+#ifndef __ZV_VERTEX_SH__
+#define __ZV_VERTEX_SH__
+
+// Vertex inputs as VertexFormat.h encodes them, the same for every position format.
+
+// Stored positions to object space, scale in [0] and offset in [1], see Geometry::dequant().
+uniform vec4 u_vertexDequant[2];
+
+vec3 dequantizePosition(vec3 _position)
+{
+	return _position * u_vertexDequant[0].xyz + u_vertexDequant[1].xyz;
+}
+
+vec3 octDecode(vec2 _oct)
+{
+	vec3 normal = vec3(_oct.xy, 1.0 - abs(_oct.x) - abs(_oct.y) );
+	float fold = max(-normal.z, 0.0);
+	normal.x += normal.x >= 0.0 ? -fold : fold;
+	normal.y += normal.y >= 0.0 ? -fold : fold;
+	return normalize(normal);
+}
+
+// a_normal holds the octahedral normal, the tangent's angle around it and the handedness,
+// encodeTangentFrame() builds it against the same basis.
+void decodeTangentFrame(vec4 _frame, out vec3 _normal, out vec4 _tangent)
+{
+	vec4 frame = _frame * 2.0 - 1.0;
+	_normal = octDecode(frame.xy);
+
+	// Duff et al. 2017, "Building an Orthonormal Basis, Revisited".
+	float flip = _normal.z >= 0.0 ? 1.0 : -1.0;
+	float a = -1.0 / (flip + _normal.z);
+	float b = _normal.x * _normal.y * a;
+	vec3 b1 = vec3(1.0 + flip * _normal.x * _normal.x * a, flip * b, -flip * _normal.x);
+	vec3 b2 = vec3(b, flip + _normal.y * _normal.y * a, -_normal.y);
+
+	float angle = frame.z * 3.14159265;
+	_tangent = vec4(b1 * cos(angle) + b2 * sin(angle), frame.w);
+}
+
+#endif // __ZV_VERTEX_SH__
@@ -0,0 +1,152 @@
+#include <StateCache.h>
+
+
+#include <bx/bx.h>
+
+#include <Renderer.h>
+#include <ShaderReloader.h>
+
+
+namespace zv
+{
+	void StateCache::submit(const DrawPacket& packet, const DrawPacket* next)
+	{
+		if (0 == packet.numInstances)
+		{
+			const u8 keep = NULL != next ? retainable(packet, *next) : BGFX_DISCARD_NONE;
+
+			bindDrawState(packet);
+			bindProgram(packet, false, u8(BGFX_DISCARD_ALL & ~keep));
+
+			m_retained = keep;
+			++m_numDraws;
+			return;
+		}
+
+		// One draw per instance data buffer, as large as this frame's transient memory allows.
+		u32 first = 0;
+		while (first < packet.numInstances)
+		{
+			const u32 numInstances = bgfx::getAvailInstanceDataBuffer(packet.numInstances - first, RenderQueue::InstanceStride);
+			if (0 == numInstances)
+				break;
+
+			bgfx::InstanceDataBuffer idb;
+			bgfx::allocInstanceDataBuffer(&idb, numInstances, RenderQueue::InstanceStride);
+			bx::memCopy(idb.data, packet.instanceData + first * 16, numInstances * RenderQueue::InstanceStride);
+
+			bindDrawState(packet);
+			m_pEncoder->setInstanceDataBuffer(&idb);
+			bindProgram(packet, true, BGFX_DISCARD_ALL);
+
+			m_retained = BGFX_DISCARD_NONE;
+			++m_numDraws;
+
+			first += numInstances;
+		}
+	}
+
+	void StateCache::setDepthOnly(bgfx::ViewId view, bgfx::ProgramHandle program, bgfx::ProgramHandle instancedProgram)
+	{
+		m_depthOnly = true;
+		m_depthView = view;
+		m_hDepthProgram = program;
+		m_hDepthProgramInstanced = instancedProgram;
+	}
+
+	void StateCache::setDepthEqual(bgfx::ViewId view)
+	{
+		m_depthEqual = true;
+		m_depthEqualView = view;
+	}
+
+	bool StateCache::writesDepth(const DrawPacket& packet)
+	{
+		return !packet.material->isTranslucent()
+			&& 0 != (packet.material->renderState() & BGFX_STATE_WRITE_Z);
+	}
+
+	void StateCache::bindDrawState(const DrawPacket& packet)
+	{
+		// Uniforms are not part of the discard state, bgfx records them per draw anyway.
+		if (!m_depthOnly)
+			packet.material->updateUniforms(m_pEncoder);
+		m_pEncoder->setUniform(Renderer::vertexDequantUniform(), &packet.geometry->dequant(), 2);
+
+		if (0 == (m_retained & BGFX_DISCARD_TRANSFORM))
+			m_pEncoder->setTransform(packet.modelMatrix);
+		else
+			++m_numSkippedBindings;
+
+		if (0 == (m_retained & BGFX_DISCARD_VERTEX_STREAMS))
+			packet.geometry->bindBuffers(m_pEncoder, packet.firstIndex, packet.numIndices, m_depthOnly);
+		else
+			++m_numSkippedBindings;
+
+		// The depth only programs sample no textures.
+		if (!m_depthOnly)
+		{
+			if (0 == (m_retained & BGFX_DISCARD_BINDINGS))
+				packet.material->bindTextures(m_pEncoder);
+			else
+				++m_numSkippedBindings;
+		}
+
+		if (0 == (m_retained & BGFX_DISCARD_STATE))
+			m_pEncoder->setState(renderState(packet));
+		else
+			++m_numSkippedBindings;
+	}
+
+	void StateCache::bindProgram(const DrawPacket& packet, bool instanced, u8 discardFlags)
+	{
+		if (m_depthOnly)
+		{
+			m_pEncoder->submit(m_depthView, ShaderReloader::resolve(instanced ? m_hDepthProgramInstanced : m_hDepthProgram), packet.depth, discardFlags);
+			return;
+		}
+
+		packet.material->bindProgram(m_pEncoder, packet.view, packet.depth, instanced, discardFlags);
+	}
+
+	u64 StateCache::renderState(const DrawPacket& packet) const
+	{
+		const u64 state = packet.material->renderState();
+
+		if (m_depthOnly)
+			return (state & (BGFX_STATE_DEPTH_TEST_MASK | BGFX_STATE_CULL_MASK | BGFX_STATE_MSAA)) | BGFX_STATE_WRITE_Z;
+
+		if (m_depthEqual && packet.view == m_depthEqualView && writesDepth(packet))
+			return (state & ~(BGFX_STATE_DEPTH_TEST_MASK | BGFX_STATE_WRITE_Z)) | BGFX_STATE_DEPTH_TEST_EQUAL;
+
+		return state;
+	}
+
+	u8 StateCache::retainable(const DrawPacket& a, const DrawPacket& b) const
+	{
+		// Instanced draws bind their own instance buffer, start them from scratch.
+		if (0 != b.numInstances)
+			return BGFX_DISCARD_NONE;
+
+		u8 keep = BGFX_DISCARD_NONE;
+
+		if (a.modelMatrix == b.modelMatrix || 0 == bx::memCmp(a.modelMatrix, b.modelMatrix, 16 * sizeof(f32)))
+			keep |= BGFX_DISCARD_TRANSFORM;
+
+		if (a.geometry->vertexBuffer().idx == b.geometry->vertexBuffer().idx
+			&& a.geometry->indexBuffer().idx == b.geometry->indexBuffer().idx
+			&& a.firstIndex == b.firstIndex
+			&& a.numIndices == b.numIndices)
+		{
+			keep |= BGFX_DISCARD_VERTEX_STREAMS | BGFX_DISCARD_INDEX_BUFFER;
+		}
+
+		if (m_depthOnly || a.material->sharesTextures(*b.material))
+			keep |= BGFX_DISCARD_BINDINGS;
+
+		if (renderState(a) == renderState(b))
+			keep |= BGFX_DISCARD_STATE;
+
+		return keep;
+	}
+}
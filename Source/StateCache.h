@@ -0,0 +1,66 @@
+#pragma once
+
+
+#include <bgfx/bgfx.h>
+
+#include <RenderQueue.h>
+#include <Types.h>
+
+
+namespace zv
+{
+	/*
+	Submits packets on one encoder and keeps whatever the next packet would
+	bind again. Each submit looks at the following packet and clears only the
+	bindings that change, so a run of draws sharing a transform, buffers,
+	textures or render state binds them once.
+	*/
+	class StateCache
+	{
+	public:
+		explicit StateCache(bgfx::Encoder* encoder) : m_pEncoder(encoder) {}
+		~StateCache() = default;
+
+	public:
+		// next is the packet submitted after this one on the same encoder, if any.
+		void submit(const DrawPacket& packet, const DrawPacket* next = nullptr);
+
+		// Draws every packet into view with a depth only program instead of its material.
+		void setDepthOnly(bgfx::ViewId view, bgfx::ProgramHandle program, bgfx::ProgramHandle instancedProgram);
+
+		// Opaque packets in view test EQUAL against a depth prepass and don't write depth.
+		void setDepthEqual(bgfx::ViewId view);
+
+		// Opaque packets that write depth, the ones a depth prepass covers.
+		static bool writesDepth(const DrawPacket& packet);
+
+		u32 numDraws() const { return m_numDraws; }
+		u32 numSkippedBindings() const { return m_numSkippedBindings; }
+
+	private:
+		void bindDrawState(const DrawPacket& packet);
+		void bindProgram(const DrawPacket& packet, bool instanced, u8 discardFlags);
+
+		u64 renderState(const DrawPacket& packet) const;
+
+		// BGFX_DISCARD_* bits that can stay bound from a to b.
+		u8 retainable(const DrawPacket& a, const DrawPacket& b) const;
+
+	private:
+		bgfx::Encoder* m_pEncoder;
+
+		// Bindings the previous submit left in place for this one.
+		u8 m_retained{ BGFX_DISCARD_NONE };
+
+		bool m_depthOnly{ false };
+		bgfx::ViewId m_depthView{ 0 };
+		bgfx::ProgramHandle m_hDepthProgram = BGFX_INVALID_HANDLE;
+		bgfx::ProgramHandle m_hDepthProgramInstanced = BGFX_INVALID_HANDLE;
+
+		bool m_depthEqual{ false };
+		bgfx::ViewId m_depthEqualView{ 0 };
+
+		u32 m_numDraws{ 0 };
+		u32 m_numSkippedBindings{ 0 };
+	};
+}
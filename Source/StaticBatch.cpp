@@ -0,0 +1,222 @@
+#include <StaticBatch.h>
+
+
+#include <algorithm>
+
+#include <bx/math.h>
+#include <bx/pixelformat.h>
+
+#include <Mesh.h>
+
+
+namespace zv
+{
+	std::vector<u8> StaticBatch::s_Visible;
+
+
+	StaticBatchGeometry::StaticBatchGeometry(std::vector<Vertex>&& vertices, std::vector<u16>&& indices)
+	{
+		m_vertices = std::move(vertices);
+		m_indices16 = std::move(indices);
+
+		// The ranges index into the merged triangles, the meshes were optimized on their own already.
+		initializeBuffers(false);
+	}
+
+	StaticBatch::StaticBatch(std::unique_ptr<StaticBatchGeometry>&& geometry, Material* material, std::vector<Range>&& ranges)
+		: m_pSharedMaterial(material), m_ranges(std::move(ranges))
+	{
+		m_pGeometry = std::move(geometry);
+
+		// Vertices are in world space already, m_modelMatrix stays identity.
+		m_aabb = m_pGeometry->aabb();
+		setStatic(true);
+
+		m_rangeAabbs.reserve(m_ranges.size());
+		for (const Range& range : m_ranges)
+		{
+			m_rangeAabbs.push_back(range.aabb);
+		}
+	}
+
+	void StaticBatch::build(const std::vector<Object3D*>& objects,
+							std::vector<std::unique_ptr<StaticBatch>>& batches,
+							std::vector<Object3D*>& remaining)
+	{
+		struct Group
+		{
+			Material* material;
+			std::vector<const Mesh*> meshes;
+		};
+
+		std::vector<Group> groups;
+
+		for (Object3D* object : objects)
+		{
+			const Mesh* mesh = dynamic_cast<const Mesh*>(object);
+
+			// Batches keep 16-bit indices, meshes too large for one are drawn on their own.
+			if (NULL == mesh
+				|| !mesh->isStatic()
+				|| !Geometry::fitsIndex16(mesh->geometry()->vertices().size()))
+			{
+				remaining.push_back(object);
+				continue;
+			}
+
+			auto group = std::find_if(groups.begin(), groups.end(), [mesh](const Group& group)
+			{
+				return group.material == mesh->material() || group.material->canBatchWith(*mesh->material());
+			});
+
+			if (group == groups.end())
+			{
+				groups.push_back(Group{ mesh->material(), {} });
+				group = groups.end() - 1;
+			}
+
+			group->meshes.push_back(mesh);
+		}
+
+		for (const Group& group : groups)
+		{
+			std::vector<Vertex> vertices;
+			std::vector<u16> indices;
+			std::vector<Range> ranges;
+
+			auto flush = [&]()
+			{
+				if (ranges.empty())
+					return;
+
+				auto geometry = std::make_unique<StaticBatchGeometry>(std::move(vertices), std::move(indices));
+				batches.push_back(std::make_unique<StaticBatch>(std::move(geometry), group.material, std::move(ranges)));
+
+				vertices.clear();
+				indices.clear();
+				ranges.clear();
+			};
+
+			for (const Mesh* mesh : group.meshes)
+			{
+				if (!Geometry::fitsIndex16(vertices.size() + mesh->geometry()->vertices().size()))
+				{
+					flush();
+				}
+
+				Range range;
+				range.firstIndex = (u32)indices.size();
+				range.numIndices = mesh->geometry()->numIndices();
+				mesh->worldAabb(range.aabb);
+
+				appendMesh(*mesh, vertices, indices);
+				ranges.push_back(range);
+			}
+
+			flush();
+		}
+	}
+
+	void StaticBatch::cleanup()
+	{
+		// The material belongs to one of the source meshes.
+		m_pGeometry->cleanup();
+	}
+
+	void StaticBatch::render(bgfx::Encoder* encoder) const
+	{
+		DrawPacket packet{ m_pSharedMaterial->viewId(), 0, m_pGeometry.get(), m_pSharedMaterial, m_modelMatrix };
+		RenderQueue::submit(encoder, packet);
+	}
+
+	void StaticBatch::enqueue(RenderQueue& queue) const
+	{
+		const u32 numRanges = (u32)m_ranges.size();
+
+		s_Visible.resize(numRanges);
+		Culling::cullAabbs(queue.frustum(), m_rangeAabbs.data(), numRanges, s_Visible.data());
+
+		// Ranges are laid out back to back, so visible neighbours merge into one draw.
+		u32 ii = 0;
+		while (ii < numRanges)
+		{
+			if (0 == s_Visible[ii])
+			{
+				++ii;
+				continue;
+			}
+
+			const Range& first = m_ranges[ii];
+			u32 numIndices = 0;
+			while (ii < numRanges && 0 != s_Visible[ii])
+			{
+				numIndices += m_ranges[ii].numIndices;
+				++ii;
+			}
+
+			const vec3 center = bx::mul(bx::add(first.aabb.min, first.aabb.max), 0.5f);
+			queue.pushRange(m_pSharedMaterial->viewId(), m_pGeometry.get(), m_pSharedMaterial, m_modelMatrix, first.firstIndex, numIndices, center);
+		}
+	}
+
+	bool StaticBatch::worldAabb(bx::Aabb& result) const
+	{
+		result = m_aabb;
+		return true;
+	}
+
+	void StaticBatch::appendMesh(const Mesh& mesh, std::vector<Vertex>& vertices, std::vector<u16>& indices)
+	{
+		const f32* mtx = mesh.modelMatrix();
+		const u32 baseVertex = (u32)vertices.size();
+
+		// Rotates a packed direction by the upper 3x3, keeping w (tangent handedness).
+		// Assumes uniform scale.
+		auto transformPacked = [mtx](u32 packed)
+		{
+			f32 value[4];
+			bx::unpackRgba8(value, &packed);
+
+			const vec3 direction = {
+				value[0] * 2.0f - 1.0f,
+				value[1] * 2.0f - 1.0f,
+				value[2] * 2.0f - 1.0f,
+			};
+
+			vec3 rotated = {
+				direction.x * mtx[0] + direction.y * mtx[4] + direction.z * mtx[8],
+				direction.x * mtx[1] + direction.y * mtx[5] + direction.z * mtx[9],
+				direction.x * mtx[2] + direction.y * mtx[6] + direction.z * mtx[10],
+			};
+			rotated = bx::normalize(rotated);
+
+			value[0] = rotated.x * 0.5f + 0.5f;
+			value[1] = rotated.y * 0.5f + 0.5f;
+			value[2] = rotated.z * 0.5f + 0.5f;
+
+			u32 result;
+			bx::packRgba8(&result, value);
+			return result;
+		};
+
+		for (const Vertex& vertex : mesh.geometry()->vertices())
+		{
+			const vec3 position = bx::mul({ vertex.x, vertex.y, vertex.z }, mtx);
+
+			vertices.push_back(Vertex{
+				position.x, position.y, position.z,
+				transformPacked(vertex.normal),
+				transformPacked(vertex.tangent),
+				vertex.u, vertex.v,
+			});
+		}
+
+		mesh.geometry()->visitIndices([&](const auto& meshIndices)
+		{
+			for (const u32 index : meshIndices)
+			{
+				indices.push_back(u16(baseVertex + index));
+			}
+		});
+	}
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+
+#include <memory>
+#include <vector>
+
+#include <Object3D.h>
+#include <GeometryBase.h>
+#include <MaterialBase.h>
+#include <Types.h>
+
+
+namespace zv
+{
+	class Mesh;
+
+	// Vertices and indices merged from several meshes, already in world space.
+	class StaticBatchGeometry : public Geometry
+	{
+	public:
+		StaticBatchGeometry(std::vector<Vertex>&& vertices, std::vector<u16>&& indices);
+		~StaticBatchGeometry() = default;
+	};
+
+	/*
+	Static meshes sharing a material, baked into one vertex and index buffer.
+
+	Every source mesh keeps its index range and world AABB. Ranges are culled
+	individually, neighbouring visible ranges are drawn with one call. The source
+	meshes still own the material and stay alive, they just leave the scene.
+	*/
+	class StaticBatch : public Object3D
+	{
+	public:
+		struct Range
+		{
+			u32 firstIndex;
+			u32 numIndices;
+			bx::Aabb aabb;
+		};
+
+		StaticBatch(std::unique_ptr<StaticBatchGeometry>&& geometry, Material* material, std::vector<Range>&& ranges);
+		~StaticBatch() = default;
+
+		StaticBatch() = delete;
+
+	public:
+		// Merges all static meshes in objects, grouped by compatible material. Objects
+		// that were not merged are appended to remaining.
+		static void build(const std::vector<Object3D*>& objects,
+						  std::vector<std::unique_ptr<StaticBatch>>& batches,
+						  std::vector<Object3D*>& remaining);
+
+	public:
+		void cleanup() override;
+
+		using Object3D::render;
+		void render(bgfx::Encoder* encoder) const override;
+		void enqueue(RenderQueue& queue) const override;
+
+		bool worldAabb(bx::Aabb& result) const override;
+
+		// The shared material, owned by one of the merged meshes.
+		Material* material() const override { return m_pSharedMaterial; }
+
+		u32 numRanges() const { return (u32)m_ranges.size(); }
+
+	private:
+		static void appendMesh(const Mesh& mesh, std::vector<Vertex>& vertices, std::vector<u16>& indices);
+
+	private:
+		Material* m_pSharedMaterial{ nullptr };
+		std::vector<Range> m_ranges{};
+		bx::Aabb m_aabb{ { 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 0.0f } };
+
+		// The ranges' AABBs back to back, as Culling::cullAabbs takes them.
+		std::vector<bx::Aabb> m_rangeAabbs{};
+
+		// Visibility scratch shared by all batches, only touched from the API thread.
+		static std::vector<u8> s_Visible;
+	};
+}
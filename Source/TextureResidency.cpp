@@ -0,0 +1,204 @@
+#include <TextureResidency.h>
+
+
+#include <algorithm>
+
+#include <Loading.h>
+#include <TextureStreamer.h>
+
+
+namespace zv
+{
+	bool TextureResidency::s_Enabled = false;
+	u32 TextureResidency::s_Frame = 0;
+
+	std::unique_ptr<TextureResidency::Slot[]> TextureResidency::s_Slots;
+	std::vector<u16> TextureResidency::s_Managed;
+	TextureResidencyStats TextureResidency::s_Stats;
+
+
+	void TextureResidency::init(u64 _budgetBytes)
+	{
+		s_Slots = std::make_unique<Slot[]>(bgfx::getCaps()->limits.maxTextures);
+		s_Stats.budgetBytes = _budgetBytes;
+		s_Enabled = true;
+	}
+
+	void TextureResidency::quit()
+	{
+		for (u16 idx : s_Managed)
+		{
+			evict(s_Slots[idx]);
+		}
+		s_Managed.clear();
+		s_Slots.reset();
+
+		const u64 budgetBytes = s_Stats.budgetBytes;
+		s_Stats = TextureResidencyStats{};
+		s_Stats.budgetBytes = budgetBytes;
+		s_Enabled = false;
+	}
+
+	bgfx::TextureHandle TextureResidency::adopt(bgfx::TextureHandle _handle, const char* _filePath, u64 _flags, u8 _skip, const bgfx::TextureInfo& _info)
+	{
+		// The streamer keeps the tails of its textures resident and budgets the rest itself.
+		if (!s_Enabled || !bgfx::isValid(_handle) || TextureStreamer::isStreamed(_handle))
+			return _handle;
+
+		static const u8 texel[4] = { 0x80, 0x80, 0x80, 0xff };
+		bgfx::TextureHandle placeholder = bgfx::createTexture2D(1, 1, false, 1, bgfx::TextureFormat::RGBA8, BGFX_TEXTURE_NONE, bgfx::copy(texel, sizeof(texel)));
+		if (!bgfx::isValid(placeholder))
+			return _handle;
+
+		Slot& slot = s_Slots[placeholder.idx];
+		slot.managed = true;
+		slot.reloading = false;
+		slot.failed = false;
+		++slot.serial;
+		slot.filePath = _filePath;
+		slot.flags = _flags;
+		slot.skip = _skip;
+		slot.bytes = _info.storageSize;
+		slot.resident = _handle;
+		slot.lastSampled.store(s_Frame, std::memory_order_relaxed);
+
+		s_Managed.push_back(placeholder.idx);
+
+		++s_Stats.numTextures;
+		++s_Stats.numResident;
+		s_Stats.residentBytes += slot.bytes;
+
+		return placeholder;
+	}
+
+	void TextureResidency::remove(bgfx::TextureHandle _handle)
+	{
+		if (!s_Enabled || !bgfx::isValid(_handle))
+			return;
+
+		Slot& slot = s_Slots[_handle.idx];
+		if (!slot.managed)
+			return;
+
+		evict(slot);
+		if (slot.reloading)
+		{
+			--s_Stats.numReloading;
+		}
+
+		// A reload still in flight destroys its texture once it sees the serial moved on.
+		slot.managed = false;
+		slot.reloading = false;
+		++slot.serial;
+		slot.filePath.clear();
+
+		s_Managed.erase(std::find(s_Managed.begin(), s_Managed.end(), _handle.idx));
+		--s_Stats.numTextures;
+	}
+
+	bgfx::TextureHandle TextureResidency::resolve(bgfx::TextureHandle _handle)
+	{
+		if (!s_Enabled || !bgfx::isValid(_handle))
+			return _handle;
+
+		Slot& slot = s_Slots[_handle.idx];
+		if (!slot.managed)
+			return _handle;
+
+		slot.lastSampled.store(s_Frame, std::memory_order_relaxed);
+		return bgfx::isValid(slot.resident) ? slot.resident : _handle;
+	}
+
+	void TextureResidency::update()
+	{
+		// Sampled since the last update while evicted.
+		for (u16 idx : s_Managed)
+		{
+			Slot& slot = s_Slots[idx];
+			if (!bgfx::isValid(slot.resident) && !slot.reloading && !slot.failed && slot.lastSampled.load(std::memory_order_relaxed) == s_Frame)
+			{
+				reload(idx);
+			}
+		}
+
+		if (s_Stats.residentBytes > s_Stats.budgetBytes)
+		{
+			std::vector<Slot*> idle;
+			for (u16 idx : s_Managed)
+			{
+				Slot& slot = s_Slots[idx];
+				if (bgfx::isValid(slot.resident) && s_Frame - slot.lastSampled.load(std::memory_order_relaxed) >= KeepFrames)
+				{
+					idle.push_back(&slot);
+				}
+			}
+
+			std::sort(idle.begin(), idle.end(), [](const Slot* _a, const Slot* _b)
+			{
+				return _a->lastSampled.load(std::memory_order_relaxed) < _b->lastSampled.load(std::memory_order_relaxed);
+			});
+
+			for (Slot* slot : idle)
+			{
+				if (s_Stats.residentBytes <= s_Stats.budgetBytes)
+					break;
+
+				evict(*slot);
+				++s_Stats.numEvictions;
+			}
+		}
+
+		++s_Frame;
+	}
+
+	void TextureResidency::evict(Slot& _slot)
+	{
+		if (!bgfx::isValid(_slot.resident))
+			return;
+
+		// bgfx defers the destruction past the frames still sampling it.
+		bgfx::destroy(_slot.resident);
+		_slot.resident = BGFX_INVALID_HANDLE;
+
+		--s_Stats.numResident;
+		s_Stats.residentBytes -= _slot.bytes;
+	}
+
+	void TextureResidency::reload(u16 _idx)
+	{
+		Slot& slot = s_Slots[_idx];
+		slot.reloading = true;
+		++s_Stats.numReloading;
+
+		const u32 serial = slot.serial;
+		LoadingManager::reloadTextureAsync(slot.filePath.c_str(), slot.flags, slot.skip, [_idx, serial](bgfx::TextureHandle _handle, const bgfx::TextureInfo& _info)
+		{
+			if (!s_Enabled || s_Slots[_idx].serial != serial)
+			{
+				if (bgfx::isValid(_handle))
+				{
+					bgfx::destroy(_handle);
+				}
+				return;
+			}
+
+			Slot& slot = s_Slots[_idx];
+			slot.reloading = false;
+			--s_Stats.numReloading;
+
+			// The file went away since the first load, the placeholder stays.
+			if (!bgfx::isValid(_handle))
+			{
+				slot.failed = true;
+				return;
+			}
+
+			slot.resident = _handle;
+			slot.bytes = _info.storageSize;
+
+			++s_Stats.numResident;
+			++s_Stats.numReloads;
+			s_Stats.residentBytes += slot.bytes;
+		});
+	}
+}
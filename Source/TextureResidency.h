@@ -0,0 +1,108 @@
+#pragma once
+
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <bgfx/bgfx.h>
+
+#include <Types.h>
+
+
+namespace zv
+{
+	struct TextureResidencyStats
+	{
+		u32 numTextures{ 0 };
+		u32 numResident{ 0 };
+		u32 numReloading{ 0 };
+		u64 residentBytes{ 0 };
+		u64 budgetBytes{ 0 };
+		u32 numEvictions{ 0 };
+		u32 numReloads{ 0 };
+	};
+
+	/*
+	Keeps the textures that aren't streamed within a memory budget. Materials
+	hold a 1x1 placeholder texture in place of each one, resolve() swaps in
+	the real texture when it's bound and notes the frame it was sampled in.
+
+	update() destroys the least recently sampled textures while the budget is
+	exceeded and reloads the ones sampled while evicted, through the loading
+	workers. Until a reload finishes the placeholder is sampled. Textures used
+	in the last few frames are never evicted, a working set larger than the
+	budget goes over it rather than reloading every frame.
+
+	resolve() may run on the render workers, everything else on the API thread.
+	*/
+	class TextureResidency
+	{
+	private:
+		TextureResidency() = default;
+
+	public:
+		// After bgfx::init(), it sizes the table by the texture limit.
+		static void init(u64 _budgetBytes = 256 << 20);
+		static void quit();
+
+		static bool isEnabled() { return s_Enabled; }
+
+		static void setBudget(u64 _budgetBytes) { s_Stats.budgetBytes = _budgetBytes; }
+
+		// Takes a freshly loaded texture and returns the placeholder to hand out in its
+		// place. Streamed textures, and every texture while disabled, are returned as
+		// they are. _info.storageSize is what the texture counts against the budget.
+		static bgfx::TextureHandle adopt(bgfx::TextureHandle _handle,
+											const char* _filePath,
+											u64 _flags,
+											u8 _skip,
+											const bgfx::TextureInfo& _info);
+
+		// Destroys the texture behind a placeholder, its owner destroys the placeholder.
+		static void remove(bgfx::TextureHandle _handle);
+
+		// Texture to bind in place of _handle.
+		static bgfx::TextureHandle resolve(bgfx::TextureHandle _handle);
+
+		// Evicts over the budget and starts reloads. Once per frame, outside of Renderer::submit().
+		static void update();
+
+		static const TextureResidencyStats& stats() { return s_Stats; }
+
+	private:
+		struct Slot
+		{
+			bool managed{ false };
+			bool reloading{ false };
+			bool failed{ false };
+
+			// Tells a reload that finishes after remove() from one for a new texture in the same slot.
+			u32 serial{ 0 };
+
+			std::string filePath{};
+			u64 flags{ 0 };
+			u8 skip{ 0 };
+			u32 bytes{ 0 };
+
+			bgfx::TextureHandle resident = BGFX_INVALID_HANDLE;
+			std::atomic<u32> lastSampled{ 0 };
+		};
+
+		static void evict(Slot& _slot);
+		static void reload(u16 _idx);
+
+	private:
+		// Frames a texture stays resident after it was last sampled, whatever the budget.
+		static constexpr u32 KeepFrames = 3;
+
+		static bool s_Enabled;
+		static u32 s_Frame;
+
+		// By placeholder handle index, s_Managed lists the slots in use.
+		static std::unique_ptr<Slot[]> s_Slots;
+		static std::vector<u16> s_Managed;
+		static TextureResidencyStats s_Stats;
+	};
+}
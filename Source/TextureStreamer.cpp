@@ -0,0 +1,416 @@
+#include <TextureStreamer.h>
+
+
+#include <algorithm>
+#include <vector>
+
+#include <bx/math.h>
+
+#include <MaterialBase.h>
+#include <Vfs.h>
+
+
+namespace zv
+{
+	bool TextureStreamer::s_Enabled = false;
+	bool TextureStreamer::s_Blit = false;
+	u64 TextureStreamer::s_UploadBytes = 0;
+	u32 TextureStreamer::s_TailSize = 64;
+	u32 TextureStreamer::s_Frame = 0;
+
+	std::unordered_map<u16, TextureStreamer::Texture> TextureStreamer::s_Textures;
+	std::deque<TextureStreamer::Release> TextureStreamer::s_Releases;
+	TextureStreamerStats TextureStreamer::s_Stats;
+
+
+	void TextureStreamer::init(u64 _budgetBytes, u64 _uploadBytes, u32 _tailSize)
+	{
+		s_Enabled = true;
+		s_Blit = 0 != (bgfx::getCaps()->supported & BGFX_CAPS_TEXTURE_BLIT);
+		s_UploadBytes = _uploadBytes;
+		s_TailSize = bx::max<u32>(_tailSize, 1);
+		s_Stats.budgetBytes = _budgetBytes;
+	}
+
+	void TextureStreamer::quit()
+	{
+		for (auto& item : s_Textures)
+		{
+			if (bgfx::isValid(item.second.resident))
+			{
+				bgfx::destroy(item.second.resident);
+			}
+		}
+		s_Textures.clear();
+		s_Releases.clear();
+
+		const u64 budgetBytes = s_Stats.budgetBytes;
+		s_Stats = TextureStreamerStats{};
+		s_Stats.budgetBytes = budgetBytes;
+		s_Enabled = false;
+	}
+
+	bgfx::TextureHandle TextureStreamer::create(std::unique_ptr<AssetFile>& _file, const char* _name, u64 _flags, u8 _skip, bgfx::TextureInfo* _info)
+	{
+		if (!s_Enabled)
+			return BGFX_INVALID_HANDLE;
+
+		bimg::ImageContainer header;
+		bx::Error err;
+		if (!bimg::imageParse(header, _file->data(), _file->size(), &err))
+			return BGFX_INVALID_HANDLE;
+
+		if (header.m_cubeMap || 1 < header.m_depth || 1 < header.m_numLayers)
+			return BGFX_INVALID_HANDLE;
+
+		const bgfx::TextureFormat::Enum format = bgfx::TextureFormat::Enum(header.m_format);
+		if (!bgfx::isTextureValid(0, false, 1, format, _flags))
+			return BGFX_INVALID_HANDLE;
+
+		// Every resident texture is created with a full chain, so the file needs one too.
+		const u32 size = bx::max(header.m_width, header.m_height);
+		u32 fullChain = 1;
+		while (size >> fullChain)
+		{
+			++fullChain;
+		}
+		if (header.m_numMips != fullChain)
+			return BGFX_INVALID_HANDLE;
+
+		const u8 minMip = bx::min<u8>(_skip, header.m_numMips - 1);
+
+		// The first mip no larger than the tail size, small textures aren't worth streaming.
+		u8 tailMip = minMip;
+		while (tailMip + 1 < header.m_numMips && (size >> tailMip) > s_TailSize)
+		{
+			++tailMip;
+		}
+		if (tailMip == minMip)
+			return BGFX_INVALID_HANDLE;
+
+		Texture texture;
+		texture.file = std::shared_ptr<AssetFile>(_file.release());
+		texture.header = header;
+		texture.name = _name;
+		texture.flags = _flags;
+		texture.minMip = minMip;
+		texture.tailMip = tailMip;
+		texture.topMip = tailMip;
+		texture.wantedMip = tailMip;
+		texture.tailBytes = 0;
+		texture.residentBytes = 0;
+		texture.lastRequested = s_Frame;
+		texture.tail = BGFX_INVALID_HANDLE;
+		texture.resident = BGFX_INVALID_HANDLE;
+
+		u32 uploadBytes = 0;
+		bgfx::TextureHandle handle = createChain(texture, tailMip, &texture.tailBytes, &uploadBytes);
+		if (!bgfx::isValid(handle))
+			return BGFX_INVALID_HANDLE;
+
+		texture.tail = handle;
+
+		bgfx::setName(handle, _name);
+
+		if (NULL != _info)
+		{
+			bgfx::calcTextureSize(
+				*_info
+				, u16(bx::max<u32>(header.m_width >> minMip, 1))
+				, u16(bx::max<u32>(header.m_height >> minMip, 1))
+				, 1
+				, false
+				, true
+				, 1
+				, format
+			);
+		}
+
+		++s_Stats.numTextures;
+		s_Stats.residentBytes += texture.tailBytes;
+
+		s_Textures.emplace(handle.idx, std::move(texture));
+		return handle;
+	}
+
+	void TextureStreamer::remove(bgfx::TextureHandle _handle)
+	{
+		auto it = s_Textures.find(_handle.idx);
+		if (s_Textures.end() == it)
+			return;
+
+		Texture& texture = it->second;
+		setTopMip(texture, texture.tailMip);
+
+		--s_Stats.numTextures;
+		release(texture.tailBytes);
+
+		s_Textures.erase(it);
+	}
+
+	bgfx::TextureHandle TextureStreamer::resolve(bgfx::TextureHandle _handle)
+	{
+		if (s_Textures.empty())
+			return _handle;
+
+		auto it = s_Textures.find(_handle.idx);
+		if (s_Textures.end() == it || !bgfx::isValid(it->second.resident))
+			return _handle;
+
+		return it->second.resident;
+	}
+
+	void TextureStreamer::request(const Material& _material, f32 _pixels)
+	{
+		request(_material.texture(eTextureType::Diffuse), _pixels);
+		request(_material.texture(eTextureType::Normal), _pixels);
+	}
+
+	void TextureStreamer::request(bgfx::TextureHandle _handle, f32 _pixels)
+	{
+		auto it = s_Textures.find(_handle.idx);
+		if (s_Textures.end() == it)
+			return;
+
+		Texture& texture = it->second;
+
+		// Smallest mip that still has a texel per pixel.
+		const u32 size = bx::max(texture.header.m_width, texture.header.m_height);
+		u8 mip = texture.minMip;
+		while (mip < texture.tailMip && f32(size >> (mip + 1)) >= _pixels)
+		{
+			++mip;
+		}
+
+		texture.wantedMip = bx::min(texture.wantedMip, mip);
+		texture.lastRequested = s_Frame;
+	}
+
+	void TextureStreamer::update()
+	{
+		s_Stats.uploadedBytes = 0;
+
+		while (!s_Releases.empty() && s_Frame - s_Releases.front().frame >= DestroyFrames)
+		{
+			s_Stats.residentBytes -= s_Releases.front().bytes;
+			s_Stats.releasingBytes -= s_Releases.front().bytes;
+			s_Releases.pop_front();
+		}
+
+		std::vector<Texture*> promote;
+		for (auto& item : s_Textures)
+		{
+			Texture& texture = item.second;
+
+			if (s_Frame - texture.lastRequested > EvictAfterFrames)
+			{
+				if (bgfx::isValid(texture.resident))
+				{
+					setTopMip(texture, texture.tailMip);
+					++s_Stats.numEvictions;
+				}
+			}
+			else if (texture.lastRequested == s_Frame && texture.topMip + 1 < texture.wantedMip)
+			{
+				// Two mips sharper than this frame needs, give back all but one.
+				setTopMip(texture, texture.wantedMip - 1);
+			}
+			else if (texture.wantedMip < texture.topMip)
+			{
+				promote.push_back(&texture);
+			}
+		}
+
+		// Largest shortfall first, one mip per texture and update.
+		std::sort(promote.begin(), promote.end(), [](const Texture* _a, const Texture* _b)
+		{
+			return _a->topMip - _a->wantedMip > _b->topMip - _b->wantedMip;
+		});
+
+		for (Texture* texture : promote)
+		{
+			const u8 top = texture->topMip - 1;
+			const u32 bytes = mipBytes(*texture, top, texture->header.m_numMips);
+			const u32 uploadBytes = mipBytes(*texture, top, bx::max(top, blitMip(*texture)));
+
+			if (0 != s_Stats.uploadedBytes && s_Stats.uploadedBytes + uploadBytes > s_UploadBytes)
+				break;
+
+			// Evictions free their bytes only once bgfx destroyed the textures, enough to
+			// fit the promotion then and no more.
+			while (s_Stats.residentBytes - s_Stats.releasingBytes - texture->residentBytes + bytes > s_Stats.budgetBytes && evictOne(texture))
+			{
+			}
+
+			// The old chain is still allocated while the new one is, retried in a later update.
+			if (s_Stats.residentBytes + bytes > s_Stats.budgetBytes)
+				continue;
+
+			setTopMip(*texture, top);
+			++s_Stats.numPromotions;
+		}
+
+		for (auto& item : s_Textures)
+		{
+			item.second.wantedMip = item.second.tailMip;
+		}
+
+		++s_Frame;
+	}
+
+	bgfx::TextureHandle TextureStreamer::createChain(const Texture& _texture, u8 _top, u32* _bytes, u32* _uploadBytes)
+	{
+		const bimg::ImageContainer& header = _texture.header;
+		const bgfx::TextureFormat::Enum format = bgfx::TextureFormat::Enum(header.m_format);
+
+		const u16 width = u16(bx::max<u32>(header.m_width >> _top, 1));
+		const u16 height = u16(bx::max<u32>(header.m_height >> _top, 1));
+
+		const bgfx::TextureHandle source = bgfx::isValid(_texture.resident) ? _texture.resident : _texture.tail;
+		const u8 sourceTop = blitMip(_texture);
+
+		// No memory, so the texture stays mutable and takes its mips through updates and blits.
+		const u64 flags = sourceTop < header.m_numMips ? _texture.flags | BGFX_TEXTURE_BLIT_DST : _texture.flags;
+		bgfx::TextureHandle handle = bgfx::createTexture2D(width, height, _top + 1 < header.m_numMips, 1, format, flags);
+		if (!bgfx::isValid(handle))
+			return BGFX_INVALID_HANDLE;
+
+		*_bytes = 0;
+		*_uploadBytes = 0;
+		for (u8 lod = _top; lod < header.m_numMips; ++lod)
+		{
+			bimg::ImageMip mip;
+			if (!bimg::imageGetRawData(header, 0, lod, _texture.file->data(), _texture.file->size(), mip))
+				break;
+
+			*_bytes += mip.m_size;
+
+			// On the GPU already, bgfx blits before the source's deferred destroy.
+			if (lod >= sourceTop)
+			{
+				bgfx::blit(BlitView, handle, u8(lod - _top), 0, 0, 0, source, u8(lod - sourceTop));
+				continue;
+			}
+
+			// Straight from the mapping, each upload keeps the file open until bgfx is done with it.
+			const bgfx::Memory* mem = bgfx::makeRef(mip.m_data, mip.m_size, releaseFileCb, new std::shared_ptr<AssetFile>(_texture.file));
+			bgfx::updateTexture2D(
+				handle
+				, 0
+				, u8(lod - _top)
+				, 0
+				, 0
+				, u16(bx::max<u32>(header.m_width >> lod, 1))
+				, u16(bx::max<u32>(header.m_height >> lod, 1))
+				, mem
+			);
+
+			*_uploadBytes += mip.m_size;
+		}
+
+		return handle;
+	}
+
+	u8 TextureStreamer::blitMip(const Texture& _texture)
+	{
+		if (!s_Blit || (!bgfx::isValid(_texture.resident) && !bgfx::isValid(_texture.tail)))
+			return _texture.header.m_numMips;
+
+		return _texture.topMip;
+	}
+
+	u32 TextureStreamer::mipBytes(const Texture& _texture, u8 _first, u8 _end)
+	{
+		u32 bytes = 0;
+		for (u8 lod = _first; lod < _end; ++lod)
+		{
+			bimg::ImageMip mip;
+			if (bimg::imageGetRawData(_texture.header, 0, lod, _texture.file->data(), _texture.file->size(), mip))
+			{
+				bytes += mip.m_size;
+			}
+		}
+		return bytes;
+	}
+
+	void TextureStreamer::setTopMip(Texture& _texture, u8 _top)
+	{
+		_top = bx::clamp(_top, _texture.minMip, _texture.tailMip);
+		if (_top == _texture.topMip)
+			return;
+
+		// Created while the old texture is still around to blit from.
+		bgfx::TextureHandle resident = BGFX_INVALID_HANDLE;
+		u32 residentBytes = 0;
+		u32 uploadBytes = 0;
+		if (_top < _texture.tailMip)
+		{
+			resident = createChain(_texture, _top, &residentBytes, &uploadBytes);
+		}
+
+		if (bgfx::isValid(_texture.resident))
+		{
+			// bgfx defers the destruction past the frames still sampling it.
+			bgfx::destroy(_texture.resident);
+			--s_Stats.numResident;
+			release(_texture.residentBytes);
+		}
+
+		_texture.resident = BGFX_INVALID_HANDLE;
+		_texture.residentBytes = 0;
+		_texture.topMip = _texture.tailMip;
+
+		if (bgfx::isValid(resident))
+		{
+			bgfx::setName(resident, _texture.name.c_str());
+			_texture.resident = resident;
+			_texture.residentBytes = residentBytes;
+			_texture.topMip = _top;
+			++s_Stats.numResident;
+			s_Stats.residentBytes += residentBytes;
+			s_Stats.uploadedBytes += uploadBytes;
+		}
+	}
+
+	bool TextureStreamer::evictOne(const Texture* _keep)
+	{
+		// Only textures that weren't requested this frame, or hold more than they were asked for.
+		Texture* oldest = NULL;
+		for (auto& item : s_Textures)
+		{
+			Texture& texture = item.second;
+			if (&texture == _keep || !bgfx::isValid(texture.resident))
+				continue;
+
+			if (texture.lastRequested == s_Frame && texture.topMip >= texture.wantedMip)
+				continue;
+
+			if (NULL == oldest || texture.lastRequested < oldest->lastRequested)
+			{
+				oldest = &texture;
+			}
+		}
+
+		if (NULL == oldest)
+			return false;
+
+		setTopMip(*oldest, oldest->topMip + 1);
+		++s_Stats.numEvictions;
+		return true;
+	}
+
+	void TextureStreamer::release(u32 _bytes)
+	{
+		if (0 == _bytes)
+			return;
+
+		s_Releases.push_back({ s_Frame, _bytes });
+		s_Stats.releasingBytes += _bytes;
+	}
+
+	void TextureStreamer::releaseFileCb(void* _ptr, void* _userData)
+	{
+		BX_UNUSED(_ptr);
+		delete (std::shared_ptr<AssetFile>*)_userData;
+	}
+}
@@ -0,0 +1,162 @@
+#pragma once
+
+
+#include <deque>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include <bgfx/bgfx.h>
+#include <bimg/bimg.h>
+
+#include <Types.h>
+
+
+namespace zv
+{
+	class AssetFile;
+	class Material;
+
+	struct TextureStreamerStats
+	{
+		u32 numTextures{ 0 };
+		u32 numResident{ 0 };    // Textures with mips above their tail on the GPU.
+		u64 residentBytes{ 0 };  // Tails included, and textures bgfx hasn't destroyed yet.
+		u64 releasingBytes{ 0 }; // Part of residentBytes, destroyed but possibly still in flight.
+		u64 budgetBytes{ 0 };
+		u64 uploadedBytes{ 0 };  // From the files, during the last update().
+		u32 numPromotions{ 0 };
+		u32 numEvictions{ 0 };
+	};
+
+	/*
+	Streams the mip chains of 2D DDS / KTX textures. Loading uploads only the
+	small mips, the tail, into the handle handed out to materials. Mips above
+	the tail are uploaded later by update() as objects using the texture get
+	large enough on screen, into a second texture that Material binds in place
+	of the tail through resolve().
+
+	bgfx can't clamp sampling to a range of mips, so the resident texture
+	always holds a complete chain from its top mip down. Growing or shrinking
+	it by a mip recreates it. Where the backend can blit, the mips already on
+	the GPU are copied over from the old texture and only a new top mip is
+	uploaded from the mapped file with updateTexture2D, otherwise the whole
+	chain is.
+
+	Resident mips share a global budget. When a texture needs more detail than
+	fits, the least recently requested textures lose their top mips first. A
+	replaced texture keeps counting against the budget until bgfx destroyed it.
+	API thread only.
+	*/
+	class TextureStreamer
+	{
+	private:
+		TextureStreamer() = default;
+
+	public:
+		// _uploadBytes caps what update() uploads per call, one mip step always goes through.
+		static void init(u64 _budgetBytes = 256 << 20, u64 _uploadBytes = 8 << 20, u32 _tailSize = 64);
+		static void quit();
+
+		static bool isEnabled() { return s_Enabled; }
+		static void setEnabled(bool _enabled) { s_Enabled = _enabled; }
+
+		static void setBudget(u64 _budgetBytes) { s_Stats.budgetBytes = _budgetBytes; }
+
+		// Creates the tail texture when _file holds a streamable texture and takes
+		// the file, returns an invalid handle and leaves _file alone otherwise.
+		// Mips above _skip are never streamed in. _info describes the texture at
+		// its largest.
+		static bgfx::TextureHandle create(std::unique_ptr<AssetFile>& _file,
+											const char* _name,
+											u64 _flags,
+											u8 _skip,
+											bgfx::TextureInfo* _info);
+
+		// Drops the streamed mips of a tail handle, its owner destroys the handle.
+		static void remove(bgfx::TextureHandle _handle);
+
+		static bool isStreamed(bgfx::TextureHandle _handle) { return 0 != s_Textures.count(_handle.idx); }
+
+		// Texture to bind in place of _handle.
+		static bgfx::TextureHandle resolve(bgfx::TextureHandle _handle);
+
+		// Screen space demand: objects using the material span _pixels on screen.
+		static void request(const Material& _material, f32 _pixels);
+		static void request(bgfx::TextureHandle _handle, f32 _pixels);
+
+		// Promotes textures that need more detail and evicts over the budget. Once per frame.
+		static void update();
+
+		static const TextureStreamerStats& stats() { return s_Stats; }
+
+	private:
+		struct Texture
+		{
+			std::shared_ptr<AssetFile> file;
+			bimg::ImageContainer header;
+			std::string name;
+			u64 flags;
+
+			u8 minMip;     // _skip, the largest mip ever resident.
+			u8 tailMip;    // Top mip of the tail texture.
+			u8 topMip;     // Top mip bound right now, tailMip when nothing is resident.
+			u8 wantedMip;  // From this frame's requests.
+
+			u32 tailBytes;
+			u32 residentBytes;
+			u32 lastRequested;
+
+			bgfx::TextureHandle tail;
+			bgfx::TextureHandle resident;
+		};
+
+		struct Release
+		{
+			u32 frame;
+			u32 bytes;
+		};
+
+		// Complete chain from _top down. Mips the texture has bound right now are blitted
+		// from it, the others are uploaded straight from the mapped file.
+		static bgfx::TextureHandle createChain(const Texture& _texture, u8 _top, u32* _bytes, u32* _uploadBytes);
+
+		// Top mip createChain() can blit from, past the chain without blits.
+		static u8 blitMip(const Texture& _texture);
+
+		// Mips _first up to _end.
+		static u32 mipBytes(const Texture& _texture, u8 _first, u8 _end);
+
+		// Recreates the resident texture with _top as its top mip, or drops it at the tail.
+		static void setTopMip(Texture& _texture, u8 _top);
+
+		// Takes a top mip off the least recently requested texture other than _keep.
+		static bool evictOne(const Texture* _keep);
+
+		// _bytes of a texture just destroyed stay resident until bgfx is done with it.
+		static void release(u32 _bytes);
+
+		static void releaseFileCb(void* _ptr, void* _userData);
+
+	private:
+		static constexpr u32 EvictAfterFrames = 300;
+
+		// bgfx renders a frame while the next one is submitted, a destroy has gone
+		// through by the end of the frame after the one it was called in.
+		static constexpr u32 DestroyFrames = 2;
+
+		// Blits go ahead of this view's draws.
+		static constexpr bgfx::ViewId BlitView = 0;
+
+		static bool s_Enabled;
+		static bool s_Blit;
+		static u64 s_UploadBytes;
+		static u32 s_TailSize;
+		static u32 s_Frame;
+
+		// By tail handle index.
+		static std::unordered_map<u16, Texture> s_Textures;
+		static std::deque<Release> s_Releases;
+		static TextureStreamerStats s_Stats;
+	};
+}
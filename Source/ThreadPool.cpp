@@ -0,0 +1,96 @@
+#include <ThreadPool.h>
+
+
+#include <bx/bx.h>
+
+
+namespace zv
+{
+	ThreadPool::ThreadPool(u32 numThreads)
+	{
+		m_threads.reserve(numThreads);
+		for (u32 ii = 0; ii < numThreads; ++ii)
+		{
+			m_threads.emplace_back(&ThreadPool::workerMain, this);
+		}
+	}
+
+	ThreadPool::~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_quit = true;
+		}
+		m_jobAvailable.notify_all();
+
+		for (std::thread& thread : m_threads)
+		{
+			thread.join();
+		}
+	}
+
+	void ThreadPool::enqueue(Job&& job)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_jobs.emplace_back(std::move(job));
+		}
+		m_jobAvailable.notify_one();
+	}
+
+	void ThreadPool::parallelFor(u32 count, u32 numChunks, const RangeJob& job)
+	{
+		if (0 == count)
+			return;
+
+		numChunks = bx::clamp<u32>(numChunks, 1, bx::min(count, numThreads() + 1));
+
+		const u32 chunkSize = (count + numChunks - 1) / numChunks;
+
+		std::mutex doneMutex;
+		std::condition_variable doneCondition;
+		u32 numPending = numChunks - 1;
+
+		for (u32 chunk = 1; chunk < numChunks; ++chunk)
+		{
+			const u32 begin = bx::min(chunk * chunkSize, count);
+			const u32 end = bx::min(begin + chunkSize, count);
+
+			enqueue([&, chunk, begin, end]()
+			{
+				job(chunk, begin, end);
+
+				std::lock_guard<std::mutex> lock(doneMutex);
+				if (0 == --numPending)
+				{
+					doneCondition.notify_one();
+				}
+			});
+		}
+
+		job(0, 0, bx::min(chunkSize, count));
+
+		std::unique_lock<std::mutex> lock(doneMutex);
+		doneCondition.wait(lock, [&numPending]() { return 0 == numPending; });
+	}
+
+	void ThreadPool::workerMain()
+	{
+		for (;;)
+		{
+			Job job;
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_jobAvailable.wait(lock, [this]() { return m_quit || !m_jobs.empty(); });
+
+				if (m_quit && m_jobs.empty())
+					return;
+
+				job = std::move(m_jobs.front());
+				m_jobs.pop_front();
+			}
+
+			job();
+		}
+	}
+}
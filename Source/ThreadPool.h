@@ -0,0 +1,49 @@
+#pragma once
+
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <Types.h>
+
+
+namespace zv
+{
+	class ThreadPool
+	{
+	public:
+		using Job = std::function<void()>;
+		using RangeJob = std::function<void(u32 chunk, u32 begin, u32 end)>;
+
+		explicit ThreadPool(u32 numThreads);
+		~ThreadPool();
+
+		ThreadPool() = delete;
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+
+	public:
+		u32 numThreads() const { return (u32)m_threads.size(); }
+
+		void enqueue(Job&& job);
+
+		// Splits [0, count) into numChunks contiguous ranges. Chunk 0 runs on the
+		// calling thread, the rest on the workers. Blocks until all chunks are done.
+		void parallelFor(u32 count, u32 numChunks, const RangeJob& job);
+
+	private:
+		void workerMain();
+
+	private:
+		std::vector<std::thread> m_threads{};
+		std::deque<Job> m_jobs{};
+
+		std::mutex m_mutex;
+		std::condition_variable m_jobAvailable;
+		bool m_quit{ false };
+	};
+}
@@ -0,0 +1,194 @@
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <bx/rng.h>
+
+#include <Archive.h>
+#include <Types.h>
+
+
+using namespace zv;
+
+
+// zv-test-archive
+//
+// Round trips the LZ4 block codec of Archive on inputs that stress its edge
+// cases, and feeds the decoder truncated and corrupt blocks it has to reject.
+// Exits with a failure when any check doesn't hold.
+namespace
+{
+    // Written past the end of every output, a decoder overrun changes it.
+    constexpr u8 Guard = 0xa5;
+    constexpr u32 NumGuardBytes = 16;
+
+    u32 s_NumChecks = 0;
+    u32 s_NumFailed = 0;
+
+    void check(bool _passed, const std::string& _name)
+    {
+        ++s_NumChecks;
+        if (!_passed)
+        {
+            std::cout << "FAILED: " << _name << "\n";
+            ++s_NumFailed;
+        }
+    }
+
+    std::vector<u8> compress(const std::vector<u8>& _data)
+    {
+        std::vector<u8> compressed(Archive::compressBound(u32(_data.size())));
+        const u32 size = Archive::compress(_data.data(), u32(_data.size()), compressed.data(), u32(compressed.size()));
+        compressed.resize(size);
+        return compressed;
+    }
+
+    // Decodes into a buffer of _dstSize followed by guard bytes, which must survive.
+    bool decompress(const std::vector<u8>& _compressed, u32 _dstSize, std::vector<u8>& _result)
+    {
+        _result.assign(_dstSize + NumGuardBytes, Guard);
+        const bool decoded = Archive::decompress(_compressed.data(), u32(_compressed.size()), _result.data(), _dstSize);
+
+        for (u32 ii = _dstSize; ii < _dstSize + NumGuardBytes; ++ii)
+        {
+            if (Guard != _result[ii])
+            {
+                std::cout << "Decoder wrote past the end of its output\n";
+                std::exit(EXIT_FAILURE);
+            }
+        }
+
+        _result.resize(_dstSize);
+        return decoded;
+    }
+
+    void roundTrip(const std::string& _name, const std::vector<u8>& _data)
+    {
+        const std::vector<u8> compressed = compress(_data);
+        check(!compressed.empty(), _name + ", compressed");
+
+        std::vector<u8> result;
+        check(decompress(compressed, u32(_data.size()), result) && result == _data, _name + ", round trip");
+
+        // Every prefix ends short of the output, mid literals or mid sequence. Empty
+        // input is the exception, no bytes at all decode to it as well.
+        bool truncatedRejected = true;
+        for (size_t size = _data.empty() ? 1 : 0; size < compressed.size(); ++size)
+        {
+            const std::vector<u8> truncated(compressed.begin(), compressed.begin() + size);
+            truncatedRejected &= !decompress(truncated, u32(_data.size()), result);
+        }
+        check(truncatedRejected, _name + ", truncated");
+
+        // The block carries no size of its own, the caller's has to match it.
+        check(!decompress(compressed, u32(_data.size()) + 1, result), _name + ", output too large");
+        if (!_data.empty())
+        {
+            check(!decompress(compressed, u32(_data.size()) - 1, result), _name + ", output too small");
+        }
+    }
+
+    std::vector<u8> bytes(const char* _text)
+    {
+        return std::vector<u8>(_text, _text + std::strlen(_text));
+    }
+
+    void testRoundTrips()
+    {
+        roundTrip("empty", {});
+        roundTrip("shorter than a match", bytes("abc"));
+        roundTrip("literals only", bytes("The quick brown fox jumps over the lazy dog"));
+
+        bx::RngMwc rng;
+        std::vector<u8> noise(64 << 10);
+        for (u8& value : noise)
+        {
+            value = u8(rng.gen());
+        }
+        roundTrip("random, doesn't compress", noise);
+        check(compress(noise).size() > noise.size(), "random, stored larger");
+
+        // Match lengths far past 15 + 255 take several length bytes.
+        std::vector<u8> zeros(1 << 20, 0);
+        roundTrip("long run", zeros);
+        check(compress(zeros).size() < zeros.size() / 200, "long run, compressed");
+
+        // Offsets shorter than the match, the decoder copies what it is writing.
+        std::string pattern;
+        while (pattern.size() < 10000)
+        {
+            pattern += "abc";
+        }
+        roundTrip("overlapping match, offset 3", bytes(pattern.c_str()));
+
+        std::vector<u8> text;
+        for (u32 ii = 0; ii < 2000; ++ii)
+        {
+            const std::string line = "entry " + std::to_string(ii % 37) + " of the archive index\n";
+            text.insert(text.end(), line.begin(), line.end());
+        }
+        roundTrip("repeated text", text);
+
+        // Literal runs past 15 + 255 between matches.
+        std::vector<u8> mixed;
+        for (u32 ii = 0; ii < 4; ++ii)
+        {
+            mixed.insert(mixed.end(), noise.begin(), noise.begin() + 1000);
+            mixed.insert(mixed.end(), 500, u8(ii));
+        }
+        roundTrip("long literals between matches", mixed);
+
+        // Matches reaching back close to the 64 KiB offset limit.
+        std::vector<u8> far(noise.begin(), noise.begin() + 60000);
+        far.insert(far.end(), noise.begin(), noise.begin() + 4000);
+        roundTrip("distant match", far);
+    }
+
+    void testCorrupt()
+    {
+        std::vector<u8> result;
+
+        // One literal 'a', then a match of 4.
+        check(!decompress({ 0x10, 'a', 0x00, 0x00 }, 5, result), "zero offset");
+        check(!decompress({ 0x10, 'a', 0x02, 0x00 }, 5, result), "offset before the output");
+        check(decompress({ 0x10, 'a', 0x01, 0x00 }, 5, result) && bytes("aaaaa") == result, "valid match");
+        check(!decompress({ 0x10, 'a', 0x01, 0x00 }, 4, result), "match past the output");
+        check(!decompress({ 0x10, 'a', 0x01 }, 5, result), "offset cut short");
+        check(!decompress({ 0x1f, 'a', 0x01, 0x00 }, 64, result), "match length cut short");
+
+        check(!decompress({ 0x50, 'a', 'b' }, 5, result), "literals past the input");
+        check(!decompress({ 0x30, 'a', 'b', 'c' }, 2, result), "literals past the output");
+        check(!decompress({ 0xf0, 0xff, 0xff }, 1024, result), "literal length cut short");
+
+        check(!decompress({}, 1, result), "empty input, output expected");
+        check(decompress({}, 0, result), "empty input, empty output");
+
+        std::vector<u8> tooSmall(8);
+        const std::vector<u8> data = bytes("some data that needs a bigger buffer");
+        check(0 == Archive::compress(data.data(), u32(data.size()), tooSmall.data(), u32(tooSmall.size())), "compress, capacity too small");
+
+        // Random garbage may decode or not, it must never write past the output.
+        bx::RngMwc rng(7);
+        for (u32 ii = 0; ii < 10000; ++ii)
+        {
+            std::vector<u8> garbage(1 + rng.gen() % 64);
+            for (u8& value : garbage)
+            {
+                value = u8(rng.gen());
+            }
+            decompress(garbage, rng.gen() % 256, result);
+        }
+    }
+}
+
+
+int main()
+{
+    testRoundTrips();
+    testCorrupt();
+
+    std::cout << s_NumChecks - s_NumFailed << " of " << s_NumChecks << " archive codec checks passed\n";
+    return 0 == s_NumFailed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
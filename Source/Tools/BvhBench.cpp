@@ -0,0 +1,163 @@
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include <bx/math.h>
+#include <bx/rng.h>
+#include <bx/timer.h>
+
+#include <Bvh.h>
+#include <Culling.h>
+#include <Object3D.h>
+#include <Types.h>
+
+
+using namespace zv;
+
+
+// zv-bench-bvh [object count]...
+//
+// Random boxes at a constant density, larger counts make a larger world. Times
+// the SAH build, one frame of moving a tenth of the objects through update()
+// and rebuild(), and frustum culling against the tree and with the linear
+// Culling::cull for comparison. Defaults to 10k, 100k and 1M objects.
+namespace
+{
+    class BenchObject : public Object3D
+    {
+    public:
+        void render(bgfx::Encoder*) const override {}
+        void enqueue(RenderQueue&) const override {}
+
+        bool worldAabb(bx::Aabb& result) const override
+        {
+            result = aabb;
+            return true;
+        }
+
+        bx::Aabb aabb;
+    };
+
+    // Objects per cubic world unit.
+    constexpr f32 Density = 1.0f / 64.0f;
+
+    // As in the app, leaves reinserted per frame.
+    constexpr u32 MaxReinsertions = 32;
+
+    constexpr u32 NumCullRuns = 10;
+
+    f64 toMs(s64 ticks)
+    {
+        return f64(ticks) * 1000.0 / f64(bx::getHPFrequency());
+    }
+
+    vec3 randomPoint(bx::RngMwc& rng, f32 size)
+    {
+        return { (bx::frnd(&rng) - 0.5f) * size, (bx::frnd(&rng) - 0.5f) * size, (bx::frnd(&rng) - 0.5f) * size };
+    }
+
+    void run(u32 numObjects)
+    {
+        bx::RngMwc rng;
+        const f32 worldSize = bx::pow(f32(numObjects) / Density, 1.0f / 3.0f);
+
+        std::vector<std::unique_ptr<BenchObject>> storage;
+        std::vector<Object3D*> objects;
+        storage.reserve(numObjects);
+        objects.reserve(numObjects);
+        for (u32 ii = 0; ii < numObjects; ++ii)
+        {
+            const vec3 center = randomPoint(rng, worldSize);
+            const f32 halfSize = 0.25f + bx::frnd(&rng) * 0.75f;
+
+            storage.push_back(std::make_unique<BenchObject>());
+            storage.back()->aabb = { bx::sub(center, halfSize), bx::add(center, halfSize) };
+            objects.push_back(storage.back().get());
+        }
+
+        Bvh bvh;
+        std::vector<s32> proxies;
+
+        s64 start = bx::getHPCounter();
+        bvh.build(objects, proxies);
+        const f64 buildMs = toMs(bx::getHPCounter() - start);
+
+        // Small moves mostly stay within the fattened leaves, the rest gets refitted.
+        const u32 numMoved = numObjects / 10;
+        start = bx::getHPCounter();
+        for (u32 ii = 0; ii < numMoved; ++ii)
+        {
+            const u32 index = bx::min(u32(bx::frnd(&rng) * numObjects), numObjects - 1);
+            const vec3 offset = randomPoint(rng, 1.0f);
+
+            bx::Aabb& aabb = storage[index]->aabb;
+            aabb = { bx::add(aabb.min, offset), bx::add(aabb.max, offset) };
+            bvh.update(proxies[index]);
+        }
+        bvh.rebuild(MaxReinsertions);
+        const f64 refitMs = toMs(bx::getHPCounter() - start);
+
+        // From the center of the world, the far plane keeps the visible count independent of the size.
+        f32 view[16];
+        f32 proj[16];
+        f32 viewProj[16];
+        bx::mtxLookAt(view, { 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 1.0f });
+        bx::mtxProj(proj, 60.0f, 16.0f / 9.0f, 0.1f, 100.0f, false);
+        bx::mtxMul(viewProj, view, proj);
+        const Frustum frustum = Frustum::fromViewProj(viewProj, false);
+
+        std::vector<Object3D*> visible;
+        visible.reserve(numObjects);
+
+        start = bx::getHPCounter();
+        for (u32 ii = 0; ii < NumCullRuns; ++ii)
+        {
+            visible.clear();
+            bvh.cull(frustum, visible);
+        }
+        const f64 cullMs = toMs(bx::getHPCounter() - start) / NumCullRuns;
+        const size_t numVisible = visible.size();
+
+        start = bx::getHPCounter();
+        for (u32 ii = 0; ii < NumCullRuns; ++ii)
+        {
+            visible.clear();
+            Culling::cull(frustum, objects, visible);
+        }
+        const f64 linearMs = toMs(bx::getHPCounter() - start) / NumCullRuns;
+
+        std::cout << std::setw(9) << numObjects
+            << std::setw(12) << buildMs
+            << std::setw(8) << bvh.height()
+            << std::setw(12) << refitMs
+            << std::setw(12) << cullMs
+            << std::setw(13) << linearMs
+            << std::setw(10) << numVisible << "\n";
+    }
+}
+
+
+int main(int argc, char* argv[])
+{
+    std::vector<u32> counts;
+    for (int ii = 1; ii < argc; ++ii)
+    {
+        counts.push_back(u32(std::strtoul(argv[ii], NULL, 10)));
+    }
+    if (counts.empty())
+    {
+        counts = { 10000, 100000, 1000000 };
+    }
+
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "  objects    build ms  height    refit ms     cull ms    linear ms   visible\n";
+    for (const u32 count : counts)
+    {
+        if (0 != count)
+            run(count);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,226 @@
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <bx/math.h>
+
+#include <IndexOptimizer.h>
+#include <Types.h>
+
+
+using namespace zv;
+
+
+// zv-test-index-optimizer
+//
+// Runs IndexOptimizer on generated meshes and checks that every pass keeps
+// the triangles, that the vertex cache efficiency improves and that Tipsify's
+// order is cut into clusters the overdraw pass can sort. Prints the ACMR of
+// each mesh as generated and as optimized. Exits with a failure when any
+// check doesn't hold.
+namespace
+{
+    struct Position
+    {
+        f32 x;
+        f32 y;
+        f32 z;
+    };
+
+    struct Mesh
+    {
+        std::vector<Position> vertices;
+        std::vector<u32> indices;
+    };
+
+    u32 s_NumChecks = 0;
+    u32 s_NumFailed = 0;
+
+    void check(bool _passed, const std::string& _name)
+    {
+        ++s_NumChecks;
+        if (!_passed)
+        {
+            std::cout << "FAILED: " << _name << "\n";
+            ++s_NumFailed;
+        }
+    }
+
+    // Row by row like PlaneGeometry, _height bends it into terrain.
+    Mesh grid(u32 _segments, f32 _height = 0.0f)
+    {
+        Mesh mesh;
+        for (u32 iy = 0; iy <= _segments; ++iy)
+        {
+            for (u32 ix = 0; ix <= _segments; ++ix)
+            {
+                const f32 x = f32(ix) / f32(_segments) * 2.0f - 1.0f;
+                const f32 y = f32(iy) / f32(_segments) * 2.0f - 1.0f;
+                mesh.vertices.push_back({ x, y, _height * bx::sin(x * 7.0f) * bx::cos(y * 5.0f) });
+            }
+        }
+
+        for (u32 iy = 0; iy < _segments; ++iy)
+        {
+            for (u32 ix = 0; ix < _segments; ++ix)
+            {
+                const u32 a = ix + (_segments + 1) * iy;
+                const u32 b = ix + (_segments + 1) * (iy + 1);
+                mesh.indices.insert(mesh.indices.end(), { a, b, a + 1, b, b + 1, a + 1 });
+            }
+        }
+        return mesh;
+    }
+
+    // Six faces of four vertices each, no vertex shared between faces.
+    Mesh cube()
+    {
+        Mesh mesh;
+        for (u32 axis = 0; axis < 3; ++axis)
+        {
+            for (const f32 side : { -1.0f, 1.0f })
+            {
+                const u32 first = u32(mesh.vertices.size());
+                for (u32 corner = 0; corner < 4; ++corner)
+                {
+                    f32 xyz[3];
+                    xyz[axis] = side;
+                    xyz[(axis + 1) % 3] = 0 != (corner & 1) ? 1.0f : -1.0f;
+                    xyz[(axis + 2) % 3] = 0 != (corner & 2) ? 1.0f : -1.0f;
+                    mesh.vertices.push_back({ xyz[0], xyz[1], xyz[2] });
+                }
+                mesh.indices.insert(mesh.indices.end(), { first, first + 1, first + 2, first + 2, first + 1, first + 3 });
+            }
+        }
+        return mesh;
+    }
+
+    // Triangles by position, rotated to start at their smallest vertex so the winding is kept.
+    std::vector<std::array<f32, 9>> triangles(const Mesh& _mesh)
+    {
+        std::vector<std::array<f32, 9>> result;
+        for (size_t ii = 0; ii + 2 < _mesh.indices.size(); ii += 3)
+        {
+            std::array<std::array<f32, 3>, 3> corners;
+            for (u32 jj = 0; jj < 3; ++jj)
+            {
+                const Position& position = _mesh.vertices[_mesh.indices[ii + jj]];
+                corners[jj] = { position.x, position.y, position.z };
+            }
+
+            const u32 first = u32(std::min_element(corners.begin(), corners.end()) - corners.begin());
+            std::array<f32, 9> triangle;
+            for (u32 jj = 0; jj < 3; ++jj)
+            {
+                std::copy(corners[(first + jj) % 3].begin(), corners[(first + jj) % 3].end(), triangle.begin() + jj * 3);
+            }
+            result.push_back(triangle);
+        }
+
+        std::sort(result.begin(), result.end());
+        return result;
+    }
+
+    f32 acmr(const Mesh& _mesh)
+    {
+        return IndexOptimizer::analyze(_mesh.indices.data(), u32(_mesh.indices.size()), u32(_mesh.vertices.size())).acmr();
+    }
+
+    u32 numClusters(Mesh _mesh)
+    {
+        std::vector<u32> clusters;
+        IndexOptimizer::optimizeVertexCache(_mesh.indices.data(), u32(_mesh.indices.size()), u32(_mesh.vertices.size()), IndexOptimizer::CacheSize, &clusters);
+        return u32(clusters.size());
+    }
+
+    // Returns the optimized mesh after checking it still draws the same triangles.
+    Mesh optimize(const std::string& _name, const Mesh& _mesh)
+    {
+        Mesh optimized = _mesh;
+        const u32 numVertices = IndexOptimizer::optimize(optimized.vertices.data(), u32(optimized.vertices.size()), u32(sizeof(Position)),
+            optimized.indices.data(), u32(optimized.indices.size()));
+        optimized.vertices.resize(numVertices);
+
+        check(triangles(optimized) == triangles(_mesh), _name + ", same triangles");
+        check(numVertices == _mesh.vertices.size(), _name + ", every vertex kept");
+
+        std::cout << std::fixed << std::setprecision(3)
+            << _name << ": " << _mesh.indices.size() / 3 << " triangles, " << numClusters(_mesh) << " clusters, ACMR "
+            << acmr(_mesh) << " -> " << acmr(optimized) << "\n";
+        return optimized;
+    }
+
+    void testGrid()
+    {
+        const Mesh mesh = grid(100);
+        const Mesh optimized = optimize("100x100 grid", mesh);
+
+        // Row by row every triangle misses about one vertex, Tipsify fans around them instead.
+        check(acmr(mesh) > 0.95f, "100x100 grid, generated ACMR");
+        check(acmr(optimized) < 0.7f, "100x100 grid, optimized ACMR");
+
+        // One connected part, only the soft split cuts it.
+        check(numClusters(mesh) > 1, "100x100 grid, split into clusters");
+
+        // Cuts cost some cache efficiency, bounded by the threshold.
+        Mesh uncut = mesh;
+        IndexOptimizer::optimizeVertexCache(uncut.indices.data(), u32(uncut.indices.size()), u32(uncut.vertices.size()));
+        check(acmr(uncut) <= acmr(optimized), "100x100 grid, uncut order at least as cache friendly");
+        check(acmr(optimized) <= IndexOptimizer::ClusterThreshold + 0.05f, "100x100 grid, ACMR near the threshold");
+    }
+
+    void testTerrain()
+    {
+        const Mesh mesh = grid(64, 0.3f);
+        optimize("64x64 terrain", mesh);
+
+        // Clusters face different ways, sorting them has to move some.
+        Mesh cached = mesh;
+        std::vector<u32> clusters;
+        IndexOptimizer::optimizeVertexCache(cached.indices.data(), u32(cached.indices.size()), u32(cached.vertices.size()), IndexOptimizer::CacheSize, &clusters);
+
+        Mesh sorted = cached;
+        IndexOptimizer::optimizeOverdraw(sorted.indices.data(), u32(sorted.indices.size()), sorted.vertices.data(), u32(sizeof(Position)), clusters);
+        check(sorted.indices != cached.indices, "64x64 terrain, overdraw pass reorders clusters");
+        check(triangles(sorted) == triangles(cached), "64x64 terrain, overdraw pass keeps the triangles");
+    }
+
+    void testCube()
+    {
+        const Mesh mesh = cube();
+        optimize("cube", mesh);
+
+        // Faces share no vertices, every one starts cold and is a cluster of its own.
+        check(6 == numClusters(mesh), "cube, a cluster per face");
+    }
+
+    void testUnused()
+    {
+        Mesh mesh = grid(4);
+        mesh.vertices.push_back({ 5.0f, 5.0f, 5.0f });
+
+        Mesh optimized = mesh;
+        const u32 numVertices = IndexOptimizer::optimize(optimized.vertices.data(), u32(optimized.vertices.size()), u32(sizeof(Position)),
+            optimized.indices.data(), u32(optimized.indices.size()));
+        optimized.vertices.resize(numVertices);
+
+        check(numVertices + 1 == mesh.vertices.size(), "unused vertex dropped");
+        check(triangles(optimized) == triangles(mesh), "unused vertex, same triangles");
+    }
+}
+
+
+int main()
+{
+    testGrid();
+    testTerrain();
+    testCube();
+    testUnused();
+
+    std::cout << s_NumChecks - s_NumFailed << " of " << s_NumChecks << " index optimizer checks passed\n";
+    return 0 == s_NumFailed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,143 @@
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include <bx/bounds.h>
+#include <bx/math.h>
+#include <bx/rng.h>
+#include <bx/timer.h>
+
+#include <Occlusion.h>
+#include <Types.h>
+
+
+using namespace zv;
+
+
+// zv-test-occlusion [--bench]
+//
+// Rasterizes a wall in front of the camera and checks which boxes come out
+// hidden or visible. Exits with a failure when any of them is wrong. --bench
+// also times clearing, rasterizing and the Hi-Z build, and box queries.
+namespace
+{
+    // A 20x10 wall at z = 10, centered on the view direction. Boxes behind it
+    // are hidden where they project inside its outline, x / z < 1, y / z < 0.5.
+    constexpr f32 WallZ = 10.0f;
+
+    const f32 s_WallVertices[] = {
+        -10.0f, -5.0f, WallZ,
+         10.0f, -5.0f, WallZ,
+         10.0f,  5.0f, WallZ,
+        -10.0f,  5.0f, WallZ,
+    };
+
+    const u16 s_WallIndices[] = { 0, 2, 1, 0, 3, 2 };
+
+    struct Case
+    {
+        const char* name;
+        bx::Aabb aabb;
+        bool visible;
+    };
+
+    const Case s_Cases[] = {
+        { "behind the wall",               { { -1.0f, -1.0f, 20.0f }, {  1.0f,  1.0f, 22.0f } }, false },
+        { "far behind the wall",           { { -8.0f, -4.0f, 80.0f }, {  8.0f,  4.0f, 90.0f } }, false },
+        { "in front of the wall",          { { -1.0f, -1.0f,  5.0f }, {  1.0f,  1.0f,  6.0f } }, true  },
+        { "crossing the wall",             { { -1.0f, -1.0f,  9.0f }, {  1.0f,  1.0f, 11.0f } }, true  },
+        { "behind, beside the wall",       { { 23.0f, -1.0f, 20.0f }, { 25.0f,  1.0f, 22.0f } }, true  },
+        { "behind, across the wall edge",  { { 18.0f, -1.0f, 20.0f }, { 22.0f,  1.0f, 22.0f } }, true  },
+        { "behind, above the wall",        { { -1.0f, 12.0f, 20.0f }, {  1.0f, 13.0f, 22.0f } }, true  },
+        { "reaching behind the camera",    { { -1.0f, -1.0f, -5.0f }, {  1.0f,  1.0f, 20.0f } }, true  },
+    };
+
+    f64 toMs(s64 ticks)
+    {
+        return f64(ticks) * 1000.0 / f64(bx::getHPFrequency());
+    }
+
+    void setupView(f32* viewProj)
+    {
+        f32 view[16];
+        f32 proj[16];
+        bx::mtxLookAt(view, { 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 1.0f });
+        bx::mtxProj(proj, 60.0f, 2.0f, 0.1f, 100.0f, false);
+        bx::mtxMul(viewProj, view, proj);
+    }
+
+    void drawWall(OcclusionBuffer& buffer, const f32* viewProj)
+    {
+        f32 identity[16];
+        bx::mtxIdentity(identity);
+
+        buffer.clear(viewProj, false);
+        buffer.rasterize(s_WallVertices, 3 * sizeof(f32), s_WallIndices, BX_COUNTOF(s_WallIndices), identity);
+        buffer.buildHiZ();
+    }
+
+    void bench(OcclusionBuffer& buffer, const f32* viewProj)
+    {
+        constexpr u32 NumFrames = 1000;
+        constexpr u32 NumBoxes = 100000;
+
+        s64 start = bx::getHPCounter();
+        for (u32 ii = 0; ii < NumFrames; ++ii)
+        {
+            drawWall(buffer, viewProj);
+        }
+        const f64 drawMs = toMs(bx::getHPCounter() - start) / NumFrames;
+
+        bx::RngMwc rng;
+        std::vector<bx::Aabb> boxes(NumBoxes);
+        for (bx::Aabb& box : boxes)
+        {
+            const vec3 center = { (bx::frnd(&rng) - 0.5f) * 40.0f, (bx::frnd(&rng) - 0.5f) * 20.0f, 1.0f + bx::frnd(&rng) * 90.0f };
+            box = { bx::sub(center, 0.5f), bx::add(center, 0.5f) };
+        }
+
+        u32 numVisible = 0;
+        start = bx::getHPCounter();
+        for (const bx::Aabb& box : boxes)
+        {
+            numVisible += buffer.isVisible(box) ? 1 : 0;
+        }
+        const f64 queryMs = toMs(bx::getHPCounter() - start);
+
+        std::cout << std::fixed << std::setprecision(3)
+            << "Clear, wall and Hi-Z: " << drawMs << " ms, " << buffer.width() << "x" << buffer.height() << "\n"
+            << NumBoxes << " box queries: " << queryMs << " ms, " << numVisible << " visible\n";
+    }
+}
+
+
+int main(int argc, char* argv[])
+{
+    f32 viewProj[16];
+    setupView(viewProj);
+
+    OcclusionBuffer buffer;
+    drawWall(buffer, viewProj);
+
+    u32 numFailed = 0;
+    for (const Case& test : s_Cases)
+    {
+        const bool visible = buffer.isVisible(test.aabb);
+        if (visible != test.visible)
+        {
+            std::cout << "FAILED: " << test.name << ", expected " << (test.visible ? "visible" : "hidden") << "\n";
+            ++numFailed;
+        }
+    }
+
+    std::cout << BX_COUNTOF(s_Cases) - numFailed << " of " << BX_COUNTOF(s_Cases) << " occlusion cases passed\n";
+
+    if (argc > 1 && 0 == std::strcmp(argv[1], "--bench"))
+    {
+        bench(buffer, viewProj);
+    }
+
+    return 0 == numFailed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
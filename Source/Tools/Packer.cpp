@@ -0,0 +1,91 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <Archive.h>
+#include <MappedFile.h>
+#include <Types.h>
+
+
+using namespace zv;
+
+
+// zv-pack [--align <bytes>] [--store] <output.pak> <file or directory>...
+//
+// Directories are walked recursively. Entries are named by the path as given,
+// so run it from the directory the app runs in, e.g. zv-pack Assets.pak Assets.
+int main(int argc, char* argv[])
+{
+    u32 alignment = 16;
+    u32 minSaving = 8;
+    std::vector<std::string> args;
+
+    for (int ii = 1; ii < argc; ++ii)
+    {
+        if (0 == std::strcmp(argv[ii], "--align") && ii + 1 < argc)
+            alignment = u32(std::strtoul(argv[++ii], NULL, 10));
+        else if (0 == std::strcmp(argv[ii], "--store"))
+            minSaving = 0;
+        else
+            args.emplace_back(argv[ii]);
+    }
+
+    if (args.size() < 2)
+    {
+        std::cout << "Usage: zv-pack [--align <bytes>] [--store] <output.pak> <file or directory>...\n";
+        return EXIT_FAILURE;
+    }
+
+    // Sorted so the same inputs always produce the same archive.
+    std::vector<std::string> paths;
+    for (size_t ii = 1; ii < args.size(); ++ii)
+    {
+        const std::filesystem::path input(args[ii]);
+        if (std::filesystem::is_directory(input))
+        {
+            for (const auto& item : std::filesystem::recursive_directory_iterator(input))
+            {
+                if (item.is_regular_file())
+                    paths.push_back(item.path().generic_string());
+            }
+        }
+        else
+        {
+            paths.push_back(input.generic_string());
+        }
+    }
+    std::sort(paths.begin(), paths.end());
+
+    ArchiveBuilder builder(alignment);
+    u64 inputSize = 0;
+    for (const std::string& path : paths)
+    {
+        MappedFile file;
+        if (!file.open(path.c_str()))
+        {
+            // Empty files can't be mapped and aren't worth an entry.
+            std::cout << "Skipping: " << path << "\n";
+            continue;
+        }
+
+        if (!builder.add(path.c_str(), file.data(), file.size(), minSaving))
+        {
+            std::cout << "Path hash collision: " << path << "\n";
+            return EXIT_FAILURE;
+        }
+        inputSize += file.size();
+    }
+
+    if (!builder.write(args[0].c_str()))
+    {
+        std::cout << "Failed to write: " << args[0] << "\n";
+        return EXIT_FAILURE;
+    }
+
+    std::cout << "Packed " << builder.numEntries() << " files, " << inputSize << " bytes, into " << args[0] << "\n";
+    return EXIT_SUCCESS;
+}
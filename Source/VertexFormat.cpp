@@ -0,0 +1,232 @@
+#include <VertexFormat.h>
+
+
+#include <cstring>
+
+#include <bx/debug.h>
+#include <bx/math.h>
+#include <bx/pixelformat.h>
+
+
+namespace zv
+{
+	namespace
+	{
+		// A direction packed like encodeNormalRgba8, w into _w.
+		vec3 unpackDirection(u32 _packed, f32& _w)
+		{
+			f32 value[4];
+			bx::unpackRgba8(value, &_packed);
+			_w = value[3] * 2.0f - 1.0f;
+			return { value[0] * 2.0f - 1.0f, value[1] * 2.0f - 1.0f, value[2] * 2.0f - 1.0f };
+		}
+
+		// [-1, 1] to a byte the shaders read as unorm, and back.
+		u8 toUnorm8(f32 _value)
+		{
+			return u8(bx::round(bx::clamp(_value * 0.5f + 0.5f, 0.0f, 1.0f) * 255.0f));
+		}
+
+		f32 fromUnorm8(u8 _value)
+		{
+			return f32(_value) / 255.0f * 2.0f - 1.0f;
+		}
+
+		// Same as octDecode() in Shaders/vertex.sh.
+		vec3 octDecode(f32 _x, f32 _y)
+		{
+			vec3 normal = { _x, _y, 1.0f - bx::abs(_x) - bx::abs(_y) };
+			const f32 fold = bx::max(-normal.z, 0.0f);
+			normal.x += normal.x >= 0.0f ? -fold : fold;
+			normal.y += normal.y >= 0.0f ? -fold : fold;
+			return bx::normalize(normal);
+		}
+
+		// Same as in decodeTangentFrame(), Duff et al. 2017, "Building an Orthonormal Basis, Revisited".
+		void orthonormalBasis(const vec3& _normal, vec3& _b1, vec3& _b2)
+		{
+			const f32 flip = _normal.z >= 0.0f ? 1.0f : -1.0f;
+			const f32 a = -1.0f / (flip + _normal.z);
+			const f32 b = _normal.x * _normal.y * a;
+			_b1 = { 1.0f + flip * _normal.x * _normal.x * a, flip * b, -flip * _normal.x };
+			_b2 = { b, flip + _normal.y * _normal.y * a, -_normal.y };
+		}
+
+		void addPosition(bgfx::VertexLayout& _layout, const PositionFloat&)
+		{
+			_layout.add(bgfx::Attrib::Position, 3, bgfx::AttribType::Float);
+		}
+
+		void addPosition(bgfx::VertexLayout& _layout, const PositionHalf&)
+		{
+			_layout.add(bgfx::Attrib::Position, 4, bgfx::AttribType::Half);
+		}
+
+		void addPosition(bgfx::VertexLayout& _layout, const PositionSnorm16&)
+		{
+			_layout.add(bgfx::Attrib::Position, 4, bgfx::AttribType::Int16, true);
+		}
+
+		// _position is already mapped through the inverse of the dequantization.
+		void encodePosition(const vec3& _position, PositionFloat& _result)
+		{
+			_result = { _position.x, _position.y, _position.z };
+		}
+
+		void encodePosition(const vec3& _position, PositionHalf& _result)
+		{
+			_result = {
+				bx::halfFromFloat(bx::clamp(_position.x, -1.0f, 1.0f)),
+				bx::halfFromFloat(bx::clamp(_position.y, -1.0f, 1.0f)),
+				bx::halfFromFloat(bx::clamp(_position.z, -1.0f, 1.0f)),
+				bx::halfFromFloat(1.0f),
+			};
+		}
+
+		void encodePosition(const vec3& _position, PositionSnorm16& _result)
+		{
+			auto snorm16 = [](f32 _value)
+			{
+				return s16(bx::round(bx::clamp(_value, -1.0f, 1.0f) * 32767.0f));
+			};
+			_result = { snorm16(_position.x), snorm16(_position.y), snorm16(_position.z), 32767 };
+		}
+	}
+
+
+	template <typename PositionT>
+	bgfx::VertexLayout VertexFormat<PositionT>::s_Layout;
+
+	template <typename PositionT>
+	bgfx::VertexLayout VertexFormat<PositionT>::s_PositionLayout;
+
+	template <typename PositionT>
+	void VertexFormat<PositionT>::init()
+	{
+		s_Layout.begin();
+		addPosition(s_Layout, PositionT{});
+		s_Layout
+			.add(bgfx::Attrib::Normal, 4, bgfx::AttribType::Uint8, true)
+			.add(bgfx::Attrib::TexCoord0, 2, bgfx::AttribType::Int16, true, true)
+			.end();
+
+		s_PositionLayout.begin();
+		addPosition(s_PositionLayout, PositionT{});
+		s_PositionLayout.end();
+	}
+
+	template <typename PositionT>
+	PositionDequant VertexFormat<PositionT>::dequant(const bx::Aabb& _aabb)
+	{
+		PositionDequant dequant;
+		if (!Quantized)
+			return dequant;
+
+		const vec3 center = bx::mul(bx::add(_aabb.min, _aabb.max), 0.5f);
+		const vec3 extent = bx::mul(bx::sub(_aabb.max, _aabb.min), 0.5f);
+
+		// Flat along an axis, the offset alone places it.
+		dequant.scale[0] = 0.0f < extent.x ? extent.x : 1.0f;
+		dequant.scale[1] = 0.0f < extent.y ? extent.y : 1.0f;
+		dequant.scale[2] = 0.0f < extent.z ? extent.z : 1.0f;
+		dequant.offset[0] = center.x;
+		dequant.offset[1] = center.y;
+		dequant.offset[2] = center.z;
+		return dequant;
+	}
+
+	template <typename PositionT>
+	void VertexFormat<PositionT>::encode(const std::vector<Vertex>& _vertices, const PositionDequant& _dequant, Packed* _packed, PositionT* _positions)
+	{
+		for (size_t ii = 0; ii < _vertices.size(); ++ii)
+		{
+			const Vertex& vertex = _vertices[ii];
+
+			const vec3 position = {
+				(vertex.x - _dequant.offset[0]) / _dequant.scale[0],
+				(vertex.y - _dequant.offset[1]) / _dequant.scale[1],
+				(vertex.z - _dequant.offset[2]) / _dequant.scale[2],
+			};
+			encodePosition(position, _positions[ii]);
+
+			f32 unused;
+			f32 handedness;
+			const vec3 normal = unpackDirection(vertex.normal, unused);
+			const vec3 tangent = unpackDirection(vertex.tangent, handedness);
+
+			_packed[ii] = Packed{ _positions[ii], encodeTangentFrame(normal, tangent, handedness), vertex.u, vertex.v };
+		}
+	}
+
+	u32 encodeTangentFrame(const vec3& _normal, const vec3& _tangent, f32 _handedness)
+	{
+		// Onto the octahedron, the lower half folded over the upper one.
+		const f32 length = bx::abs(_normal.x) + bx::abs(_normal.y) + bx::abs(_normal.z);
+		f32 octX = 0.0f < length ? _normal.x / length : 0.0f;
+		f32 octY = 0.0f < length ? _normal.y / length : 0.0f;
+		if (0.0f > _normal.z)
+		{
+			const f32 x = octX;
+			octX = (1.0f - bx::abs(octY)) * (x >= 0.0f ? 1.0f : -1.0f);
+			octY = (1.0f - bx::abs(x)) * (octY >= 0.0f ? 1.0f : -1.0f);
+		}
+
+		u8 frame[4];
+		frame[0] = toUnorm8(octX);
+		frame[1] = toUnorm8(octY);
+
+		// Around the normal the shader decodes, the exact one may pick a different basis.
+		vec3 b1;
+		vec3 b2;
+		orthonormalBasis(octDecode(fromUnorm8(frame[0]), fromUnorm8(frame[1])), b1, b2);
+		frame[2] = toUnorm8(bx::atan2(bx::dot(_tangent, b2), bx::dot(_tangent, b1)) / bx::kPi);
+		frame[3] = 0.0f > _handedness ? 0 : 255;
+
+		u32 result;
+		memcpy(&result, frame, sizeof(result));
+		return result;
+	}
+
+	u32 VertexFormats::s_Active = ZV_VERTEX_FORMAT_FLOAT;
+
+	void VertexFormats::init()
+	{
+		s_Active = ZV_CONFIG_VERTEX_FORMAT;
+		if (ZV_VERTEX_FORMAT_HALF == s_Active && 0 == (bgfx::getCaps()->supported & BGFX_CAPS_VERTEX_ATTRIB_HALF))
+		{
+			bx::debugPrintf("Half vertex attributes aren't supported, positions are stored as float\n");
+			s_Active = ZV_VERTEX_FORMAT_FLOAT;
+		}
+
+		switch (s_Active)
+		{
+		case ZV_VERTEX_FORMAT_HALF:    VertexFormat<PositionHalf>::init();    break;
+		case ZV_VERTEX_FORMAT_SNORM16: VertexFormat<PositionSnorm16>::init(); break;
+		default:                       VertexFormat<PositionFloat>::init();   break;
+		}
+	}
+
+	const bgfx::VertexLayout& VertexFormats::layout()
+	{
+		switch (s_Active)
+		{
+		case ZV_VERTEX_FORMAT_HALF:    return VertexFormat<PositionHalf>::s_Layout;
+		case ZV_VERTEX_FORMAT_SNORM16: return VertexFormat<PositionSnorm16>::s_Layout;
+		default:                       return VertexFormat<PositionFloat>::s_Layout;
+		}
+	}
+
+	const bgfx::VertexLayout& VertexFormats::positionLayout()
+	{
+		switch (s_Active)
+		{
+		case ZV_VERTEX_FORMAT_HALF:    return VertexFormat<PositionHalf>::s_PositionLayout;
+		case ZV_VERTEX_FORMAT_SNORM16: return VertexFormat<PositionSnorm16>::s_PositionLayout;
+		default:                       return VertexFormat<PositionFloat>::s_PositionLayout;
+		}
+	}
+
+	template class VertexFormat<PositionFloat>;
+	template class VertexFormat<PositionHalf>;
+	template class VertexFormat<PositionSnorm16>;
+}
@@ -0,0 +1,145 @@
+#pragma once
+
+
+#include <type_traits>
+#include <vector>
+
+#include <bgfx/bgfx.h>
+#include <bx/bounds.h>
+
+#include <Types.h>
+
+
+// Position encoding of the vertex buffers, the build picks it with ZV_VERTEX_FORMAT, see VertexFormats.
+#define ZV_VERTEX_FORMAT_FLOAT   0
+#define ZV_VERTEX_FORMAT_HALF    1
+#define ZV_VERTEX_FORMAT_SNORM16 2
+
+#ifndef ZV_CONFIG_VERTEX_FORMAT
+#   define ZV_CONFIG_VERTEX_FORMAT ZV_VERTEX_FORMAT_FLOAT
+#endif // ZV_CONFIG_VERTEX_FORMAT
+
+
+namespace zv
+{
+	// What geometries are generated in and the CPU side works with, full precision.
+	// Normal and tangent are packed like encodeNormalRgba8, tangent w is the handedness.
+	struct Vertex
+	{
+		f32 x;
+		f32 y;
+		f32 z;
+		u32 normal;
+		u32 tangent;
+		s16 u;
+		s16 v;
+	};
+
+	// Maps stored positions back to object space, position * scale + offset. The
+	// vertex shaders apply it as u_vertexDequant, see Shaders/vertex.sh.
+	struct PositionDequant
+	{
+		f32 scale[4]{ 1.0f, 1.0f, 1.0f, 0.0f };
+		f32 offset[4]{ 0.0f, 0.0f, 0.0f, 0.0f };
+	};
+
+	// 12 bytes, stored as is.
+	struct PositionFloat
+	{
+		f32 x;
+		f32 y;
+		f32 z;
+	};
+
+	// 8 bytes, relative to the bounds, needs BGFX_CAPS_VERTEX_ATTRIB_HALF. w pads,
+	// D3D has no three component 16-bit formats.
+	struct PositionHalf
+	{
+		u16 x;
+		u16 y;
+		u16 z;
+		u16 w;
+	};
+
+	// 8 bytes, relative to the bounds, 15 bits per axis.
+	struct PositionSnorm16
+	{
+		s16 x;
+		s16 y;
+		s16 z;
+		s16 w;
+	};
+
+	/*
+	Vertex buffer contents in one of the position encodings, encoded from Vertex
+	when a Geometry uploads.
+
+	Every format feeds the same a_position, a_normal and a_texcoord0, so one set
+	of shaders reads all of them. a_normal holds the whole tangent frame in four
+	bytes: the octahedral normal, the tangent's angle around it and the
+	handedness. Half and 16-bit positions are stored in [-1, 1] across the
+	geometry's bounds and scaled back with its PositionDequant.
+
+	Float vertices are 20 bytes and quantized ones 16. Depth only passes bind
+	a second stream with just the positions, 12 or 8 bytes per vertex.
+	*/
+	template <typename PositionT>
+	class VertexFormat
+	{
+	private:
+		VertexFormat() = default;
+
+	public:
+		using Position = PositionT;
+
+		struct Packed
+		{
+			PositionT position;
+			u32 frame;
+			s16 u;
+			s16 v;
+		};
+
+		static constexpr bool Quantized = !std::is_same<PositionT, PositionFloat>::value;
+
+		// Builds s_Layout and s_PositionLayout, VertexFormats::init() does it for the active format.
+		static void init();
+
+		// Identity for float positions, otherwise the one spanning _aabb.
+		static PositionDequant dequant(const bx::Aabb& _aabb);
+
+		// Fills the full and the position only stream, both with room for _vertices.size().
+		static void encode(const std::vector<Vertex>& _vertices, const PositionDequant& _dequant, Packed* _packed, PositionT* _positions);
+
+		static bgfx::VertexLayout s_Layout;
+		static bgfx::VertexLayout s_PositionLayout;
+	};
+
+	/*
+	The position encoding every geometry uploads in. The build picks it with
+	ZV_CONFIG_VERTEX_FORMAT, half positions fall back to float on renderers
+	without BGFX_CAPS_VERTEX_ATTRIB_HALF. The shaders read both the same way.
+	*/
+	class VertexFormats
+	{
+	private:
+		VertexFormats() = default;
+
+	public:
+		// Picks the format and builds its layouts, Renderer::init() does it once after bgfx::init().
+		static void init();
+
+		// One of ZV_VERTEX_FORMAT_*.
+		static u32 active() { return s_Active; }
+
+		static const bgfx::VertexLayout& layout();
+		static const bgfx::VertexLayout& positionLayout();
+
+	private:
+		static u32 s_Active;
+	};
+
+	// Four bytes: octahedral normal in x and y, tangent angle around it in z, handedness in w.
+	// The shaders decode it in decodeTangentFrame().
+	u32 encodeTangentFrame(const vec3& _normal, const vec3& _tangent, f32 _handedness);
+}
@@ -0,0 +1,155 @@
+#include <Vfs.h>
+
+
+namespace zv
+{
+	std::vector<std::unique_ptr<Archive>> Vfs::s_Archives;
+
+
+	bool Vfs::mount(const char* _archivePath)
+	{
+		std::unique_ptr<Archive> archive = std::make_unique<Archive>();
+		if (!archive->open(_archivePath))
+			return false;
+
+		s_Archives.emplace_back(std::move(archive));
+		return true;
+	}
+
+	void Vfs::unmountAll()
+	{
+		s_Archives.clear();
+	}
+
+	const ArchiveEntry* Vfs::find(const char* _path, const Archive** _archive)
+	{
+		for (auto it = s_Archives.rbegin(); it != s_Archives.rend(); ++it)
+		{
+			const ArchiveEntry* entry = (*it)->find(_path);
+			if (NULL != entry)
+			{
+				*_archive = it->get();
+				return entry;
+			}
+		}
+
+		return NULL;
+	}
+
+
+	bool AssetFile::open(const char* _filePath)
+	{
+		if (openArchived(_filePath))
+			return true;
+
+		if (!m_file.open(_filePath))
+			return false;
+
+		m_pData = m_file.data();
+		m_size = m_file.size();
+		return true;
+	}
+
+	bool AssetFile::openArchived(const char* _filePath)
+	{
+		close();
+
+		const Archive* archive = NULL;
+		const ArchiveEntry* entry = Vfs::find(_filePath, &archive);
+		if (NULL == entry)
+			return false;
+
+		if (0 == (entry->flags & Archive::EntryCompressed))
+		{
+			m_pData = archive->data(*entry);
+			m_size = entry->size;
+			return true;
+		}
+
+		m_inflated.resize(entry->originalSize);
+		if (!archive->read(*entry, m_inflated.data()))
+		{
+			m_inflated.clear();
+			return false;
+		}
+
+		m_pData = m_inflated.data();
+		m_size = entry->originalSize;
+		return true;
+	}
+
+	void AssetFile::close()
+	{
+		m_file.close();
+		m_inflated.clear();
+		m_inflated.shrink_to_fit();
+		m_pData = NULL;
+		m_size = 0;
+	}
+
+	void AssetFile::releaseCb(void* _ptr, void* _userData)
+	{
+		BX_UNUSED(_ptr);
+		delete (AssetFile*)_userData;
+	}
+
+
+	bool VfsFileReader::open(const bx::FilePath& _filePath, bx::Error* _err)
+	{
+		close();
+
+		if (m_asset.openArchived(_filePath.getCPtr()))
+			return true;
+
+		m_isLoose = m_loose.open(_filePath, _err);
+		return m_isLoose;
+	}
+
+	void VfsFileReader::close()
+	{
+		if (m_isLoose)
+		{
+			m_loose.close();
+			m_isLoose = false;
+		}
+
+		m_asset.close();
+		m_offset = 0;
+	}
+
+	s64 VfsFileReader::seek(s64 _offset, bx::Whence::Enum _whence)
+	{
+		if (m_isLoose)
+			return m_loose.seek(_offset, _whence);
+
+		switch (_whence)
+		{
+		case bx::Whence::Begin:   m_offset = _offset; break;
+		case bx::Whence::Current: m_offset += _offset; break;
+		case bx::Whence::End:     m_offset = s64(m_asset.size()) + _offset; break;
+		}
+
+		m_offset = bx::clamp<s64>(m_offset, 0, m_asset.size());
+		return m_offset;
+	}
+
+	s32 VfsFileReader::read(void* _data, s32 _size, bx::Error* _err)
+	{
+		if (m_isLoose)
+			return m_loose.read(_data, _size, _err);
+
+		const s32 size = s32(bx::min<s64>(_size, s64(m_asset.size()) - m_offset));
+		if (size > 0)
+		{
+			bx::memCopy(_data, m_asset.data() + m_offset, size);
+			m_offset += size;
+		}
+
+		if (size != _size)
+		{
+			BX_ERROR_SET(_err, bx::kErrorReaderWriterEof, "VfsFileReader: EOF.");
+		}
+
+		return bx::max(size, 0);
+	}
+}
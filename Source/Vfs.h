@@ -0,0 +1,85 @@
+#pragma once
+
+
+#include <memory>
+#include <vector>
+
+#include <bx/file.h>
+
+#include <Archive.h>
+#include <MappedFile.h>
+#include <Types.h>
+
+
+namespace zv
+{
+	/*
+	Resolves asset paths against the mounted archives first, then the loose
+	files on disk. Mount before the first load, lookups aren't synchronized
+	with mount and unmount.
+	*/
+	class Vfs
+	{
+	private:
+		Vfs() = default;
+
+	public:
+		// Archives mounted later shadow the ones mounted before them.
+		static bool mount(const char* _archivePath);
+		static void unmountAll();
+
+		// NULL when no mounted archive holds the path.
+		static const ArchiveEntry* find(const char* _path, const Archive** _archive);
+
+	private:
+		static std::vector<std::unique_ptr<Archive>> s_Archives;
+	};
+
+	// The bytes of one asset. Uncompressed archive entries point into the
+	// archive mapping, compressed ones are inflated onto the heap and loose
+	// files are mapped on their own.
+	class AssetFile
+	{
+	public:
+		AssetFile() = default;
+		~AssetFile() = default;
+
+		AssetFile(const AssetFile&) = delete;
+		AssetFile& operator=(const AssetFile&) = delete;
+
+	public:
+		bool open(const char* _filePath);
+		bool openArchived(const char* _filePath);
+		void close();
+
+		bool isOpen() const { return NULL != m_pData; }
+		const u8* data() const { return m_pData; }
+		u32 size() const { return m_size; }
+
+		// bgfx::ReleaseFn for a heap allocated AssetFile passed as user data.
+		static void releaseCb(void* _ptr, void* _userData);
+
+	private:
+		MappedFile m_file;
+		std::vector<u8> m_inflated{};
+
+		const u8* m_pData{ NULL };
+		u32 m_size{ 0 };
+	};
+
+	// bx reader over the Vfs, falls back to bx::FileReader for loose files.
+	class VfsFileReader : public bx::FileReaderI
+	{
+	public:
+		bool open(const bx::FilePath& _filePath, bx::Error* _err) override;
+		void close() override;
+		s64 seek(s64 _offset = 0, bx::Whence::Enum _whence = bx::Whence::Current) override;
+		s32 read(void* _data, s32 _size, bx::Error* _err) override;
+
+	private:
+		AssetFile m_asset;
+		bx::FileReader m_loose;
+		bool m_isLoose{ false };
+		s64 m_offset{ 0 };
+	};
+}
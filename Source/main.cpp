@@ -1,5 +1,7 @@
 #include <iostream>
 #include <memory>
+#include <utility>
+#include <vector>
 
 #define SDL_MAIN_HANDLED
 #include <SDL.h>
@@ -7,6 +9,7 @@
 
 #include <bgfx/bgfx.h>
 #include <bgfx/platform.h>
+#include <bx/commandline.h>
 #include <bx/math.h>
 #include <bx/timer.h>
 
@@ -14,26 +17,68 @@
 #include <backends/imgui_impl_sdl2.h>
 #include <imgui_impl_bgfx.h>
 
+#include <Bvh.h>
 #include <Camera.h>
+#include <Culling.h>
 #include <Geometries.h>
 #include <Materials.h>
+#include <InstancedMesh.h>
 #include <Input.h>
 #include <Loading.h>
 #include <Mesh.h>
+#include <Occlusion.h>
+#include <PipelineCache.h>
+#include <Renderer.h>
+#include <ShaderPermutation.h>
+#include <ShaderReloader.h>
+#include <StaticBatch.h>
+#include <TextureResidency.h>
+#include <TextureStreamer.h>
+#include <RenderQueue.h>
 #include <Types.h>
 #include <Utils.h>
+#include <Vfs.h>
 
 
 using namespace zv;
 
 
+#ifndef ZV_CONFIG_RENDER_THREAD
+#   define ZV_CONFIG_RENDER_THREAD 0
+#endif // ZV_CONFIG_RENDER_THREAD
+
+// Set by the build when it compiles the assets, --shader-source and --shaderc override them.
+#ifndef ZV_SHADER_SOURCE_DIR
+#   define ZV_SHADER_SOURCE_DIR "Source/Shaders"
+#endif // ZV_SHADER_SOURCE_DIR
+
+#ifndef ZV_SHADERC_PATH
+#   define ZV_SHADERC_PATH NULL
+#endif // ZV_SHADERC_PATH
+
+
 int main(int argc, char* argv[])
 {
+    // The build picks the default, --render-thread / --single-thread override it.
+    const bx::CommandLine cmdLine(argc, argv);
+    const s64 startTime = bx::getHPCounter();
+    bool renderThread = 0 != ZV_CONFIG_RENDER_THREAD;
+    if (cmdLine.hasArg("render-thread"))
+        renderThread = true;
+    if (cmdLine.hasArg("single-thread"))
+        renderThread = false;
+
     ///////////////////
     // Init Window
 
     LoadingManager::init();
 
+    // Assets come from the pack when there is one, see zv-pack. Paths it doesn't
+    // hold fall back to loose files.
+    const char* packPath = cmdLine.findOption("pack", "Assets.pak");
+    if (Vfs::mount(packPath))
+        std::cout << "Mounted " << packPath << "\n";
+
     if (SDL_Init(SDL_INIT_VIDEO) < 0) {
         std::cout << "SDL could not initialize. SDL_Error: " << SDL_GetError() << "\n";
         return 1;
@@ -62,7 +107,13 @@ int main(int argc, char* argv[])
         std::cout << "SDL_SysWMinfo could not be retrieved. SDL_Error: " << SDL_GetError() << "\n";
         return 1;
     }
-    bgfx::renderFrame(); // single threaded mode
+
+    // Calling renderFrame before init keeps the backend on this thread. Without it
+    // bgfx spawns its own render thread, and bgfx::frame() only hands the frame over.
+    // Every bgfx::makeRef must then stay valid until its release callback fires
+    // (see Geometry::initializeBuffers), which can be up to two frames later.
+    if (!renderThread)
+        bgfx::renderFrame(); // single threaded mode
 #endif
 
     bgfx::PlatformData pd{};
@@ -83,12 +134,40 @@ int main(int argc, char* argv[])
     bgfx_init.resolution.height = height;
     bgfx_init.resolution.reset = BGFX_RESET_VSYNC | BGFX_RESET_MSAA_X16 | BGFX_RESET_MAXANISOTROPY;
     bgfx_init.platformData = pd;
+    // Instance data lives in transient vertex memory, 64 bytes per instance.
+    bgfx_init.limits.transientVbSize = 16 << 20;
+
+    // What the backend builds from the shaders persists across runs, see --pipeline-cache.
+    std::unique_ptr<PipelineCache> pipelineCache;
+    if (!cmdLine.hasArg("no-pipeline-cache"))
+    {
+        u32 pipelineCacheMb = 64;
+        cmdLine.hasArg(pipelineCacheMb, '\0', "pipeline-cache-size");
+        pipelineCache = std::make_unique<PipelineCache>(cmdLine.findOption("pipeline-cache", "Cache"), u64(pipelineCacheMb) << 20);
+        bgfx_init.callback = pipelineCache.get();
+    }
     bgfx::init(bgfx_init);
 
     bgfx::setViewClear(
         0, BGFX_CLEAR_COLOR | BGFX_CLEAR_DEPTH, 0x909090FF, 1.0f, 0);
     bgfx::setViewRect(0, 0, 0, width, height);
 
+    Renderer::init();
+    Renderer::setDepthPrepass(cmdLine.hasArg("depth-prepass"));
+
+    // Before the first load, textures loaded with streaming off keep all their mips.
+    if (!cmdLine.hasArg("no-texture-streaming"))
+        TextureStreamer::init();
+
+    // Textures the streamer doesn't take are evicted whole when over the budget.
+    u32 textureBudgetMb = 256;
+    cmdLine.hasArg(textureBudgetMb, '\0', "texture-budget");
+    TextureResidency::init(u64(textureBudgetMb) << 20);
+
+    // Before the programs load, so they get tracked. Off without a shaderc to run.
+    if (!cmdLine.hasArg("no-shader-reload"))
+        ShaderReloader::init(cmdLine.findOption("shader-source", ZV_SHADER_SOURCE_DIR), cmdLine.findOption("shaderc", ZV_SHADERC_PATH));
+
     ImGui::CreateContext();
 
     ImGui_Implbgfx_Init(255);
@@ -103,12 +182,19 @@ int main(int argc, char* argv[])
     ///////////////////
     // Load resources
 
-    // Load textures
-    bgfx::TextureHandle textureColor = LoadingManager::loadTexture("Assets/Textures/fieldstone-rgba.dds");
-    bgfx::TextureHandle textureNormal = LoadingManager::loadTexture("Assets/Textures/fieldstone-n.dds");
+    // Read and decode on the loading workers, the scene needs everything before it starts.
+    TextureRequest textureColorRequest = LoadingManager::loadTextureAsync("Assets/Textures/fieldstone-rgba.dds");
+    TextureRequest textureNormalRequest = LoadingManager::loadTextureAsync("Assets/Textures/fieldstone-n.dds");
+
+    LoadingManager::flush();
+
+    bgfx::TextureHandle textureColor = textureColorRequest.handle();
+    bgfx::TextureHandle textureNormal = textureNormalRequest.handle();
 
-    // Load shaders
-    bgfx::ProgramHandle program = LoadingManager::loadProgram("Assets/Shaders/test_v.bin", "Assets/Shaders/test_f.bin");
+    // Materials load the program variants they need themselves, see ShaderPermutation.
+    Renderer::setDepthPrograms(
+        LoadingManager::loadPermutation("depth_v", "depth_f", 0),
+        LoadingManager::loadPermutation("depth_v", "depth_f", ShaderPermutation::Instanced));
 
     ///////////////////
     // Setup scene
@@ -120,26 +206,99 @@ int main(int argc, char* argv[])
 
     Mesh testPlane(
         std::make_unique<PlaneGeometry>(5.0f, 5.0f),
-        std::make_unique<TestMaterial>(program, textureColor, textureNormal, &time)
+        std::make_unique<TestMaterial>(textureColor, textureNormal, &time)
     );
 
     Mesh testCube(
         std::make_unique<CubeGeometry>(2.0f, 2.0f, 2.0f),
-        std::make_unique<TestMaterial>(program, textureColor, textureNormal, &time)
+        std::make_unique<TestMaterial>(textureColor, textureNormal, &time)
     );
 
     Mesh testCylinder(
         std::make_unique<CylinderGeometry>(3.0f, 3.0f, 6.0f),
-        std::make_unique<TestMaterial>(program, textureColor, textureNormal, &time)
+        std::make_unique<TestMaterial>(textureColor, textureNormal, &time)
     );
 
+    InstancedMesh testCubeField(
+        std::make_unique<CubeGeometry>(0.2f, 0.2f, 0.2f),
+        std::make_unique<TestMaterial>(textureColor, textureNormal, &time)
+    );
+
+    for (s32 iz = 0; iz < 64; ++iz)
+    {
+        for (s32 ix = 0; ix < 64; ++ix)
+        {
+            f32 mtx[16];
+            bx::mtxTranslate(mtx, (ix - 32) * 0.5f, -4.0f, iz * 0.5f);
+            testCubeField.addInstance(mtx);
+        }
+    }
+
+    testPlane.setStatic(true);
+    testCube.setStatic(true);
+    testCylinder.setStatic(true);
+
+    testPlane.setOccluder(true);
+    testCube.setOccluder(true);
+
+    // Post-transform cache use before and after Geometry reordered the indices, shown in the overlay.
+    const std::pair<const char*, const Object3D*> optimizedMeshes[] = {
+        { "Plane", &testPlane }, { "Cube", &testCube }, { "Cylinder", &testCylinder }, { "Cube field", &testCubeField },
+    };
+
+    std::vector<Object3D*> objects{ &testPlane, &testCube, &testCylinder };
+    if (bgfx::isValid(testCubeField.material()->instancedProgram()))
+    {
+        objects.push_back(&testCubeField);
+    }
+
+    // Occluders keep their own geometry even when static batching merges them.
+    std::vector<Object3D*> occluders;
+    for (Object3D* object : objects)
+    {
+        if (object->isOccluder())
+            occluders.push_back(object);
+    }
+
+    // Static meshes sharing a material are merged, the batches replace them in the scene.
+    std::vector<std::unique_ptr<StaticBatch>> staticBatches;
+    std::vector<Object3D*> scene;
+    StaticBatch::build(objects, staticBatches, scene);
+    for (std::unique_ptr<StaticBatch>& batch : staticBatches)
+    {
+        scene.push_back(batch.get());
+    }
+    Bvh sceneBvh;
+    std::vector<s32> sceneProxies;
+    sceneBvh.build(scene, sceneProxies);
+
+    std::vector<Object3D*> visibleObjects;
+    std::vector<Object3D*> unoccludedObjects;
+    RenderQueue renderQueue;
+
+    OcclusionBuffer occlusionBuffer;
+    bool occlusionCulling = !cmdLine.hasArg("no-occlusion-culling");
+
+    // Until every startup load is on screen, cold and warm pipeline caches compare by it.
+    f64 startupMs = 0.0;
+    u32 loadedFrames = 0;
+
     ///////////////////
     // Main Loop
 
     while (!Input::quitEvent())
     {
+        // In render thread mode everything up to bgfx::frame() overlaps with the
+        // backend executing the previous frame.
+
+        ///////////////////
+        // Simulate
+
         Input::update();
 
+        // Create the bgfx objects of loads that finished decoding, a few per frame.
+        LoadingManager::update();
+
         s64 now = bx::getHPCounter();
         static s64 last = now;
         const s64 frameTime = now - last;
@@ -147,33 +306,156 @@ int main(int argc, char* argv[])
         const f64 freq = f64(bx::getHPFrequency());
         const f32 deltaTimeS = f32(frameTime / freq);
 
+        camera.update(deltaTimeS);
+
+        time += deltaTimeS;
+
+        ///////////////////
+        // Submit
+
         ImGui_Implbgfx_NewFrame();
         ImGui_ImplSDL2_NewFrame();
 
         ImGui::NewFrame();
         ImGui::ShowDemoWindow(); // your drawing here
+
+        ImGui::Begin("Renderer");
+        bool depthPrepass = Renderer::depthPrepass();
+        if (ImGui::Checkbox("Depth prepass", &depthPrepass))
+            Renderer::setDepthPrepass(depthPrepass);
+        bool autoInstancing = Renderer::autoInstancing();
+        if (ImGui::Checkbox("Auto instancing", &autoInstancing))
+            Renderer::setAutoInstancing(autoInstancing);
+        ImGui::Checkbox("Occlusion culling", &occlusionCulling);
+        ImGui::Text("Visible: %u / %u", u32(unoccludedObjects.size()), u32(visibleObjects.size()));
+        ImGui::Text("Vertices: %u bytes, %u position only", u32(VertexFormats::layout().getStride()), u32(VertexFormats::positionLayout().getStride()));
+
+        const ResourceCacheStats& cacheStats = ResourceCache::stats();
+        ImGui::Text("Cache: %u textures (%.1f MB), %u programs (%.1f KB)",
+            cacheStats.numTextures, f64(cacheStats.textureBytes) / (1024.0 * 1024.0),
+            cacheStats.numPrograms, f64(cacheStats.programBytes) / 1024.0);
+        ImGui::Text("Cache hit rate: %.0f%% (%u / %u)", cacheStats.hitRate() * 100.0f, cacheStats.hits, cacheStats.hits + cacheStats.misses);
+        ImGui::Text("Program variants: %u", LoadingManager::numPermutations());
+
+        const TextureStreamerStats& streamStats = TextureStreamer::stats();
+        ImGui::Text("Streamed: %u / %u textures, %.1f / %.1f MB",
+            streamStats.numResident, streamStats.numTextures,
+            f64(streamStats.residentBytes) / (1024.0 * 1024.0), f64(streamStats.budgetBytes) / (1024.0 * 1024.0));
+        ImGui::Text("Promoted %u, evicted %u, uploaded %.1f KB", streamStats.numPromotions, streamStats.numEvictions, f64(streamStats.uploadedBytes) / 1024.0);
+
+        const TextureResidencyStats& residencyStats = TextureResidency::stats();
+        ImGui::Text("Resident: %u / %u textures, %.1f / %.1f MB",
+            residencyStats.numResident, residencyStats.numTextures,
+            f64(residencyStats.residentBytes) / (1024.0 * 1024.0), f64(residencyStats.budgetBytes) / (1024.0 * 1024.0));
+        ImGui::Text("Evicted %u, reloaded %u, reloading %u", residencyStats.numEvictions, residencyStats.numReloads, residencyStats.numReloading);
+        s32 budgetMb = s32(residencyStats.budgetBytes >> 20);
+        if (ImGui::SliderInt("Texture budget (MB)", &budgetMb, 0, 1024))
+            TextureResidency::setBudget(u64(budgetMb) << 20);
+
+        if (ShaderReloader::isEnabled())
+        {
+            const ShaderReloaderStats& shaderStats = ShaderReloader::stats();
+            ImGui::Text("Shaders: %u programs, %u compiling, %u reloads, %u failures",
+                shaderStats.numPrograms, shaderStats.numCompiling, shaderStats.numReloads, shaderStats.numFailures);
+            if (!shaderStats.lastError.empty())
+                ImGui::Text("%s", shaderStats.lastError.c_str());
+        }
+
+        if (pipelineCache)
+        {
+            const PipelineCacheStats pipelineStats = pipelineCache->stats();
+            ImGui::Text("Pipelines: %u hits, %u misses, %u written, %u corrupt, %.1f / %.1f MB",
+                pipelineStats.hits, pipelineStats.misses, pipelineStats.writes, pipelineStats.corrupt,
+                f64(pipelineStats.bytes) / (1024.0 * 1024.0), f64(pipelineStats.maxBytes) / (1024.0 * 1024.0));
+        }
+        if (0.0 < startupMs)
+            ImGui::Text("Startup: %.1f ms", startupMs);
+        else
+            ImGui::Text("Startup: loading");
+
+        if (ImGui::CollapsingHeader("Vertex cache"))
+        {
+            for (const auto& [name, object] : optimizedMeshes)
+            {
+                const VertexCacheStats& generated = object->geometry()->generatedCacheStats();
+                const VertexCacheStats& optimized = object->geometry()->optimizedCacheStats();
+                ImGui::Text("%s: %u triangles, %u-bit indices", name, optimized.numTriangles, object->geometry()->index32() ? 32 : 16);
+                ImGui::Text("  ACMR %.3f -> %.3f, ATVR %.3f -> %.3f", generated.acmr(), optimized.acmr(), generated.atvr(), optimized.atvr());
+            }
+        }
+        ImGui::End();
+
         ImGui::Render();
         ImGui_Implbgfx_RenderDrawLists(ImGui::GetDrawData());
 
-        camera.update(deltaTimeS);
-
         // Set view and projection matrix for view 0.
         {
             bgfx::setViewTransform(0, camera.viewMatrix(), camera.projectionMatrix());
 
             // Set view 0 default viewport.
             bgfx::setViewRect(0, 0, 0, u16(width), u16(height));
+
+            // With the prepass on, depth is cleared and laid down before view 0 runs.
+            bgfx::setViewClear(
+                0, Renderer::depthPrepass() ? BGFX_CLEAR_COLOR : BGFX_CLEAR_COLOR | BGFX_CLEAR_DEPTH, 0x909090FF, 1.0f, 0);
+            bgfx::setViewTransform(Renderer::DepthPrepassView, camera.viewMatrix(false), camera.projectionMatrix(false));
+            bgfx::setViewRect(Renderer::DepthPrepassView, 0, 0, u16(width), u16(height));
         }
 
-        // Update primitives
-        time += deltaTimeS;
-        testPlane.render();
-        testCube.render();
-        testCylinder.render();
+        // Objects that moved call sceneBvh.update(), a few get reinserted per frame.
+        sceneBvh.rebuild(32);
+
+        const Frustum frustum = camera.frustum();
+
+        visibleObjects.clear();
+        sceneBvh.cull(frustum, visibleObjects);
+
+        unoccludedObjects.clear();
+        if (occlusionCulling)
+        {
+            f32 viewProj[16];
+            camera.viewProjMatrix(viewProj);
+
+            occlusionBuffer.clear(viewProj, bgfx::getCaps()->homogeneousDepth);
+            Culling::drawOccluders(occlusionBuffer, occluders);
+            occlusionBuffer.buildHiZ();
+
+            Culling::cull(occlusionBuffer, visibleObjects, unoccludedObjects);
+        }
+        else
+        {
+            unoccludedObjects = visibleObjects;
+        }
+
+        // The projected size of what's visible decides which texture mips to stream in.
+        for (Object3D* object : unoccludedObjects)
+        {
+            bx::Aabb aabb;
+            const f32 pixels = object->worldAabb(aabb) ? camera.screenSize(aabb, f32(height)) : f32(height);
+            TextureStreamer::request(*object->material(), pixels);
+        }
+        TextureStreamer::update();
+        TextureResidency::update();
+
+        // Programs rebuilt in the background replace the old ones from this frame on.
+        ShaderReloader::update();
+
+        renderQueue.reset(camera, frustum);
+        for (Object3D* object : unoccludedObjects)
+        {
+            object->enqueue(renderQueue);
+        }
+        Renderer::submit(renderQueue);
 
         // Advance to next frame. Rendering thread will be kicked to
         // process submitted rendering primitives.
         bgfx::frame();
+
+        // With a render thread the frame after the last load is the first one done executing it.
+        if (0.0 == startupMs && 0 == LoadingManager::numPending() && ++loadedFrames == 2)
+        {
+            startupMs = f64(bx::getHPCounter() - startTime) * 1000.0 / f64(bx::getHPFrequency());
+        }
     }
 
     ///////////////////
@@ -185,21 +467,31 @@ int main(int argc, char* argv[])
     ImGui::DestroyContext();
 
     // Destroy scene objects
+    for (std::unique_ptr<StaticBatch>& batch : staticBatches)
+    {
+        batch->cleanup();
+    }
+    testCubeField.cleanup();
     testCylinder.cleanup();
     testCube.cleanup();
     testPlane.cleanup();
 
-    // Destroy resources
-    bgfx::destroy(program);
-    bgfx::destroy(textureColor);
-    bgfx::destroy(textureNormal);
+    // Destroy resources, the requests and the program variants hold the last references into the cache
+    LoadingManager::clearPermutations();
+    textureColorRequest = TextureRequest();
+    textureNormalRequest = TextureRequest();
+    TextureStreamer::quit();
+    TextureResidency::quit();
+    ShaderReloader::quit();
 
     // Shutdown
+    Renderer::quit();
     bgfx::shutdown();
     SDL_DestroyWindow(window);
     SDL_Quit();
 
     LoadingManager::quit();
+    Vfs::unmountAll();
 
     return 0;
 }
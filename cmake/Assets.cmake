@@ -0,0 +1,296 @@
+# Shader and texture builds with the bgfx tools, on top of bgfx.cmake's bgfxToolUtils.
+#
+# Every output gets a custom command of its own, so the build tool runs them in
+# parallel and only reruns those whose inputs are newer. Each command goes
+# through HashedCommand.cmake, which skips the tool when the contents of the
+# inputs didn't actually change.
+
+if (NOT COMMAND _bgfx_shaderc_parse)
+    include(${CMAKE_SOURCE_DIR}/Source/ThirdParty/bgfx.cmake/cmake/bgfxToolUtils.cmake)
+endif ()
+
+set(ZV_HASHED_COMMAND ${CMAKE_CURRENT_LIST_DIR}/HashedCommand.cmake)
+
+# Same platform and profiles bgfx_compile_shaders() builds for.
+if (EMSCRIPTEN)
+    set(ZV_SHADER_PLATFORM ASM_JS)
+    set(zvDefaultProfiles 300_es)
+elseif (APPLE)
+    set(ZV_SHADER_PLATFORM OSX)
+    set(zvDefaultProfiles 120 spirv metal)
+elseif (WIN32)
+    set(ZV_SHADER_PLATFORM WINDOWS)
+    set(zvDefaultProfiles 120 spirv s_5_0)
+else ()
+    set(ZV_SHADER_PLATFORM LINUX)
+    set(zvDefaultProfiles 120 300_es spirv)
+endif ()
+set(ZV_SHADER_PROFILES "${zvDefaultProfiles}" CACHE STRING "shaderc profiles the asset build compiles every shader for")
+
+# Permutation key layout, mirrors ShaderPermutation.h: define, first bit, bit count.
+set(ZV_SHADER_SWITCHES
+    ZV_NORMAL_MAP 1 1
+    ZV_NUM_LIGHTS 8 3
+)
+
+# zv_shader_permutations(SHADER file OUT_VAR var)
+#
+# Expands the "// permutations: NAME=v,v NAME=v" line of a shader into one "<key>|<defines>" item
+# per combination, defines separated by commas and left out when 0. Without the line "0|".
+function(zv_shader_permutations SHADER OUT_VAR)
+    file(STRINGS ${SHADER} declaration REGEX "^//[ \t]*permutations:" LIMIT_COUNT 1)
+    set(permutations "0|")
+    if (NOT declaration)
+        set(${OUT_VAR} ${permutations} PARENT_SCOPE)
+        return()
+    endif ()
+
+    string(REGEX REPLACE "^//[ \t]*permutations:" "" declaration "${declaration}")
+    string(REGEX MATCHALL "[^ \t]+" switches "${declaration}")
+    foreach(switch IN LISTS switches)
+        if (NOT switch MATCHES "^([A-Z0-9_]+)=([0-9,]+)$")
+            message(FATAL_ERROR "${SHADER}: malformed permutation switch ${switch}")
+        endif ()
+        set(define ${CMAKE_MATCH_1})
+        string(REPLACE "," ";" values ${CMAKE_MATCH_2})
+
+        list(FIND ZV_SHADER_SWITCHES ${define} idx)
+        if (idx EQUAL -1)
+            message(FATAL_ERROR "${SHADER}: ${define} is not in ZV_SHADER_SWITCHES")
+        endif ()
+        math(EXPR shiftIdx "${idx} + 1")
+        math(EXPR bitsIdx "${idx} + 2")
+        list(GET ZV_SHADER_SWITCHES ${shiftIdx} shift)
+        list(GET ZV_SHADER_SWITCHES ${bitsIdx} bits)
+        math(EXPR limit "1 << ${bits}")
+
+        set(expanded "")
+        foreach(permutation IN LISTS permutations)
+            string(REGEX MATCH "^[^|]*" key "${permutation}")
+            string(REGEX REPLACE "^[^|]*\\|" "" defines "${permutation}")
+            foreach(value IN LISTS values)
+                if (value GREATER_EQUAL limit)
+                    message(FATAL_ERROR "${SHADER}: ${define}=${value} needs more than ${bits} bits")
+                endif ()
+                math(EXPR valueKey "${key} + (${value} << ${shift})" OUTPUT_FORMAT HEXADECIMAL)
+                set(valueDefines "${defines}")
+                if (NOT value EQUAL 0)
+                    if (valueDefines)
+                        string(APPEND valueDefines ",")
+                    endif ()
+                    string(APPEND valueDefines "${define}=${value}")
+                endif ()
+                list(APPEND expanded "${valueKey}|${valueDefines}")
+            endforeach()
+        endforeach()
+        set(permutations ${expanded})
+    endforeach()
+
+    set(${OUT_VAR} ${permutations} PARENT_SCOPE)
+endfunction()
+
+# Directory a profile's binaries go to, LoadingManager::shaderPath() picks the same by renderer.
+function(zv_shader_profile_dir PROFILE OUT_VAR)
+    if (PROFILE MATCHES "^s_5")
+        set(dir dx11)
+    elseif (PROFILE MATCHES "^s_3")
+        set(dir dx9)
+    elseif (PROFILE MATCHES "_es$")
+        set(dir essl)
+    elseif (PROFILE STREQUAL "metal")
+        set(dir metal)
+    elseif (PROFILE STREQUAL "spirv")
+        set(dir spirv)
+    elseif (PROFILE STREQUAL "pssl")
+        set(dir pssl)
+    else ()
+        set(dir glsl)
+    endif ()
+    set(${OUT_VAR} ${dir} PARENT_SCOPE)
+endfunction()
+
+# zv_add_hashed_command(OUTPUT file TOOL target INPUTS files... ARGS args... [COMMENT text])
+function(zv_add_hashed_command)
+    cmake_parse_arguments(ARG "" "OUTPUT;TOOL;COMMENT" "INPUTS;ARGS" ${ARGN})
+
+    file(RELATIVE_PATH relativeOutput ${CMAKE_SOURCE_DIR} ${ARG_OUTPUT})
+    set(stamp ${CMAKE_BINARY_DIR}/AssetStamps/${relativeOutput}.hash)
+
+    add_custom_command(
+        OUTPUT ${ARG_OUTPUT}
+        COMMAND ${CMAKE_COMMAND} -P ${ZV_HASHED_COMMAND} ${ARG_OUTPUT} ${stamp} ${ARG_INPUTS} -- $<TARGET_FILE:${ARG_TOOL}> ${ARG_ARGS}
+        DEPENDS ${ARG_INPUTS} ${ARG_TOOL} ${ZV_HASHED_COMMAND}
+        COMMENT "${ARG_COMMENT}"
+        VERBATIM
+    )
+endfunction()
+
+# zv_compile_shaders(TYPE VERTEX|FRAGMENT|COMPUTE SHADERS files... VARYING_DEF file
+#                    OUTPUT_DIR dir OUT_FILES_VAR var [INCLUDE_DIRS dirs...] [DEPENDS files...])
+#
+# Writes <OUTPUT_DIR>/<profile dir>/<name>.bin for every profile in ZV_SHADER_PROFILES, one
+# <name>-<16 hex digit key>.bin per permutation of the shaders that declare them, see zv_shader_permutations().
+# DEPENDS lists the headers the shaders include, they're hashed along with the source.
+function(zv_compile_shaders)
+    cmake_parse_arguments(ARG "" "TYPE;VARYING_DEF;OUTPUT_DIR;OUT_FILES_VAR" "SHADERS;INCLUDE_DIRS;DEPENDS" ${ARGN})
+
+    set(outputs "")
+    foreach(shader IN LISTS ARG_SHADERS)
+        get_filename_component(shaderPath ${shader} ABSOLUTE)
+        get_filename_component(shaderName ${shader} NAME_WE)
+
+        # The permutations line decides the outputs, editing it has to reconfigure.
+        set_property(DIRECTORY APPEND PROPERTY CMAKE_CONFIGURE_DEPENDS ${shaderPath})
+        zv_shader_permutations(${shaderPath} permutations)
+
+        foreach(permutation IN LISTS permutations)
+            string(REGEX MATCH "^[^|]*" key "${permutation}")
+            string(REGEX REPLACE "^[^|]*\\|" "" defines "${permutation}")
+
+            # Named like ShaderPermutation::name() does, the key padded to 16 hex digits.
+            set(variantName ${shaderName})
+            string(REGEX REPLACE "^0x" "" key "${key}")
+            if (NOT key STREQUAL "0")
+                string(TOLOWER ${key} key)
+                string(LENGTH ${key} keyLength)
+                math(EXPR paddingLength "16 - ${keyLength}")
+                string(REPEAT "0" ${paddingLength} padding)
+                set(variantName ${shaderName}-${padding}${key})
+            endif ()
+
+            foreach(profile IN LISTS ZV_SHADER_PROFILES)
+                zv_shader_profile_dir(${profile} profileDir)
+                set(output ${ARG_OUTPUT_DIR}/${profileDir}/${variantName}.bin)
+
+                _bgfx_shaderc_parse(
+                    cli
+                    ${ARG_TYPE} ${ZV_SHADER_PLATFORM} WERROR
+                    FILE ${shaderPath}
+                    OUTPUT ${output}
+                    PROFILE ${profile}
+                    O 3
+                    VARYINGDEF ${ARG_VARYING_DEF}
+                    INCLUDES ${BGFX_SHADER_INCLUDE_PATH} ${ARG_INCLUDE_DIRS}
+                )
+
+                # Passed here rather than as DEFINES, the list has to stay one argument
+                # on its way through HashedCommand.cmake.
+                if (defines)
+                    string(REPLACE "," "$<SEMICOLON>" defineList "${defines}")
+                    list(APPEND cli --define "${defineList}")
+                endif ()
+
+                zv_add_hashed_command(
+                    OUTPUT ${output}
+                    TOOL bgfx::shaderc
+                    INPUTS ${shaderPath} ${ARG_VARYING_DEF} ${ARG_DEPENDS}
+                    ARGS ${cli}
+                    COMMENT "Compiling shader ${variantName} for ${profileDir}"
+                )
+                list(APPEND outputs ${output})
+            endforeach()
+        endforeach()
+    endforeach()
+
+    set(${ARG_OUT_FILES_VAR} ${outputs} PARENT_SCOPE)
+endfunction()
+
+# zv_compile_textures(TEXTURES files... OUTPUT_DIR dir OUT_FILES_VAR var)
+#
+# Writes <OUTPUT_DIR>/<name>.dds with a full mip chain, which the TextureStreamer needs.
+# Names ending in -n are encoded as normal maps.
+function(zv_compile_textures)
+    cmake_parse_arguments(ARG "" "OUTPUT_DIR;OUT_FILES_VAR" "TEXTURES" ${ARGN})
+
+    set(outputs "")
+    foreach(texture IN LISTS ARG_TEXTURES)
+        get_filename_component(texturePath ${texture} ABSOLUTE)
+        get_filename_component(textureName ${texture} NAME_WE)
+        set(output ${ARG_OUTPUT_DIR}/${textureName}.dds)
+
+        set(normalMap "")
+        if (textureName MATCHES "-n$")
+            set(normalMap NORMALMAP)
+        endif ()
+
+        _bgfx_texturec_parse(
+            cli
+            MIPS ${normalMap}
+            FILE ${texturePath}
+            OUTPUT ${output}
+        )
+
+        zv_add_hashed_command(
+            OUTPUT ${output}
+            TOOL bgfx::texturec
+            INPUTS ${texturePath}
+            ARGS ${cli}
+            COMMENT "Compiling texture ${textureName}"
+        )
+        list(APPEND outputs ${output})
+    endforeach()
+
+    set(${ARG_OUT_FILES_VAR} ${outputs} PARENT_SCOPE)
+endfunction()
+
+# zv_add_assets(target SHADER_DIR dir TEXTURE_DIR dir OUTPUT_DIR dir)
+#
+# Builds every shader and texture below the source directories into OUTPUT_DIR/Shaders
+# and OUTPUT_DIR/Textures. Each directory of SHADER_DIR holding a varying.def.sc is
+# one set of shaders, *_f.sc are fragment shaders, *_c.sc compute shaders and the
+# rest vertex shaders. The *.sh headers in SHADER_DIR are shared by all of them.
+function(zv_add_assets TARGET)
+    cmake_parse_arguments(ARG "" "SHADER_DIR;TEXTURE_DIR;OUTPUT_DIR" "" ${ARGN})
+
+    set(outputs "")
+
+    file(GLOB shaderHeaders CONFIGURE_DEPENDS ${ARG_SHADER_DIR}/*.sh)
+    file(GLOB varyingDefs CONFIGURE_DEPENDS ${ARG_SHADER_DIR}/*/varying.def.sc)
+    foreach(varyingDef IN LISTS varyingDefs)
+        get_filename_component(shaderDir ${varyingDef} DIRECTORY)
+
+        file(GLOB sources CONFIGURE_DEPENDS ${shaderDir}/*.sc)
+        list(REMOVE_ITEM sources ${varyingDef})
+
+        set(vertexShaders ${sources})
+        set(fragmentShaders ${sources})
+        set(computeShaders ${sources})
+        list(FILTER fragmentShaders INCLUDE REGEX "_f\\.sc$")
+        list(FILTER computeShaders INCLUDE REGEX "_c\\.sc$")
+        list(FILTER vertexShaders EXCLUDE REGEX "_[fc]\\.sc$")
+
+        foreach(type VERTEX FRAGMENT COMPUTE)
+            string(TOLOWER ${type} typeName)
+            if (NOT ${typeName}Shaders)
+                continue()
+            endif ()
+
+            zv_compile_shaders(
+                TYPE ${type}
+                SHADERS ${${typeName}Shaders}
+                VARYING_DEF ${varyingDef}
+                OUTPUT_DIR ${ARG_OUTPUT_DIR}/Shaders
+                OUT_FILES_VAR shaderOutputs
+                INCLUDE_DIRS ${shaderDir} ${ARG_SHADER_DIR}
+                DEPENDS ${shaderHeaders}
+            )
+            list(APPEND outputs ${shaderOutputs})
+        endforeach()
+    endforeach()
+
+    file(GLOB textures CONFIGURE_DEPENDS
+        ${ARG_TEXTURE_DIR}/*.tga
+        ${ARG_TEXTURE_DIR}/*.png
+        ${ARG_TEXTURE_DIR}/*.jpg
+        ${ARG_TEXTURE_DIR}/*.hdr
+        ${ARG_TEXTURE_DIR}/*.exr
+    )
+    zv_compile_textures(
+        TEXTURES ${textures}
+        OUTPUT_DIR ${ARG_OUTPUT_DIR}/Textures
+        OUT_FILES_VAR textureOutputs
+    )
+    list(APPEND outputs ${textureOutputs})
+
+    add_custom_target(${TARGET} ALL DEPENDS ${outputs})
+endfunction()
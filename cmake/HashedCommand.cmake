@@ -0,0 +1,64 @@
+# Runs a tool only when what it reads changed, by content rather than timestamp.
+#
+#   cmake -P HashedCommand.cmake <output> <stamp> <input>... -- <command>...
+#
+# The stamp holds a hash of the command line and the contents of the inputs.
+# When it still matches, the output is touched instead of rebuilt, so inputs
+# that were rewritten without changing, by a checkout or a branch switch, cost
+# a hash rather than a compile.
+
+set(output "")
+set(stamp "")
+set(inputs "")
+set(command "")
+set(inCommand FALSE)
+
+math(EXPR lastArg "${CMAKE_ARGC} - 1")
+foreach(ii RANGE 3 ${lastArg})
+    set(arg "${CMAKE_ARGV${ii}}")
+    if (inCommand)
+        # Arguments may hold semicolons, shaderc's --define list does.
+        string(REPLACE ";" "\\;" arg "${arg}")
+        list(APPEND command "${arg}")
+    elseif (arg STREQUAL "--")
+        set(inCommand TRUE)
+    elseif (output STREQUAL "")
+        set(output "${arg}")
+    elseif (stamp STREQUAL "")
+        set(stamp "${arg}")
+    else ()
+        list(APPEND inputs "${arg}")
+    endif ()
+endforeach()
+
+if (output STREQUAL "" OR stamp STREQUAL "" OR command STREQUAL "")
+    message(FATAL_ERROR "Usage: cmake -P HashedCommand.cmake <output> <stamp> <input>... -- <command>...")
+endif ()
+
+set(key "${command}")
+foreach(input IN LISTS inputs)
+    file(SHA256 "${input}" inputHash)
+    string(APPEND key "\n${input} ${inputHash}")
+endforeach()
+string(SHA256 key "${key}")
+
+if (EXISTS "${output}" AND EXISTS "${stamp}")
+    file(READ "${stamp}" previousKey)
+    if (previousKey STREQUAL key)
+        file(TOUCH_NOCREATE "${output}")
+        return()
+    endif ()
+endif ()
+
+get_filename_component(outputDir "${output}" DIRECTORY)
+file(MAKE_DIRECTORY "${outputDir}")
+
+execute_process(COMMAND ${command} RESULT_VARIABLE result)
+if (NOT result EQUAL 0)
+    file(REMOVE "${stamp}")
+    message(FATAL_ERROR "Failed to build ${output}")
+endif ()
+
+get_filename_component(stampDir "${stamp}" DIRECTORY)
+file(MAKE_DIRECTORY "${stampDir}")
+file(WRITE "${stamp}" "${key}")
@@ -1,25 +1,46 @@
 @echo off
 
+REM Windows only, the build compiles the same assets for every backend (ZV_BUILD_ASSETS, see cmake/Assets.cmake)
+
 REM compile shaders
 
-if not exist Assets\Shaders mkdir Assets\Shaders
+if not exist Assets\Shaders\dx11 mkdir Assets\Shaders\dx11
 
 REM simple shader
 Temp\shaderc.exe ^
--f Source/Shaders/test/test_v.sc -o Assets/Shaders/test_v.bin ^
+-f Source/Shaders/test/test_v.sc -o Assets/Shaders/dx11/test_v.bin ^
+--platform windows --type vertex --verbose -i ./ -p s_5_0
+
+Temp\shaderc.exe ^
+-f Source/Shaders/test/test_vi.sc -o Assets/Shaders/dx11/test_vi.bin ^
+--platform windows --type vertex --verbose -i ./ -p s_5_0
+
+REM permutation the test material uses, normal mapped with 4 lights (see ShaderPermutation.h)
+Temp\shaderc.exe ^
+-f Source/Shaders/test/test_f.sc -o Assets/Shaders/dx11/test_f-0000000000000402.bin ^
+--platform windows --type fragment --verbose -i ./ -p s_5_0 ^
+--define "ZV_NORMAL_MAP=1;ZV_NUM_LIGHTS=4"
+
+REM depth prepass shader
+Temp\shaderc.exe ^
+-f Source/Shaders/depth/depth_v.sc -o Assets/Shaders/dx11/depth_v.bin ^
+--platform windows --type vertex --verbose -i ./ -p s_5_0
+
+Temp\shaderc.exe ^
+-f Source/Shaders/depth/depth_vi.sc -o Assets/Shaders/dx11/depth_vi.bin ^
 --platform windows --type vertex --verbose -i ./ -p s_5_0
 
 Temp\shaderc.exe ^
--f Source/Shaders/test/test_f.sc -o Assets/Shaders/test_f.bin ^
+-f Source/Shaders/depth/depth_f.sc -o Assets/Shaders/dx11/depth_f.bin ^
 --platform windows --type fragment --verbose -i ./ -p s_5_0
 
 if not exist Assets\Textures mkdir Assets\Textures
 
-Temp\texturec.exe ^
+Temp\texturec.exe -m ^
 -f Source/Assets/Textures/fieldstone-rgba.tga ^
 -o Assets/Textures/fieldstone-rgba.dds
 
-Temp\texturec.exe -n ^
+Temp\texturec.exe -m -n ^
 -f Source/Assets/Textures/fieldstone-n.tga ^
 -o Assets/Textures/fieldstone-n.dds
 